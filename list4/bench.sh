@@ -0,0 +1,29 @@
+#!/bin/bash
+
+#Author: Michal Kukowski
+#email: michalkukowski10@gmail.com
+
+# This script compares parallel kangaroo with parallel Gaudry - Schost
+# Usage: ./bench.sh [repeats]
+
+exec=./pollard.out
+repeats=${1:-5}
+
+instances=(
+    "2 424242 5041259"
+    "5 424242 87993167"
+    "4 473567883536982 1263154214185307"
+    "4 262635754439740 1263154214185307"
+    "7 424242 21441211962585599"
+)
+
+for instance in "${instances[@]}"; do
+    for algo in kangaroo gaudry; do
+        total=0
+        for ((i = 0; i < repeats; ++i)); do
+            t=$($exec $instance $algo | grep "TIME" | awk '{print $3}')
+            total=$(echo "$total + $t" | bc -l)
+        done
+        printf "%-40s %-10s avg = %s [s]\n" "$instance" "$algo" $(echo "scale=6; $total / $repeats" | bc -l)
+    done
+done
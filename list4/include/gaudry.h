@@ -0,0 +1,38 @@
+#ifndef GAUDRY_H
+#define GAUDRY_H
+
+/*
+    Implementation of parallel Gaudry - Schost interval discrete logarithm algo
+
+    Find x such that
+    g^x = h (mod) P, where x is in [0, P - 1)
+
+    Tame walks start in [0, P - 1), wild walks start in x + [-(P - 1) / 4, (P - 1) / 4).
+    Every walk is short: it stops at first distinguished point and thread restarts
+    new random walk, so there is no herd bookkeeping like in kangaroo algo.
+    Every thread gives up after fixed steps budget, so h without log gives failure.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+
+    LICENCE: GPL 3.0+
+*/
+
+#include <gmp.h>
+
+/*
+    Function find X such that g^x = h (mod)p
+
+    PARAMS
+    @IN g - generator of Zp
+    @IN h - result of power
+    @IN p - prime
+    @OUT x - discrete log
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int gaudry_schost_parallel_discrete_log(const mpz_t g, const mpz_t h, const mpz_t p, mpz_t x);
+
+#endif
@@ -14,6 +14,30 @@
 */
 
 #include <gmp.h>
+#include <stdint.h>
+
+typedef enum POLLARD_TUNE
+{
+    POLLARD_TUNE_STATIC,    /* jumps are powers of 2, mean is (2^r - 1) / r */
+    POLLARD_TUNE_AUTO,      /* jumps are randomised around optimal mean for interval width and herd size */
+    POLLARD_TUNE_CALIBRATE  /* like AUTO + short calibration pass, params are saved per bit length and reused
+                               from file given by environment variable KANGAROO_TUNE_FILE, without it every run calibrates */
+} pollard_tune_t;
+
+/*
+    Solver context for single group <g> and interval [0, width],
+    jump table, tame kangaroos and their distinguished points survive across calls
+*/
+typedef struct Pollard_ctx Pollard_ctx;
+
+/* stats of last query in context */
+typedef struct Pollard_stats
+{
+    unsigned int herd; /* number of kangaroos (threads) */
+    uint64_t *steps; /* steps of each kangaroo */
+    uint64_t dps; /* number of distinguished points */
+    double time; /* time of query in seconds */
+} Pollard_stats;
 
 /*
     Function find X such that g^x = h (mod)p
@@ -30,5 +54,111 @@
 */
 int pollard_lambda_parallel_dicsrete_log(const mpz_t g, const mpz_t h, const mpz_t p, mpz_t x);
 
+/*
+    Function find X such that g^x = h (mod)p with chosen jump table tuning
+
+    PARAMS
+    @IN g - generator of Zp
+    @IN h - result of power
+    @IN p - string prime
+    @IN mode - jump table tuning mode
+    @OUT x - discrete log
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int pollard_lambda_parallel_dicsrete_log_tune(const mpz_t g, const mpz_t h, const mpz_t p, pollard_tune_t mode, mpz_t x);
+
+/*
+    Create solver context, jump table is tuned and precomputed here.
+    Work depends only on width, so for g of small order pass width = ord(g)
+
+    PARAMS
+    @IN g - generator
+    @IN p - prime
+    @IN order - ord(g) or its multiple (p - 1)
+    @IN width - interval width, x in [0, width]
+    @IN mode - jump table tuning mode
+    @IN threads - number of threads (kangaroos), 0 means all available threads
+
+    RETURN
+    NULL iff failure
+    Pointer to new context iff success
+*/
+Pollard_ctx *pollard_ctx_create(const mpz_t g, const mpz_t p, const mpz_t order, const mpz_t width, pollard_tune_t mode, unsigned int threads);
+
+/*
+    Destroy solver context
+
+    PARAMS
+    @IN ctx - pointer to context
+
+    RETURN
+    This is a void function
+*/
+void pollard_ctx_destroy(Pollard_ctx *ctx);
+
+/*
+    Function find X such that g^x = h (mod)p using precomputed context
+
+    PARAMS
+    @IN ctx - context created for g and p
+    @IN h - result of power
+    @OUT x - discrete log
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int pollard_ctx_dicsrete_log(Pollard_ctx *ctx, const mpz_t h, mpz_t x);
+
+/*
+    Get stats of last query, stats are owned by context
+
+    PARAMS
+    @IN ctx - pointer to context
+
+    RETURN
+    Pointer to stats
+*/
+const Pollard_stats *pollard_ctx_get_stats(const Pollard_ctx *ctx);
+
+/*
+    Offline part of kangaroo with precomputation:
+    run only tame kangaroos for g^x, x in [0, width) and save their distinguished points to file.
+    Table with T entries gives about 2 * sqrt(width / T) steps per query.
+    Kangaroos give up after steps budget, so too many entries for small width gives failure
+
+    PARAMS
+    @IN g - generator of Zp
+    @IN p - prime
+    @IN width - interval width
+    @IN entries - number of distinguished points in table
+    @IN path - path to table file
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int pollard_lambda_tame_table_create(const mpz_t g, const mpz_t p, const mpz_t width, unsigned long entries, const char *path);
+
+/*
+    Function find X such that g^x = h (mod)p, x in [0, width)
+    Table is memory mapped and only wild kangaroos are launched.
+    Kangaroos give up after about 16 * sqrt(width / T) steps each, so x out of interval gives failure
+
+    PARAMS
+    @IN g - generator of Zp
+    @IN h - result of power
+    @IN p - prime
+    @IN path - path to table created by pollard_lambda_tame_table_create for the same g and p
+    @OUT x - discrete log
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int pollard_lambda_tame_table_dicsrete_log(const mpz_t g, const mpz_t h, const mpz_t p, const char *path, mpz_t x);
 
 #endif
\ No newline at end of file
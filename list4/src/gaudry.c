@@ -0,0 +1,429 @@
+#include <gaudry.h>
+#include <log.h>
+#include <omp.h>
+#include <time.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <darray.h>
+#include <common.h>
+#include <stdlib.h>
+
+/* number of different jumps */
+#define GAUDRY_JUMPS 32
+
+/* we want about GAUDRY_DP_PER_THREAD * sqrt(N) / 2^dp_bits distinguished points per thread */
+#define GAUDRY_DP_PER_THREAD 32
+
+/* single walk covers about N / GAUDRY_WALK_SPAN of its region */
+#define GAUDRY_WALK_SPAN 16
+
+/* walk without distinguished point after GAUDRY_WALK_MAX * 2^dp_bits steps is restarted */
+#define GAUDRY_WALK_MAX 16
+
+/* threads check cancellation every GAUDRY_CANCEL_STEPS steps, must be power of 2 */
+#define GAUDRY_CANCEL_STEPS (1ul << 12)
+
+/* thread gives up after GAUDRY_BUDGET_FACTOR * expected steps, but not earlier than after GAUDRY_BUDGET_MIN steps */
+#define GAUDRY_BUDGET_FACTOR 16
+#define GAUDRY_BUDGET_MIN (1ull << 16)
+
+/* Fibonacci hashing constant: 2^64 / golden ratio */
+#define GAUDRY_HASH_MUL 0x9E3779B97F4A7C15ULL
+
+typedef enum WALK_TYPE
+{
+    WALK_WILD,
+    WALK_TAME
+} walk_t;
+
+typedef struct Gaudry_point
+{
+    walk_t type;
+    mpz_t log; /* tame: pos = g^log, wild: pos = h * g^log */
+    mpz_t pos;
+} Gaudry_point;
+
+/*
+    Create Gaudry point
+
+    PARAMS
+    @IN type - type
+    @IN log - log
+    @IN pos - pos
+
+    RETURN
+    NULL iff failure
+    Pointer to new point iff success
+*/
+static Gaudry_point *gaudry_point_create(walk_t type, const mpz_t log, const mpz_t pos);
+
+/*
+    Destroy Gaudry point
+
+    PARAMS
+    @IN gp - pointer to Gaudry point
+
+    RETURN
+    This is a void function
+*/
+static void gaudry_point_destroy(Gaudry_point *gp);
+
+/*
+    Std compare function for Gaudry point
+
+    PARAMS
+    @IN gp1 - (void *)&Gaudry_point *
+    @IN gp2 - (void *)&Gaudry_point *
+
+    RETURN
+    -1 iff gp1 < gp2
+    1 iff gp1 > gp2
+    0 iff gp1 = gp2
+*/
+static int gaudry_point_cmp(const Gaudry_point *gp1, const Gaudry_point *gp2);
+
+/*
+    Wrappers
+*/
+static int gaudry_point_cmp_wrapper(const void *a, const void *b);
+static void gaudry_point_destroy_wrapper(void *p);
+
+/*
+    Choose jump for position, use low limb of pos mixed by Fibonacci hashing
+
+    PARAMS
+    @IN pos - pos
+
+    RETURN
+    Index of jump in [0, GAUDRY_JUMPS)
+*/
+static ___inline___ unsigned int gaudry_jump_index(const mpz_t pos);
+
+/*
+    Start new random walk
+
+    PARAMS
+    @IN type - walk type
+    @IN g - generator
+    @IN h - result of power
+    @IN p - prime
+    @IN order - N
+    @IN state - rand state of thread
+    @OUT log - start log
+    @OUT pos - start pos
+
+    RETURN
+    This is a void function
+*/
+static void gaudry_walk_start(walk_t type, const mpz_t g, const mpz_t h, const mpz_t p, const mpz_t order,
+                              gmp_randstate_t state, mpz_t log, mpz_t pos);
+
+/*
+    Calculate steps budget of single thread:
+    MAX(GAUDRY_BUDGET_FACTOR * (2 * sqrt(N) / threads + 2^dp_bits), GAUDRY_BUDGET_MIN)
+
+    PARAMS
+    @IN order - N
+    @IN threads - number of threads
+    @IN dp_bits - dp_bits
+
+    RETURN
+    budget
+*/
+static uint64_t gaudry_budget(const mpz_t order, unsigned int threads, unsigned long dp_bits);
+
+static Gaudry_point *gaudry_point_create(walk_t type, const mpz_t log, const mpz_t pos)
+{
+    Gaudry_point *gp;
+
+    gp = (Gaudry_point *)malloc(sizeof(Gaudry_point));
+    if (gp == NULL)
+        ERROR("Malloc error\n", NULL);
+
+    mpz_init(gp->log);
+    mpz_init(gp->pos);
+
+    gp->type = type;
+    mpz_set(gp->log, log);
+    mpz_set(gp->pos, pos);
+
+    return gp;
+}
+
+static void gaudry_point_destroy(Gaudry_point *gp)
+{
+    if (gp == NULL)
+        return;
+
+    mpz_clear(gp->log);
+    mpz_clear(gp->pos);
+
+    FREE(gp);
+}
+
+static int gaudry_point_cmp(const Gaudry_point *gp1, const Gaudry_point *gp2)
+{
+    return mpz_cmp(gp1->pos, gp2->pos);
+}
+
+static void gaudry_point_destroy_wrapper(void *p)
+{
+    gaudry_point_destroy(*(Gaudry_point **)p);
+}
+
+static int gaudry_point_cmp_wrapper(const void *a, const void *b)
+{
+    Gaudry_point *gp1 = *(Gaudry_point **)a;
+    Gaudry_point *gp2 = *(Gaudry_point **)b;
+
+    return gaudry_point_cmp(gp1, gp2);
+}
+
+static ___inline___ unsigned int gaudry_jump_index(const mpz_t pos)
+{
+    const uint64_t limb = (uint64_t)mpz_getlimbn(pos, 0);
+
+    return (unsigned int)((limb * GAUDRY_HASH_MUL) >> 59) % GAUDRY_JUMPS;
+}
+
+static void gaudry_walk_start(walk_t type, const mpz_t g, const mpz_t h, const mpz_t p, const mpz_t order,
+                              gmp_randstate_t state, mpz_t log, mpz_t pos)
+{
+    mpz_t quarter;
+
+    if (type == WALK_TAME)
+    {
+        /* log in [0, N), pos = g^log */
+        mpz_urandomm(log, state, order);
+        mpz_powm(pos, g, log, p);
+
+        return;
+    }
+
+    /* log in [-N / 4, N / 4), pos = h * g^log */
+    mpz_init(quarter);
+    mpz_div_ui(quarter, order, 4);
+
+    mpz_urandomm(log, state, order);
+    mpz_div_ui(log, log, 2);
+    mpz_sub(log, log, quarter);
+
+    mpz_powm(pos, g, log, p);
+    mpz_mul(pos, pos, h);
+    mpz_mod(pos, pos, p);
+
+    mpz_clear(quarter);
+}
+
+static uint64_t gaudry_budget(const mpz_t order, unsigned int threads, unsigned long dp_bits)
+{
+    uint64_t budget;
+    mpz_t temp;
+
+    mpz_init(temp);
+
+    mpz_sqrt(temp, order);
+    mpz_mul_ui(temp, temp, 2);
+    mpz_div_ui(temp, temp, threads);
+    mpz_add_ui(temp, temp, 1);
+
+    /* for huge group budget is unlimited */
+    if (mpz_sizeinbase(temp, 2) + 4 >= 64 || dp_bits + 4 >= 64)
+        budget = UINT64_MAX;
+    else
+        budget = (uint64_t)GAUDRY_BUDGET_FACTOR * ((uint64_t)mpz_get_ui(temp) + (1ull << dp_bits));
+
+    mpz_clear(temp);
+
+    if (budget < GAUDRY_BUDGET_MIN)
+        budget = GAUDRY_BUDGET_MIN;
+
+    return budget;
+}
+
+int gaudry_schost_parallel_discrete_log(const mpz_t g, const mpz_t h, const mpz_t p, mpz_t res)
+{
+    const unsigned int nproc = (unsigned int)omp_get_max_threads();
+    const unsigned long seed = (unsigned long)time(NULL);
+
+    unsigned long i;
+    unsigned long dp_bits;
+    unsigned long max_walk;
+    unsigned long walk;
+    unsigned long length;
+    uint64_t budget;
+    uint64_t steps;
+    unsigned int index;
+
+    mpz_t order;
+    mpz_t mean;
+    mpz_t temp;
+
+    mpz_t dists[GAUDRY_JUMPS];
+    mpz_t jumps[GAUDRY_JUMPS];
+
+    gmp_randstate_t state;
+
+    Darray *set;
+    Gaudry_point gpt;
+    Gaudry_point *gp_p = &gpt;
+    Gaudry_point *point;
+
+    walk_t type;
+    mpz_t log;
+    mpz_t pos;
+
+    bool finish = false;
+    bool done;
+
+    TRACE();
+
+    if (mpz_cmp(g, h) == 0)
+    {
+        mpz_set_ui(res, 1);
+        return 0;
+    }
+
+    set = darray_create(DARRAY_SORTED, 0, sizeof(Gaudry_point *), gaudry_point_cmp_wrapper, gaudry_point_destroy_wrapper);
+    if (set == NULL)
+        ERROR("malloc error\n", 1);
+
+    mpz_init(order);
+    mpz_init(mean);
+    mpz_init(temp);
+
+    /* order(generator(p)) = p - 1 */
+    mpz_sub_ui(order, p, 1);
+
+    /* 2^dp_bits = sqrt(N) / (nproc * GAUDRY_DP_PER_THREAD) */
+    mpz_sqrt(temp, order);
+    mpz_div_ui(temp, temp, (unsigned long)nproc * GAUDRY_DP_PER_THREAD);
+    dp_bits = mpz_cmp_ui(temp, 0) == 0 ? 0 : (unsigned long)mpz_sizeinbase(temp, 2) - 1;
+    max_walk = GAUDRY_WALK_MAX << dp_bits;
+
+    /* h not in <g> has no log, so threads give up */
+    budget = gaudry_budget(order, nproc, dp_bits);
+
+    /* mean = N / (2^dp_bits * GAUDRY_WALK_SPAN), walk ends before leaving its region */
+    mpz_tdiv_q_2exp(mean, order, dp_bits);
+    mpz_div_ui(mean, mean, GAUDRY_WALK_SPAN);
+    if (mpz_cmp_ui(mean, 0) == 0)
+        mpz_set_ui(mean, 1);
+
+    /* dists are random in [1, 2 * mean] */
+    gmp_randinit_default(state);
+    gmp_randseed_ui(state, seed);
+
+    mpz_mul_2exp(temp, mean, 1);
+    for (i = 0; i < GAUDRY_JUMPS; ++i)
+    {
+        mpz_init(dists[i]);
+        mpz_init(jumps[i]);
+
+        mpz_urandomm(dists[i], state, temp);
+        mpz_add_ui(dists[i], dists[i], 1);
+        mpz_powm(jumps[i], g, dists[i], p);
+    }
+
+    gmp_randclear(state);
+
+#pragma omp parallel private(log, pos, type, index, steps, walk, length, state, point, done) shared(g, h, p, order, set, jumps, dists, dp_bits, max_walk, budget, res, finish)
+{
+    mpz_init(log);
+    mpz_init(pos);
+
+    gmp_randinit_default(state);
+    gmp_randseed_ui(state, seed + (unsigned long)omp_get_thread_num() + 1);
+
+    done = false;
+    steps = 0;
+
+    /* threads alternate tame and wild walks, so every thread works on both regions */
+    for (walk = (unsigned long)omp_get_thread_num(); !done && steps < budget; ++walk)
+    {
+        type = ODD(walk) ? WALK_WILD : WALK_TAME;
+        gaudry_walk_start(type, g, h, p, order, state, log, pos);
+
+        /* start costs one step, so walks ending at once also use budget */
+        ++steps;
+        for (length = 0; length < max_walk && steps < budget; ++length, ++steps)
+        {
+            /* cancellation is checked rarely, it costs only one atomic load per GAUDRY_CANCEL_STEPS */
+            if ((steps & (GAUDRY_CANCEL_STEPS - 1)) == 0)
+            {
+#pragma omp atomic read
+                done = finish;
+
+                if (done)
+                    break;
+            }
+
+            if (mpz_scan1(pos, 0) >= dp_bits)
+                break;
+
+            index = gaudry_jump_index(pos);
+
+            mpz_mul(pos, pos, jumps[index]);
+            mpz_mod(pos, pos, p);
+
+            mpz_add(log, log, dists[index]);
+        }
+
+        /* walk without distinguished point, start new one */
+        if (done || mpz_scan1(pos, 0) < dp_bits)
+            continue;
+
+#pragma omp critical
+        {
+            if (!finish)
+            {
+                point = gaudry_point_create(type, log, pos);
+                if (darray_get_num_entries(set) > 0 && darray_search_first(set, (void *)&point, (void *)&gp_p) != -1)
+                {
+                    /* walks of the same type give nothing, simply forget this walk */
+                    if (gp_p->type != point->type)
+                    {
+                        /* g^tame = h * g^wild --> x = tame - wild */
+                        if (point->type == WALK_TAME)
+                            mpz_sub(res, point->log, gp_p->log);
+                        else
+                            mpz_sub(res, gp_p->log, point->log);
+
+                        mpz_mod(res, res, order);
+
+#pragma omp atomic write
+                        finish = true;
+                    }
+
+                    gaudry_point_destroy(point);
+                }
+                else
+                    darray_insert(set, (void *)&point);
+            }
+        }
+    }
+
+    gmp_randclear(state);
+    mpz_clear(log);
+    mpz_clear(pos);
+}
+
+    /* cleanup */
+    mpz_clear(order);
+    mpz_clear(mean);
+    mpz_clear(temp);
+
+    for (i = 0; i < GAUDRY_JUMPS; ++i)
+    {
+        mpz_clear(dists[i]);
+        mpz_clear(jumps[i]);
+    }
+
+    darray_destroy_with_entries(set);
+
+    /* every thread has used its budget */
+    if (!finish)
+        ERROR("gaudry budget exceeded\n", 1);
+
+    return 0;
+}
@@ -1,13 +1,41 @@
 #include <pollard.h>
+#include <gaudry.h>
 #include <stdio.h>
 #include <gmp.h>
 #include <compiler.h>
 #include <log.h>
+#include <string.h>
+#include <omp.h>
+#include <stdlib.h>
+#include <inttypes.h>
 
 #define BASE 10
 
+#define ALGO_KANGAROO   "kangaroo"
+#define ALGO_GAUDRY     "gaudry"
+#define ALGO_TABLE      "table"
+
+#define MODE_BUILD      "build"
+
+#define TUNE_STATIC     "static"
+#define TUNE_AUTO       "auto"
+#define TUNE_CALIBRATE  "calibrate"
+
 static int help(void);
 
+/*
+    Build tame kangaroo table: build g p entries path
+
+    PARAMS
+    @IN argc - argc
+    @IN argv - argv
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int build_table(int argc, char **argv);
+
 ___before_main___(1) void init(void);
 ___after_main___(1) void deinit(void);
 
@@ -29,11 +57,58 @@ static int help(void)
                  "g - generator\n"
                  "h - result of power\n"
                  "p - strong prime such that exist q that p = 2q + 1\n"
-                 "Output x\n");
+                 "Optional 4th argument - algorithm: " ALGO_KANGAROO " (default), " ALGO_GAUDRY " or " ALGO_TABLE "\n"
+                 "Optional 5th argument - kangaroo tuning: " TUNE_STATIC ", " TUNE_AUTO " (default) or " TUNE_CALIBRATE "\n"
+                 "                        for " ALGO_TABLE " path to tame table\n"
+                 "                        " TUNE_CALIBRATE " caches params in file given by KANGAROO_TUNE_FILE, without it nothing is saved\n"
+                 "Output x\n\n"
+                 "Tame table: " MODE_BUILD " g p entries path\n");
 
     return 0;
 }
 
+static int build_table(int argc, char **argv)
+{
+    mpz_t g;
+    mpz_t p;
+    mpz_t width;
+    unsigned long entries;
+
+    int ret;
+    double elapsed;
+
+    if (argc < 6)
+        return help();
+
+    mpz_init(g);
+    mpz_init(p);
+    mpz_init(width);
+
+    mpz_set_str(g, argv[2], BASE);
+    mpz_set_str(p, argv[3], BASE);
+    entries = strtoul(argv[4], NULL, BASE);
+
+    /* x in [0, p - 1) */
+    mpz_sub_ui(width, p, 1);
+
+    (void)gmp_printf("Building tame table with %lu entries for %Zd (mod %Zd)\n", entries, g, p);
+    elapsed = omp_get_wtime();
+    ret = pollard_lambda_tame_table_create(g, p, width, entries, argv[5]);
+    elapsed = omp_get_wtime() - elapsed;
+    (void)printf("TIME = %lf [s]\n", elapsed);
+
+    if (ret)
+        (void)printf("FAILED\n");
+    else
+        (void)printf("Table saved to %s\n", argv[5]);
+
+    mpz_clear(g);
+    mpz_clear(p);
+    mpz_clear(width);
+
+    return ret;
+}
+
 int main(int argc, char **argv)
 {
     mpz_t g;
@@ -43,6 +118,16 @@ int main(int argc, char **argv)
 
     int res;
     int ret;
+    unsigned int i;
+
+    pollard_tune_t mode = POLLARD_TUNE_AUTO;
+    Pollard_ctx *ctx;
+    const Pollard_stats *stats;
+
+    double elapsed;
+
+    if (argc > 1 && strcmp(argv[1], MODE_BUILD) == 0)
+        return build_table(argc, argv);
 
     if (argc < 4)
         return help();
@@ -56,8 +141,37 @@ int main(int argc, char **argv)
     mpz_set_str(h, argv[2], BASE);
     mpz_set_str(p, argv[3], BASE);
 
+    if (argc > 5 && strcmp(argv[5], TUNE_STATIC) == 0)
+        mode = POLLARD_TUNE_STATIC;
+    else if (argc > 5 && strcmp(argv[5], TUNE_CALIBRATE) == 0)
+        mode = POLLARD_TUNE_CALIBRATE;
+
     (void)gmp_printf("Trying find x such that %Zd^x = %Zd (mod %Zd)\n", g, h, p);
-    res = pollard_lambda_parallel_dicsrete_log(g, h, p, x);
+    elapsed = omp_get_wtime();
+    if (argc > 4 && strcmp(argv[4], ALGO_GAUDRY) == 0)
+        res = gaudry_schost_parallel_discrete_log(g, h, p, x);
+    else if (argc > 5 && strcmp(argv[4], ALGO_TABLE) == 0)
+        res = pollard_lambda_tame_table_dicsrete_log(g, h, p, argv[5], x);
+    else
+    {
+        /* x in [0, p - 1] */
+        mpz_sub_ui(x, p, 1);
+        ctx = pollard_ctx_create(g, p, x, x, mode, 0);
+        if (ctx == NULL)
+            FATAL("pollard_ctx_create error\n");
+
+        res = pollard_ctx_dicsrete_log(ctx, h, x);
+
+        stats = pollard_ctx_get_stats(ctx);
+        for (i = 0; i < stats->herd; ++i)
+            (void)printf("KANGAROO %u: %" PRIu64 " steps\n", i, stats->steps[i]);
+
+        (void)printf("DISTINGUISHED POINTS = %" PRIu64 "\n", stats->dps);
+        pollard_ctx_destroy(ctx);
+    }
+
+    elapsed = omp_get_wtime() - elapsed;
+    (void)printf("TIME = %lf [s]\n", elapsed);
 
     if (res)
         (void)printf("FAILED\n");
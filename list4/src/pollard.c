@@ -6,10 +6,49 @@
 #include <darray.h>
 #include <common.h>
 #include <stdlib.h>
-#include <hash.h>
 #include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-#define POLLARD_TRESHOLD 40
+/* jump table size is in [POLLARD_JUMPS_MIN, POLLARD_JUMPS_MAX] */
+#define POLLARD_JUMPS_MIN 8
+#define POLLARD_JUMPS_MAX 64
+
+/* default cost of distinguished point (search + insert in critical section) in kangaroo steps */
+#define POLLARD_DP_COST 32
+
+/* every kangaroo should see at least POLLARD_DP_MIN distinguished points */
+#define POLLARD_DP_MIN 8
+
+/* calibration pass */
+#define POLLARD_CALIBRATION_STEPS   (1ul << 12)
+#define POLLARD_CALIBRATION_DPS     (1ul << 8)
+
+/* environment variable with path of file with tuned parameters per bit length, without it params are not cached */
+#define POLLARD_TUNE_FILE_ENV "KANGAROO_TUNE_FILE"
+
+/* threads check cancellation every POLLARD_CANCEL_STEPS steps, must be power of 2 */
+#define POLLARD_CANCEL_STEPS (1ul << 12)
+
+/* kangaroo gives up after POLLARD_BUDGET_FACTOR * expected steps, but not earlier than after POLLARD_BUDGET_MIN steps */
+#define POLLARD_BUDGET_FACTOR 16
+#define POLLARD_BUDGET_MIN (1ull << 16)
+
+/* Fibonacci hashing constant: 2^64 / golden ratio */
+#define POLLARD_HASH_MUL 0x9E3779B97F4A7C15ULL
+
+/* tame table file */
+#define POLLARD_TABLE_MAGIC "KANGTAB1"
+
+/* walk of single kangaroo with table covers about width / POLLARD_TABLE_SPAN */
+#define POLLARD_TABLE_SPAN 8
+
+/* walk without distinguished point after POLLARD_TABLE_WALK_MAX * 2^dp_bits steps is restarted */
+#define POLLARD_TABLE_WALK_MAX 8
 
 typedef enum KANGAROO_TYPE
 {
@@ -24,6 +63,63 @@ typedef struct Pollard_triple
     mpz_t pos; /* jump pos */
 } Pollard_triple;
 
+/* parameters of kangaroo jump table */
+typedef struct Pollard_params
+{
+    unsigned long r; /* number of jumps */
+    unsigned long dp_bits; /* pos is distinguished iff dp_bits lowest bits are 0 */
+    unsigned long seed; /* seed for random jumps */
+    mpz_t mean; /* mean jump */
+} Pollard_params;
+
+/* single kangaroo with its own rand stream */
+typedef struct Pollard_kangaroo
+{
+    kangaroo_t type;
+    mpz_t dist;
+    mpz_t pos;
+    gmp_randstate_t state;
+} Pollard_kangaroo;
+
+/* solver context for single group and interval */
+struct Pollard_ctx
+{
+    pollard_tune_t mode;
+    unsigned int herd;
+
+    mpz_t g;
+    mpz_t p;
+    mpz_t width;
+    mpz_t order; /* ord(g), result is reduced modulo order */
+    mpz_t middle; /* tame kangaroos start in middle of interval */
+    mpz_t v; /* distance between kangaroos in the same herd */
+
+    Pollard_params params;
+    mpz_t *dists;
+    mpz_t *jumps;
+
+    uint64_t budget; /* max steps of single kangaroo in single query */
+    Pollard_stats stats; /* stats of last query */
+
+    Darray *tame; /* distinguished points of tame kangaroos */
+    Pollard_kangaroo *kangaroos; /* herd, kangaroo i belongs to thread i mod threads */
+};
+
+/*
+    Header of tame table file, after header there are:
+    g, p, width, mean and entries records (pos, log) sorted by pos.
+    Every number is big endian and has header.bytes bytes, so file can be simply mapped
+*/
+typedef struct Pollard_table_header
+{
+    char magic[8];
+    uint64_t bytes; /* bytes of every number */
+    uint64_t entries; /* number of records */
+    uint64_t r;
+    uint64_t dp_bits;
+    uint64_t seed;
+} Pollard_table_header;
+
 /*
     Calculate max jumps from formula:
     First r than (2^r - 1) / r > beta
@@ -36,6 +132,172 @@ typedef struct Pollard_triple
 */
 static ___inline___ unsigned long  calculate_max_jumps(const mpz_t beta);
 
+/*
+    Calculate distinguished point bits, 2^dp_bits = sqrt(walk * cost),
+    where walk = 2 * sqrt(width) / herd is expected walk of single kangaroo.
+    So latency from collision to distinguished point is balanced with cost of distinguished points
+
+    PARAMS
+    @IN width - interval width
+    @IN herd - number of kangaroos
+    @IN cost - cost of single distinguished point in kangaroo steps
+
+    RETURN
+    dp_bits
+*/
+static unsigned long calculate_dp_bits(const mpz_t width, unsigned int herd, unsigned long cost);
+
+/*
+    Calculate steps budget of single kangaroo:
+    MAX(POLLARD_BUDGET_FACTOR * (2 * sqrt(width) / herd + 2^dp_bits), POLLARD_BUDGET_MIN)
+
+    PARAMS
+    @IN width - interval width
+    @IN herd - number of kangaroos
+    @IN dp_bits - dp_bits
+
+    RETURN
+    budget
+*/
+static uint64_t calculate_budget(const mpz_t width, unsigned int herd, unsigned long dp_bits);
+
+/*
+    Calculate steps budget of single kangaroo for known work of whole herd:
+    MAX(POLLARD_BUDGET_FACTOR * (steps / herd + 2^dp_bits), POLLARD_BUDGET_MIN)
+
+    PARAMS
+    @IN steps - expected steps of whole herd
+    @IN herd - number of kangaroos
+    @IN dp_bits - dp_bits
+
+    RETURN
+    budget
+*/
+static uint64_t calculate_walk_budget(const mpz_t steps, unsigned int herd, unsigned long dp_bits);
+
+/*
+    Create jump table: dists and jumps = g^dists
+    In POLLARD_TUNE_STATIC jumps are powers of 2,
+    otherwise dists are randomised in pairs mean +- delta, so mean is exact
+
+    PARAMS
+    @IN mode - tune mode
+    @IN params - jump table params
+    @IN g - generator
+    @IN p - prime
+    @OUT dists - dists, array of params->r elements
+    @OUT jumps - jumps, array of params->r elements
+
+    RETURN
+    This is a void function
+*/
+static void pollard_jumps_create(pollard_tune_t mode, const Pollard_params *params, const mpz_t g, const mpz_t p, mpz_t *dists, mpz_t *jumps);
+
+/*
+    Short calibration pass, measure cost of single step and single distinguished point
+    and set params->dp_bits
+
+    PARAMS
+    @IN g - generator
+    @IN p - prime
+    @IN width - interval width
+    @IN herd - number of kangaroos
+    @IN dists - dists
+    @IN jumps - jumps
+    @IN / OUT params - params
+
+    RETURN
+    This is a void function
+*/
+static void pollard_calibrate(const mpz_t g, const mpz_t p, const mpz_t width, unsigned int herd,
+                              mpz_t *dists, mpz_t *jumps, Pollard_params *params);
+
+/*
+    Load params for width bit length and herd from file given by POLLARD_TUNE_FILE_ENV
+
+    PARAMS
+    @IN bits - bit length of width
+    @IN herd - number of kangaroos
+    @OUT params - params
+
+    RETURN
+    0 iff params have been found
+    Non-zero value iff failure or file is not set
+*/
+static int pollard_params_load(unsigned long bits, unsigned int herd, Pollard_params *params);
+
+/*
+    Save params for width bit length and herd to file given by POLLARD_TUNE_FILE_ENV, nothing is saved if it is not set
+
+    PARAMS
+    @IN bits - bit length of width
+    @IN herd - number of kangaroos
+    @IN params - params
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int pollard_params_save(unsigned long bits, unsigned int herd, const Pollard_params *params);
+
+/*
+    Single kangaroo jump
+
+    PARAMS
+    @IN r - number of jumps
+    @IN dists - dists
+    @IN jumps - jumps
+    @IN p - prime
+    @IN / OUT pos - pos
+    @IN / OUT dist - dist
+
+    RETURN
+    This is a void function
+*/
+static ___inline___ void pollard_jump(unsigned long r, mpz_t *dists, mpz_t *jumps, const mpz_t p, mpz_t pos, mpz_t dist);
+
+/*
+    Calculate params for tame table: walk = 2^dp_bits = sqrt(width / entries),
+    mean = width / (POLLARD_TABLE_SPAN * walk)
+
+    PARAMS
+    @IN width - interval width
+    @IN entries - number of tame distinguished points
+    @OUT params - params (mean must be initialized)
+
+    RETURN
+    This is a void function
+*/
+static void pollard_table_params(const mpz_t width, unsigned long entries, Pollard_params *params);
+
+/*
+    Export number to fixed size big endian buffer
+
+    PARAMS
+    @OUT buf - buffer
+    @IN bytes - size of buffer
+    @IN op - number
+
+    RETURN
+    This is a void function
+*/
+static void pollard_mpz_to_bytes(unsigned char *buf, size_t bytes, const mpz_t op);
+
+/*
+    Binary search of pos in table records
+
+    PARAMS
+    @IN records - sorted records (pos, log)
+    @IN entries - number of records
+    @IN bytes - bytes of single number
+    @IN key - pos in big endian
+
+    RETURN
+    -1 iff pos is not in table
+    index of record iff success
+*/
+static long pollard_table_search(const unsigned char *records, size_t entries, size_t bytes, const unsigned char *key);
+
 /*
     Create Pollard triple
 
@@ -103,239 +365,1158 @@ static ___inline___ unsigned long  calculate_max_jumps(const mpz_t beta)
     return r - 2;
 }
 
-static Pollard_triple *pollard_triple_create(kangaroo_t type, const mpz_t dist, const mpz_t pos)
+static unsigned long calculate_dp_bits(const mpz_t width, unsigned int herd, unsigned long cost)
 {
-    Pollard_triple *pt;
+    unsigned long dp_bits;
+    unsigned long max_bits;
+    mpz_t walk;
+    mpz_t temp;
 
-    pt = (Pollard_triple *)malloc(sizeof(Pollard_triple));
-    if (pt == NULL)
-        ERROR("Malloc error\n", NULL);
+    mpz_init(walk);
+    mpz_init(temp);
 
-    mpz_init(pt->pos);
-    mpz_init(pt->dist);
+    /* walk = 2 * sqrt(width) / herd */
+    mpz_sqrt(walk, width);
+    mpz_mul_ui(walk, walk, 2);
+    mpz_div_ui(walk, walk, herd);
 
-    pt->type = type;
-    mpz_set(pt->pos, pos);
-    mpz_set(pt->dist, dist);
+    /* 2^(2 * dp_bits) <= walk * cost */
+    mpz_mul_ui(temp, walk, cost);
+    dp_bits = mpz_cmp_ui(temp, 0) == 0 ? 0 : ((unsigned long)mpz_sizeinbase(temp, 2) - 1) >> 1;
 
-    return pt;
+    /* 2^dp_bits <= walk / POLLARD_DP_MIN */
+    mpz_div_ui(temp, walk, POLLARD_DP_MIN);
+    max_bits = mpz_cmp_ui(temp, 0) == 0 ? 0 : (unsigned long)mpz_sizeinbase(temp, 2) - 1;
+
+    mpz_clear(walk);
+    mpz_clear(temp);
+
+    return MIN(dp_bits, max_bits);
 }
 
-static void pollard_triple_destroy(Pollard_triple *pt)
+static uint64_t calculate_budget(const mpz_t width, unsigned int herd, unsigned long dp_bits)
 {
-    if (pt == NULL)
-        return;
+    uint64_t budget;
+    mpz_t temp;
 
-    mpz_clear(pt->pos);
-    mpz_clear(pt->dist);
+    mpz_init(temp);
 
-    FREE(pt);
-}
+    /* herd needs about 2 * sqrt(width) steps */
+    mpz_sqrt(temp, width);
+    mpz_mul_ui(temp, temp, 2);
 
-static int pollard_triple_cmp(const Pollard_triple *pt1, const Pollard_triple *pt2)
-{
-    return mpz_cmp(pt1->pos, pt2->pos);
+    budget = calculate_walk_budget(temp, herd, dp_bits);
+
+    mpz_clear(temp);
+
+    return budget;
 }
 
-static void pollard_triple_destroy_wrapper(void *p)
+static uint64_t calculate_walk_budget(const mpz_t steps, unsigned int herd, unsigned long dp_bits)
 {
-    pollard_triple_destroy(*(Pollard_triple **)p);
+    uint64_t budget;
+    mpz_t temp;
+
+    mpz_init(temp);
+
+    mpz_div_ui(temp, steps, herd);
+    mpz_add_ui(temp, temp, 1);
+
+    /* for huge interval budget is unlimited */
+    if (mpz_sizeinbase(temp, 2) + 4 >= 64 || dp_bits + 4 >= 64)
+        budget = UINT64_MAX;
+    else
+        budget = (uint64_t)POLLARD_BUDGET_FACTOR * ((uint64_t)mpz_get_ui(temp) + (1ull << dp_bits));
+
+    mpz_clear(temp);
+
+    if (budget < POLLARD_BUDGET_MIN)
+        budget = POLLARD_BUDGET_MIN;
+
+    return budget;
 }
 
-static int pollard_triple_cmp_wrapper(const void *a, const void *b)
+static void pollard_jumps_create(pollard_tune_t mode, const Pollard_params *params, const mpz_t g, const mpz_t p, mpz_t *dists, mpz_t *jumps)
 {
-    Pollard_triple *pt1 = *(Pollard_triple **)a;
-    Pollard_triple *pt2 = *(Pollard_triple **)b;
+    unsigned long i;
+    gmp_randstate_t state;
+    mpz_t delta;
 
-    return pollard_triple_cmp(pt1, pt2);
+    mpz_init(delta);
+
+    gmp_randinit_default(state);
+    gmp_randseed_ui(state, params->seed);
+
+    for (i = 0; i < params->r; ++i)
+    {
+        if (mode == POLLARD_TUNE_STATIC)
+            mpz_ui_pow_ui(dists[i], 2, i);
+        else if (ODD(i))
+            mpz_sub(dists[i], params->mean, delta); /* pair of previous jump */
+        else if (i == params->r - 1)
+            mpz_set(dists[i], params->mean); /* last jump without pair */
+        else
+        {
+            /* delta in [0, mean), so jumps cover [1, 2 * mean), narrow band around mean gives slow collisions */
+            mpz_urandomm(delta, state, params->mean);
+
+            mpz_add(dists[i], params->mean, delta);
+        }
+
+        mpz_powm(jumps[i], g, dists[i], p);
+    }
+
+    gmp_randclear(state);
+    mpz_clear(delta);
 }
 
-int pollard_lambda_parallel_dicsrete_log(const mpz_t g, const mpz_t h, const mpz_t p, mpz_t res)
+static ___inline___ void pollard_jump(unsigned long r, mpz_t *dists, mpz_t *jumps, const mpz_t p, mpz_t pos, mpz_t dist)
 {
-    const unsigned int nproc = (unsigned int)omp_get_max_threads();
-    unsigned long r;
-
-    unsigned long i;
-    int index;
-    char *str;
+    /* low limb mixed by Fibonacci hashing, high bits are independent from distinguished point bits */
+    const uint64_t limb = (uint64_t)mpz_getlimbn(pos, 0);
+    const unsigned long index = (unsigned long)((limb * POLLARD_HASH_MUL) >> 32) % r;
 
-    mpz_t a;
-    mpz_t b;
-    mpz_t order_g;
+    mpz_mul(pos, pos, jumps[index]);
+    mpz_mod(pos, pos, p);
 
-    mpz_t beta;
-    mpz_t v;
+    mpz_add(dist, dist, dists[index]);
+}
 
-    mpz_t *dists;
-    mpz_t *jumps;
+static void pollard_calibrate(const mpz_t g, const mpz_t p, const mpz_t width, unsigned int herd,
+                              mpz_t *dists, mpz_t *jumps, Pollard_params *params)
+{
+    double t_step = 0.0;
+    double t_dp = 0.0;
+    double start;
+    double step;
 
+    unsigned long i;
     Darray *set;
     Pollard_triple pt;
     Pollard_triple *pt_p = &pt;
     Pollard_triple *triple;
 
-    kangaroo_t type;
-    mpz_t dist;
     mpz_t pos;
-    mpz_t x;
-    mpz_t step;
+    mpz_t dist;
 
-    bool finish = false;
+    TRACE();
 
+    /* scratch set, only to measure real cost of distinguished point */
     set = darray_create(DARRAY_SORTED, 0, sizeof(Pollard_triple *), pollard_triple_cmp_wrapper, pollard_triple_destroy_wrapper);
     if (set == NULL)
-        ERROR("malloc error\n", 1);
+    {
+        params->dp_bits = calculate_dp_bits(width, herd, POLLARD_DP_COST);
+        return;
+    }
 
-    mpz_init(a);
-    mpz_init(b);
-    mpz_init(order_g);
-    mpz_init(beta);
-    mpz_init(v);
+#pragma omp parallel num_threads(herd) private(pos, dist, i, start, step, triple, pt_p) shared(g, p, dists, jumps, params, set) reduction(+:t_step, t_dp)
+{
+    mpz_init(pos);
+    mpz_init(dist);
 
-    /* order(generator(p)) = p - 1 */
-    mpz_set(order_g, p);
-    mpz_sub_ui(order_g, order_g, 1);
+    mpz_mul_ui(dist, params->mean, (unsigned long)omp_get_thread_num() + 1);
+    mpz_powm(pos, g, dist, p);
 
-    /* range [0, order_g] */
-    mpz_set_ui(a, 0);
-    mpz_set(b, order_g);
+    start = omp_get_wtime();
+    for (i = 0; i < POLLARD_CALIBRATION_STEPS; ++i)
+        pollard_jump(params->r, dists, jumps, p, pos, dist);
 
-    /* beta = (nproc * sqrt(b - a) / 4) */
-    mpz_set(beta, b);
-    mpz_sub(beta, beta, a);
-    mpz_sqrt(beta, beta);
-    mpz_mul_ui(beta, beta, nproc);
-    mpz_div_ui(beta, beta, 4);
+    step = (omp_get_wtime() - start) / (double)POLLARD_CALIBRATION_STEPS;
 
-    /* v = beta / nproc / 2 */
-    mpz_div_ui(v, beta, nproc >> 1);
+    /* every step is distinguished point now */
+    start = omp_get_wtime();
+    for (i = 0; i < POLLARD_CALIBRATION_DPS; ++i)
+    {
+        pollard_jump(params->r, dists, jumps, p, pos, dist);
+        triple = pollard_triple_create(KANGAROO_TAME, dist, pos);
+#pragma omp critical
+        {
+            if (darray_get_num_entries(set) > 0 && darray_search_first(set, (void *)&triple, (void *)&pt_p) != -1)
+                pollard_triple_destroy(triple);
+            else
+                darray_insert(set, (void *)&triple);
+        }
+    }
 
-    r = calculate_max_jumps(beta);
+    t_dp += (omp_get_wtime() - start) / (double)POLLARD_CALIBRATION_DPS - step;
+    t_step += step;
 
-    dists = (mpz_t *)malloc(sizeof(mpz_t) * r);
-    if (dists == NULL)
-        ERROR("malloc error\n", 1);
+    mpz_clear(pos);
+    mpz_clear(dist);
+}
 
-    jumps = (mpz_t *)malloc(sizeof(mpz_t) * r);
-    if (jumps == NULL)
-        ERROR("malloc error\n", 1);
+    darray_destroy_with_entries(set);
 
-    for (i = 0; i < r; ++i)
-    {
-        mpz_init(dists[i]);
-        mpz_init(jumps[i]);
+    if (t_dp < t_step)
+        t_dp = t_step;
 
-        mpz_ui_pow_ui(dists[i], 2, i);
-        mpz_powm(jumps[i], g, dists[i], p);
-    }
+    params->dp_bits = calculate_dp_bits(width, herd, (unsigned long)(t_dp / t_step + 0.5));
+
+    LOG("Calibration: step = %e [s], distinguished point = %e [s], collision to DP latency = %e [s]\n",
+        t_step / (double)herd, t_dp / (double)herd, t_step / (double)herd * (double)(1ul << params->dp_bits));
+}
 
-#pragma omp parallel private(dist, pos, type, index, str, x, step) shared(a, b, g, h, p, set, jumps, dists, r, v, res, finish)
+static int pollard_params_load(unsigned long bits, unsigned int herd, Pollard_params *params)
 {
-    if (ODD(omp_get_thread_num()))
-        type = KANGAROO_WILD;
-    else
-        type = KANGAROO_TAME;
+    FILE *file;
+    const char *path;
+    unsigned long f_bits;
+    unsigned int f_herd;
+    unsigned long r;
+    unsigned long dp_bits;
+    unsigned long seed;
+    int ret = 1;
 
-    mpz_init(dist);
-    mpz_init(pos);
+    TRACE();
 
-    /* start with dist = (i - 1) * v */
-    mpz_set_ui(dist, (unsigned long)(omp_get_thread_num() + 2) >> 1);
-    mpz_mul(dist, dist, v);
+    path = getenv(POLLARD_TUNE_FILE_ENV);
+    if (path == NULL || *path == '\0')
+        return 1;
 
-    if (type == KANGAROO_TAME)
-    {
-        /* start with pos = g^((a + b) / 2 + dist */
-        mpz_add(pos, a, b);
-        mpz_div_ui(pos, pos, 2);
+    file = fopen(path, "r");
+    if (file == NULL)
+        return 1;
 
-        mpz_add(pos, pos, dist);
-        mpz_powm(pos, g, pos, p);
-    }
-    else
-    {
-        /* start with h * g ^dist */
-        mpz_powm(pos, g, dist, p);
-        mpz_mul(pos, h, pos);
-        mpz_mod(pos, pos, p);
-    }
+    while (fscanf(file, "%lu %u %lu %lu %lu", &f_bits, &f_herd, &r, &dp_bits, &seed) == 5)
+        if (f_bits == bits && f_herd == herd && r >= POLLARD_JUMPS_MIN && r <= POLLARD_JUMPS_MAX)
+        {
+            params->r = r;
+            params->dp_bits = dp_bits;
+            params->seed = seed;
+            ret = 0;
+        }
 
-    mpz_init(step);
-    for (mpz_set_ui(step, 0); mpz_cmp(step, order_g) < 0; mpz_add_ui(step, step, 1))
-    {
-        if (finish)
-            break;
+    (void)fclose(file);
 
-            str = mpz_get_str(NULL, 2, pos);
-            index = (int)(hash(str, (size_t)strlen(str)) % r);
+    return ret;
+}
 
-            FREE(str);
+static int pollard_params_save(unsigned long bits, unsigned int herd, const Pollard_params *params)
+{
+    FILE *file;
+    const char *path;
 
-            mpz_mul(pos, pos, jumps[index]);
-            mpz_mod(pos, pos, p);
+    TRACE();
 
-            mpz_add(dist, dist, dists[index]);
+    path = getenv(POLLARD_TUNE_FILE_ENV);
+    if (path == NULL || *path == '\0')
+        return 0;
 
-        if (mpz_sizeinbase(pos, 2) < POLLARD_TRESHOLD)
-        {
-#pragma omp critical
-            {
-                if (!finish)
-                {
-                    triple = pollard_triple_create(type, dist, pos);
-                    if (darray_get_num_entries(set) > 0 && darray_search_first(set, (void *)&triple, (void *)&pt_p) != -1 && pt_p->type != triple->type)
-                    {
-                        /* x = (a + b) / 2 + dTAME - dWILD */
-                        mpz_init(x);
-                        mpz_add(x, a, b);
-                        mpz_div_ui(x, x, 2);
+    file = fopen(path, "a");
+    if (file == NULL)
+        ERROR("fopen error\n", 1);
 
-                        if (triple->type == KANGAROO_TAME)
-                        {
-                            mpz_add(x, x, triple->dist);
-                            mpz_sub(x, x, pt_p->dist);
-                        }
-                        else
-                        {
-                            mpz_add(x, x, pt_p->dist);
-                            mpz_sub(x, x, triple->dist);
-                        }
+    (void)fprintf(file, "%lu %u %lu %lu %lu\n", bits, herd, params->r, params->dp_bits, params->seed);
+    (void)fclose(file);
 
-                        mpz_set(res, x);
-                        mpz_clear(x);
+    return 0;
+}
 
-                        finish = true;
-                    }
-                    else
-                        darray_insert(set, (void *)&triple);
-                }
-            }
-        }
-    }
+static void pollard_table_params(const mpz_t width, unsigned long entries, Pollard_params *params)
+{
+    mpz_t temp;
 
-    mpz_clear(dist);
-    mpz_clear(pos);
-    mpz_clear(step);
+    mpz_init(temp);
+
+    /* 2^(2 * dp_bits) <= width / entries */
+    mpz_div_ui(temp, width, entries);
+    params->dp_bits = mpz_cmp_ui(temp, 0) == 0 ? 0 : ((unsigned long)mpz_sizeinbase(temp, 2) - 1) >> 1;
+
+    /* mean = width / (POLLARD_TABLE_SPAN * 2^dp_bits) */
+    mpz_tdiv_q_2exp(params->mean, width, params->dp_bits);
+    mpz_div_ui(params->mean, params->mean, POLLARD_TABLE_SPAN);
+    if (mpz_cmp_ui(params->mean, 0) == 0)
+        mpz_set_ui(params->mean, 1);
+
+    params->r = POLLARD_JUMPS_MIN + (unsigned long)mpz_sizeinbase(params->mean, 2) / 2;
+    params->r = MIN(params->r, POLLARD_JUMPS_MAX);
+    params->seed = (unsigned long)time(NULL);
+
+    mpz_clear(temp);
 }
-    mpz_mod(res, res, order_g);
 
-    /* cleanup */
-    mpz_clear(a);
-    mpz_clear(b);
-    mpz_clear(order_g);
-    mpz_clear(beta);
-    mpz_clear(v);
+static void pollard_mpz_to_bytes(unsigned char *buf, size_t bytes, const mpz_t op)
+{
+    const size_t size = (mpz_sizeinbase(op, 2) + 7) >> 3;
+
+    (void)memset(buf, 0, bytes);
+    if (mpz_cmp_ui(op, 0) == 0 || size > bytes)
+        return;
 
-    for (i = 0; i < r; ++i)
+    (void)mpz_export(buf + bytes - size, NULL, 1, 1, 1, 0, op);
+}
+
+static long pollard_table_search(const unsigned char *records, size_t entries, size_t bytes, const unsigned char *key)
+{
+    size_t left = 0;
+    size_t right = entries;
+    size_t middle;
+    int cmp;
+
+    while (left < right)
     {
-        mpz_clear(dists[i]);
-        mpz_clear(jumps[i]);
+        middle = left + ((right - left) >> 1);
+        cmp = memcmp(records + middle * (bytes << 1), key, bytes);
+        if (cmp == 0)
+            return (long)middle;
+
+        if (cmp < 0)
+            left = middle + 1;
+        else
+            right = middle;
     }
 
-    FREE(dists);
-    FREE(jumps);
+    return -1;
+}
+
+static Pollard_triple *pollard_triple_create(kangaroo_t type, const mpz_t dist, const mpz_t pos)
+{
+    Pollard_triple *pt;
+
+    pt = (Pollard_triple *)malloc(sizeof(Pollard_triple));
+    if (pt == NULL)
+        ERROR("Malloc error\n", NULL);
+
+    mpz_init(pt->pos);
+    mpz_init(pt->dist);
+
+    pt->type = type;
+    mpz_set(pt->pos, pos);
+    mpz_set(pt->dist, dist);
+
+    return pt;
+}
+
+static void pollard_triple_destroy(Pollard_triple *pt)
+{
+    if (pt == NULL)
+        return;
+
+    mpz_clear(pt->pos);
+    mpz_clear(pt->dist);
+
+    FREE(pt);
+}
+
+static int pollard_triple_cmp(const Pollard_triple *pt1, const Pollard_triple *pt2)
+{
+    return mpz_cmp(pt1->pos, pt2->pos);
+}
+
+static void pollard_triple_destroy_wrapper(void *p)
+{
+    pollard_triple_destroy(*(Pollard_triple **)p);
+}
+
+static int pollard_triple_cmp_wrapper(const void *a, const void *b)
+{
+    Pollard_triple *pt1 = *(Pollard_triple **)a;
+    Pollard_triple *pt2 = *(Pollard_triple **)b;
+
+    return pollard_triple_cmp(pt1, pt2);
+}
+
+int pollard_lambda_parallel_dicsrete_log(const mpz_t g, const mpz_t h, const mpz_t p, mpz_t res)
+{
+    return pollard_lambda_parallel_dicsrete_log_tune(g, h, p, POLLARD_TUNE_AUTO, res);
+}
+
+int pollard_lambda_parallel_dicsrete_log_tune(const mpz_t g, const mpz_t h, const mpz_t p, pollard_tune_t mode, mpz_t res)
+{
+    Pollard_ctx *ctx;
+    mpz_t width;
+    int ret;
+
+    /* range [0, p - 1] */
+    mpz_init(width);
+    mpz_sub_ui(width, p, 1);
+
+    /* g is generator, so ord(g) = p - 1 */
+    ctx = pollard_ctx_create(g, p, width, width, mode, 0);
+    mpz_clear(width);
+
+    if (ctx == NULL)
+        ERROR("pollard_ctx_create error\n", 1);
+
+    ret = pollard_ctx_dicsrete_log(ctx, h, res);
+    pollard_ctx_destroy(ctx);
+
+    return ret;
+}
+
+Pollard_ctx *pollard_ctx_create(const mpz_t g, const mpz_t p, const mpz_t order, const mpz_t width, pollard_tune_t mode, unsigned int threads)
+{
+    const unsigned int nproc = threads == 0 ? (unsigned int)omp_get_max_threads() : threads;
+
+    Pollard_ctx *ctx;
+    Pollard_kangaroo *k;
+    unsigned long i;
+    unsigned long bits;
+
+    TRACE();
+
+    ctx = (Pollard_ctx *)malloc(sizeof(Pollard_ctx));
+    if (ctx == NULL)
+        ERROR("malloc error\n", NULL);
+
+    /* herd has the same number of tame and wild kangaroos, at least one of each */
+    ctx->herd = nproc < 2 ? 2 : nproc + (nproc & 1);
+    ctx->mode = mode;
+
+    ctx->tame = darray_create(DARRAY_SORTED, 0, sizeof(Pollard_triple *), pollard_triple_cmp_wrapper, pollard_triple_destroy_wrapper);
+    if (ctx->tame == NULL)
+    {
+        FREE(ctx);
+        ERROR("malloc error\n", NULL);
+    }
+
+    mpz_init_set(ctx->g, g);
+    mpz_init_set(ctx->p, p);
+    mpz_init_set(ctx->width, width);
+    mpz_init_set(ctx->order, order);
+    mpz_init(ctx->middle);
+    mpz_init(ctx->v);
+    mpz_init(ctx->params.mean);
+
+    /* range [0, width], tame kangaroos start in the middle */
+    mpz_div_ui(ctx->middle, width, 2);
+
+    /* mean = (herd * sqrt(width) / 4) */
+    mpz_sqrt(ctx->params.mean, width);
+    mpz_mul_ui(ctx->params.mean, ctx->params.mean, ctx->herd);
+    mpz_div_ui(ctx->params.mean, ctx->params.mean, 4);
+    if (mpz_cmp_ui(ctx->params.mean, 0) == 0)
+        mpz_set_ui(ctx->params.mean, 1);
+
+    /* v = mean / herd / 2 */
+    mpz_div_ui(ctx->v, ctx->params.mean, ctx->herd >> 1);
+    if (mpz_cmp_ui(ctx->v, 0) == 0)
+        mpz_set_ui(ctx->v, 1);
+
+    bits = (unsigned long)mpz_sizeinbase(width, 2);
+    if (mode == POLLARD_TUNE_STATIC)
+    {
+        ctx->params.r = calculate_max_jumps(ctx->params.mean);
+        ctx->params.seed = 0;
+        ctx->params.dp_bits = calculate_dp_bits(width, ctx->herd, POLLARD_DP_COST);
+    }
+    else if (mode == POLLARD_TUNE_AUTO || pollard_params_load(bits, ctx->herd, &ctx->params))
+    {
+        /* few random jumps are enough, r grows slowly with mean bit length */
+        ctx->params.r = POLLARD_JUMPS_MIN + (unsigned long)mpz_sizeinbase(ctx->params.mean, 2) / 2;
+        ctx->params.r = MIN(ctx->params.r, POLLARD_JUMPS_MAX);
+        ctx->params.seed = (unsigned long)time(NULL);
+        ctx->params.dp_bits = calculate_dp_bits(width, ctx->herd, POLLARD_DP_COST);
+    }
+
+    ctx->dists = (mpz_t *)malloc(sizeof(mpz_t) * ctx->params.r);
+    if (ctx->dists == NULL)
+        ERROR("malloc error\n", NULL);
+
+    ctx->jumps = (mpz_t *)malloc(sizeof(mpz_t) * ctx->params.r);
+    if (ctx->jumps == NULL)
+        ERROR("malloc error\n", NULL);
+
+    for (i = 0; i < ctx->params.r; ++i)
+    {
+        mpz_init(ctx->dists[i]);
+        mpz_init(ctx->jumps[i]);
+    }
+
+    pollard_jumps_create(mode, &ctx->params, g, p, ctx->dists, ctx->jumps);
+
+    /* calibrate only if params for this bit length has not been saved yet */
+    if (mode == POLLARD_TUNE_CALIBRATE && pollard_params_load(bits, ctx->herd, &ctx->params))
+    {
+        pollard_calibrate(g, p, width, ctx->herd, ctx->dists, ctx->jumps, &ctx->params);
+        (void)pollard_params_save(bits, ctx->herd, &ctx->params);
+    }
+
+    ctx->budget = calculate_budget(width, ctx->herd, ctx->params.dp_bits);
+
+    ctx->kangaroos = (Pollard_kangaroo *)malloc(sizeof(Pollard_kangaroo) * ctx->herd);
+    if (ctx->kangaroos == NULL)
+        ERROR("malloc error\n", NULL);
+
+    ctx->stats.steps = (uint64_t *)calloc(ctx->herd, sizeof(uint64_t));
+    if (ctx->stats.steps == NULL)
+        ERROR("malloc error\n", NULL);
+
+    ctx->stats.herd = ctx->herd;
+    ctx->stats.dps = 0;
+    ctx->stats.time = 0.0;
+
+    for (i = 0; i < ctx->herd; ++i)
+    {
+        k = &ctx->kangaroos[i];
+
+        k->type = ODD(i) ? KANGAROO_WILD : KANGAROO_TAME;
+        mpz_init(k->dist);
+        mpz_init(k->pos);
+
+        gmp_randinit_default(k->state);
+        gmp_randseed_ui(k->state, ctx->params.seed + i + 1);
+
+        if (k->type == KANGAROO_WILD)
+            continue;
+
+        /* tame kangaroo lives as long as context: start with dist = (i - 1) * v, pos = g^(middle + dist) */
+        mpz_set_ui(k->dist, (i + 2) >> 1);
+        mpz_mul(k->dist, k->dist, ctx->v);
+
+        mpz_add(k->pos, ctx->middle, k->dist);
+        mpz_powm(k->pos, g, k->pos, p);
+    }
+
+    return ctx;
+}
+
+void pollard_ctx_destroy(Pollard_ctx *ctx)
+{
+    unsigned long i;
+
+    TRACE();
+
+    if (ctx == NULL)
+        return;
+
+    for (i = 0; i < ctx->herd; ++i)
+    {
+        mpz_clear(ctx->kangaroos[i].dist);
+        mpz_clear(ctx->kangaroos[i].pos);
+        gmp_randclear(ctx->kangaroos[i].state);
+    }
+
+    for (i = 0; i < ctx->params.r; ++i)
+    {
+        mpz_clear(ctx->dists[i]);
+        mpz_clear(ctx->jumps[i]);
+    }
+
+    FREE(ctx->kangaroos);
+    FREE(ctx->stats.steps);
+    FREE(ctx->dists);
+    FREE(ctx->jumps);
+
+    mpz_clear(ctx->g);
+    mpz_clear(ctx->p);
+    mpz_clear(ctx->width);
+    mpz_clear(ctx->order);
+    mpz_clear(ctx->middle);
+    mpz_clear(ctx->v);
+    mpz_clear(ctx->params.mean);
+
+    darray_destroy_with_entries(ctx->tame);
+
+    FREE(ctx);
+}
+
+const Pollard_stats *pollard_ctx_get_stats(const Pollard_ctx *ctx)
+{
+    return &ctx->stats;
+}
+
+int pollard_ctx_dicsrete_log(Pollard_ctx *ctx, const mpz_t h, mpz_t res)
+{
+    Darray *wild;
+    Darray *own;
+    Darray *other;
+
+    Pollard_triple pt;
+    Pollard_triple *pt_p = &pt;
+    Pollard_triple *triple;
+    Pollard_kangaroo *k;
+
+    uint64_t steps;
+    mpz_t delta;
+    unsigned int tid;
+    unsigned int threads;
+    unsigned int i;
+
+    bool finish = false;
+    bool done;
+    bool moved;
+
+    TRACE();
+
+    ctx->stats.dps = 0;
+    ctx->stats.time = omp_get_wtime();
+    (void)memset(ctx->stats.steps, 0, sizeof(uint64_t) * ctx->herd);
+
+    if (mpz_cmp(ctx->g, h) == 0)
+    {
+        mpz_set_ui(res, 1);
+        ctx->stats.time = 0.0;
+        return 0;
+    }
+
+    /* tame distinguished points are independent of h and stay in ctx, wild are valid only for this h */
+    wild = darray_create(DARRAY_SORTED, 0, sizeof(Pollard_triple *), pollard_triple_cmp_wrapper, pollard_triple_destroy_wrapper);
+    if (wild == NULL)
+        ERROR("malloc error\n", 1);
+
+#pragma omp parallel num_threads(ctx->herd) private(k, tid, threads, i, steps, delta, triple, own, other, moved, done) firstprivate(pt_p) shared(ctx, h, wild, res, finish)
+{
+    /* team can be smaller than herd, then thread tid moves kangaroos tid, tid + threads, ... in turns */
+    tid = (unsigned int)omp_get_thread_num();
+    threads = (unsigned int)omp_get_num_threads();
+
+    mpz_init(delta);
+
+    for (i = tid; i < ctx->herd; i += threads)
+    {
+        k = &ctx->kangaroos[i];
+        if (k->type == KANGAROO_TAME)
+            continue;
+
+        /* start with dist = (i - 1) * v + rand(v), pos = h * g^dist */
+        mpz_set_ui(k->dist, (i + 1) >> 1);
+        mpz_mul(k->dist, k->dist, ctx->v);
+        mpz_urandomm(delta, k->state, ctx->v);
+        mpz_add(k->dist, k->dist, delta);
+
+        mpz_powm(k->pos, ctx->g, k->dist, ctx->p);
+        mpz_mul(k->pos, h, k->pos);
+        mpz_mod(k->pos, k->pos, ctx->p);
+    }
+
+    for (steps = 0; steps < ctx->budget; ++steps)
+    {
+        /* cancellation is checked rarely, it costs only one atomic load per POLLARD_CANCEL_STEPS */
+        if ((steps & (POLLARD_CANCEL_STEPS - 1)) == 0)
+        {
+#pragma omp atomic read
+            done = finish;
+
+            if (done)
+                break;
+        }
+
+        for (i = tid; i < ctx->herd; i += threads)
+        {
+            k = &ctx->kangaroos[i];
+
+            pollard_jump(ctx->params.r, ctx->dists, ctx->jumps, ctx->p, k->pos, k->dist);
+
+            if (mpz_scan1(k->pos, 0) < ctx->params.dp_bits)
+                continue;
+
+            moved = false;
+#pragma omp critical
+            {
+                if (!finish)
+                {
+                    ++ctx->stats.dps;
+                    triple = pollard_triple_create(k->type, k->dist, k->pos);
+                    own = k->type == KANGAROO_TAME ? ctx->tame : wild;
+                    other = k->type == KANGAROO_TAME ? wild : ctx->tame;
+
+                    if (darray_get_num_entries(other) > 0 && darray_search_first(other, (void *)&triple, (void *)&pt_p) != -1)
+                    {
+                        /* x = middle + dTAME - dWILD */
+                        mpz_set(res, ctx->middle);
+                        if (triple->type == KANGAROO_TAME)
+                        {
+                            mpz_add(res, res, triple->dist);
+                            mpz_sub(res, res, pt_p->dist);
+                        }
+                        else
+                        {
+                            mpz_add(res, res, pt_p->dist);
+                            mpz_sub(res, res, triple->dist);
+                        }
+
+#pragma omp atomic write
+                        finish = true;
+
+                        pollard_triple_destroy(triple);
+                    }
+                    else if (darray_get_num_entries(own) > 0 && darray_search_first(own, (void *)&triple, (void *)&pt_p) != -1)
+                    {
+                        /* kangaroo follows other from its herd, move it by random offset */
+                        pollard_triple_destroy(triple);
+                        moved = true;
+                    }
+                    else
+                        darray_insert(own, (void *)&triple);
+                }
+            }
+
+            /* outside critical section, powm is too expensive to serialize */
+            if (moved)
+            {
+                mpz_urandomm(delta, k->state, ctx->v);
+                mpz_add_ui(delta, delta, 1);
+                mpz_add(k->dist, k->dist, delta);
+
+                mpz_powm(delta, ctx->g, delta, ctx->p);
+                mpz_mul(k->pos, k->pos, delta);
+                mpz_mod(k->pos, k->pos, ctx->p);
+            }
+        }
+    }
+
+    for (i = tid; i < ctx->herd; i += threads)
+        ctx->stats.steps[i] = steps;
+
+    mpz_clear(delta);
+}
+    ctx->stats.time = omp_get_wtime() - ctx->stats.time;
+
+    darray_destroy_with_entries(wild);
+
+    /* every kangaroo has used its budget */
+    if (!finish)
+        ERROR("kangaroo budget exceeded\n", 1);
+
+    mpz_mod(res, res, ctx->order);
+
+    return 0;
+}
+
+int pollard_lambda_tame_table_create(const mpz_t g, const mpz_t p, const mpz_t width, unsigned long entries, const char *path)
+{
+    unsigned long i;
+    unsigned long walk;
+    unsigned long max_walk;
+    unsigned long found = 0;
+    uint64_t steps;
+    uint64_t budget;
+    size_t bytes;
+    unsigned char *buf;
+
+    mpz_t order;
+    mpz_t work;
+
+    Pollard_params params;
+    Pollard_table_header header;
+    mpz_t *dists;
+    mpz_t *jumps;
+
+    Darray *set;
+    Pollard_triple pt;
+    Pollard_triple *pt_p = &pt;
+    Pollard_triple *triple;
+
+    gmp_randstate_t state;
+    mpz_t dist;
+    mpz_t pos;
+
+    FILE *file;
+    bool finish = false;
+    bool done;
+
+    TRACE();
+
+    if (entries == 0)
+        ERROR("entries == 0\n", 1);
+
+    set = darray_create(DARRAY_SORTED, 0, sizeof(Pollard_triple *), pollard_triple_cmp_wrapper, pollard_triple_destroy_wrapper);
+    if (set == NULL)
+        ERROR("malloc error\n", 1);
+
+    mpz_init(order);
+    mpz_sub_ui(order, p, 1);
+
+    mpz_init(params.mean);
+    pollard_table_params(width, entries, &params);
+    max_walk = POLLARD_TABLE_WALK_MAX << params.dp_bits;
+
+    /* every entry needs walk of about 2^dp_bits steps, small interval may have not enough different distinguished points */
+    mpz_init_set_ui(work, entries);
+    mpz_mul_2exp(work, work, params.dp_bits);
+    budget = calculate_walk_budget(work, (unsigned int)omp_get_max_threads(), params.dp_bits);
+    mpz_clear(work);
+
+    dists = (mpz_t *)malloc(sizeof(mpz_t) * params.r);
+    if (dists == NULL)
+        ERROR("malloc error\n", 1);
+
+    jumps = (mpz_t *)malloc(sizeof(mpz_t) * params.r);
+    if (jumps == NULL)
+        ERROR("malloc error\n", 1);
+
+    for (i = 0; i < params.r; ++i)
+    {
+        mpz_init(dists[i]);
+        mpz_init(jumps[i]);
+    }
+
+    pollard_jumps_create(POLLARD_TUNE_AUTO, &params, g, p, dists, jumps);
+
+    /* only tame kangaroos, each one starts in random place of interval and stops at first distinguished point */
+#pragma omp parallel private(dist, pos, state, steps, walk, triple, done) shared(g, p, width, order, set, jumps, dists, params, max_walk, budget, entries, found, finish)
+{
+    mpz_init(dist);
+    mpz_init(pos);
+
+    gmp_randinit_default(state);
+    gmp_randseed_ui(state, params.seed + (unsigned long)omp_get_thread_num() + 1);
+
+    done = false;
+    steps = 0;
+
+    while (!done && steps < budget)
+    {
+        mpz_urandomm(dist, state, width);
+        mpz_powm(pos, g, dist, p);
+
+        /* start costs one step, so cancellation is checked also when walks end at once */
+        ++steps;
+        for (walk = 0; walk < max_walk && steps < budget && mpz_scan1(pos, 0) < params.dp_bits; ++walk, ++steps)
+        {
+            /* cancellation is checked rarely, it costs only one atomic load per POLLARD_CANCEL_STEPS */
+            if ((steps & (POLLARD_CANCEL_STEPS - 1)) == 0)
+            {
+#pragma omp atomic read
+                done = finish;
+
+                if (done)
+                    break;
+            }
+
+            pollard_jump(params.r, dists, jumps, p, pos, dist);
+        }
+
+        if (done || mpz_scan1(pos, 0) < params.dp_bits)
+            continue;
+
+        /* g^dist = g^(dist mod order), so log has no more bytes than p */
+        mpz_mod(dist, dist, order);
+
+#pragma omp critical
+        {
+            if (!finish)
+            {
+                triple = pollard_triple_create(KANGAROO_TAME, dist, pos);
+
+                /* walks merged, the same point is in table */
+                if (found > 0 && darray_search_first(set, (void *)&triple, (void *)&pt_p) != -1)
+                    pollard_triple_destroy(triple);
+                else
+                {
+                    darray_insert(set, (void *)&triple);
+                    ++found;
+                }
+
+                if (found >= entries)
+                {
+#pragma omp atomic write
+                    finish = true;
+                }
+            }
+
+            done = finish;
+        }
+    }
+
+    gmp_randclear(state);
+    mpz_clear(dist);
+    mpz_clear(pos);
+}
+
+    /* every tame kangaroo has used its budget */
+    if (!finish)
+    {
+        mpz_clear(order);
+        mpz_clear(params.mean);
+
+        for (i = 0; i < params.r; ++i)
+        {
+            mpz_clear(dists[i]);
+            mpz_clear(jumps[i]);
+        }
+
+        FREE(dists);
+        FREE(jumps);
+
+        darray_destroy_with_entries(set);
+
+        ERROR("kangaroo budget exceeded\n", 1);
+    }
+
+    bytes = (mpz_sizeinbase(p, 2) + 7) >> 3;
+    buf = (unsigned char *)malloc(bytes);
+    if (buf == NULL)
+        ERROR("malloc error\n", 1);
+
+    file = fopen(path, "wb");
+    if (file == NULL)
+        ERROR("fopen error\n", 1);
+
+    (void)memset(&header, 0, sizeof(header));
+    (void)memcpy(header.magic, POLLARD_TABLE_MAGIC, sizeof(header.magic));
+    header.bytes = (uint64_t)bytes;
+    header.entries = (uint64_t)darray_get_num_entries(set);
+    header.r = (uint64_t)params.r;
+    header.dp_bits = (uint64_t)params.dp_bits;
+    header.seed = (uint64_t)params.seed;
+
+    (void)fwrite(&header, sizeof(header), 1, file);
+
+    pollard_mpz_to_bytes(buf, bytes, g);
+    (void)fwrite(buf, bytes, 1, file);
+
+    pollard_mpz_to_bytes(buf, bytes, p);
+    (void)fwrite(buf, bytes, 1, file);
+
+    pollard_mpz_to_bytes(buf, bytes, width);
+    (void)fwrite(buf, bytes, 1, file);
+
+    pollard_mpz_to_bytes(buf, bytes, params.mean);
+    (void)fwrite(buf, bytes, 1, file);
+
+    /* set is sorted by pos, so records are sorted too */
+    for_each_data(set, Darray, triple)
+    {
+        pollard_mpz_to_bytes(buf, bytes, triple->pos);
+        (void)fwrite(buf, bytes, 1, file);
+
+        pollard_mpz_to_bytes(buf, bytes, triple->dist);
+        (void)fwrite(buf, bytes, 1, file);
+    }
+
+    (void)fclose(file);
+
+    /* cleanup */
+    FREE(buf);
+    mpz_clear(order);
+    mpz_clear(params.mean);
+
+    for (i = 0; i < params.r; ++i)
+    {
+        mpz_clear(dists[i]);
+        mpz_clear(jumps[i]);
+    }
+
+    FREE(dists);
+    FREE(jumps);
 
     darray_destroy_with_entries(set);
 
+    return 0;
+}
+
+int pollard_lambda_tame_table_dicsrete_log(const mpz_t g, const mpz_t h, const mpz_t p, const char *path, mpz_t res)
+{
+    unsigned long i;
+    unsigned long walk;
+    unsigned long max_walk;
+    uint64_t steps;
+    uint64_t budget;
+    long index;
+    size_t bytes;
+    size_t size;
+    unsigned char *data;
+    unsigned char *records;
+    unsigned char *key;
+
+    int fd;
+    struct stat st;
+
+    mpz_t order;
+    mpz_t width;
+    mpz_t temp;
+
+    Pollard_params params;
+    Pollard_table_header header;
+    mpz_t *dists;
+    mpz_t *jumps;
+
+    gmp_randstate_t state;
+    mpz_t dist;
+    mpz_t pos;
+    mpz_t x;
+
+    bool finish = false;
+    bool done;
+
+    TRACE();
+
+    if (mpz_cmp(g, h) == 0)
+    {
+        mpz_set_ui(res, 1);
+        return 0;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        ERROR("open error\n", 1);
+
+    if (fstat(fd, &st) || (size_t)st.st_size < sizeof(header))
+    {
+        (void)close(fd);
+        ERROR("incorrect table file\n", 1);
+    }
+
+    size = (size_t)st.st_size;
+    data = (unsigned char *)mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    (void)close(fd);
+
+    if (data == MAP_FAILED)
+        ERROR("mmap error\n", 1);
+
+    (void)memcpy(&header, data, sizeof(header));
+    bytes = (size_t)header.bytes;
+    if (memcmp(header.magic, POLLARD_TABLE_MAGIC, sizeof(header.magic)) ||
+        bytes == 0 ||
+        size < sizeof(header) + (4 + 2 * (size_t)header.entries) * bytes)
+    {
+        (void)munmap(data, size);
+        ERROR("incorrect table file\n", 1);
+    }
+
+    mpz_init(order);
+    mpz_init(width);
+    mpz_init(temp);
+    mpz_init(params.mean);
+
+    /* table must be created for the same g and p */
+    mpz_import(temp, bytes, 1, 1, 1, 0, data + sizeof(header));
+    if (mpz_cmp(temp, g))
+    {
+        (void)munmap(data, size);
+        ERROR("table created for other g\n", 1);
+    }
+
+    mpz_import(temp, bytes, 1, 1, 1, 0, data + sizeof(header) + bytes);
+    if (mpz_cmp(temp, p))
+    {
+        (void)munmap(data, size);
+        ERROR("table created for other p\n", 1);
+    }
+
+    mpz_import(width, bytes, 1, 1, 1, 0, data + sizeof(header) + 2 * bytes);
+    mpz_import(params.mean, bytes, 1, 1, 1, 0, data + sizeof(header) + 3 * bytes);
+    records = data + sizeof(header) + 4 * bytes;
+
+    params.r = (unsigned long)header.r;
+    params.dp_bits = (unsigned long)header.dp_bits;
+    params.seed = (unsigned long)header.seed;
+    max_walk = POLLARD_TABLE_WALK_MAX << params.dp_bits;
+
+    mpz_sub_ui(order, p, 1);
+
+    /* wild walks hit table after about 2 * sqrt(width / entries) steps, h out of interval never hits it */
+    mpz_div_ui(temp, width, (unsigned long)MAX(header.entries, 1));
+    budget = calculate_budget(temp, (unsigned int)omp_get_max_threads(), params.dp_bits);
+
+    /* wild kangaroo starts in x + [0, width / POLLARD_TABLE_SPAN) */
+    mpz_div_ui(temp, width, POLLARD_TABLE_SPAN);
+    mpz_add_ui(temp, temp, 1);
+
+    dists = (mpz_t *)malloc(sizeof(mpz_t) * params.r);
+    if (dists == NULL)
+        ERROR("malloc error\n", 1);
+
+    jumps = (mpz_t *)malloc(sizeof(mpz_t) * params.r);
+    if (jumps == NULL)
+        ERROR("malloc error\n", 1);
+
+    for (i = 0; i < params.r; ++i)
+    {
+        mpz_init(dists[i]);
+        mpz_init(jumps[i]);
+    }
+
+    pollard_jumps_create(POLLARD_TUNE_AUTO, &params, g, p, dists, jumps);
+
+    /* only wild kangaroos, tame are in table */
+#pragma omp parallel private(dist, pos, x, state, steps, walk, key, index, done) shared(g, h, p, order, temp, records, header, bytes, jumps, dists, params, max_walk, budget, res, finish)
+{
+    mpz_init(dist);
+    mpz_init(pos);
+    mpz_init(x);
+
+    key = (unsigned char *)malloc(bytes);
+
+    gmp_randinit_default(state);
+    gmp_randseed_ui(state, (unsigned long)time(NULL) + (unsigned long)omp_get_thread_num());
+
+    done = false;
+    steps = 0;
+
+    while (!done && steps < budget && key != NULL)
+    {
+        /* pos = h * g^dist = g^(x + dist) */
+        mpz_urandomm(dist, state, temp);
+        mpz_powm(pos, g, dist, p);
+        mpz_mul(pos, pos, h);
+        mpz_mod(pos, pos, p);
+
+        /* start costs one step, so walks ending at once also use budget */
+        ++steps;
+        for (walk = 0; walk < max_walk && steps < budget && mpz_scan1(pos, 0) < params.dp_bits; ++walk, ++steps)
+        {
+            /* cancellation is checked rarely, it costs only one atomic load per POLLARD_CANCEL_STEPS */
+            if ((steps & (POLLARD_CANCEL_STEPS - 1)) == 0)
+            {
+#pragma omp atomic read
+                done = finish;
+
+                if (done)
+                    break;
+            }
+
+            pollard_jump(params.r, dists, jumps, p, pos, dist);
+        }
+
+        if (done || mpz_scan1(pos, 0) < params.dp_bits)
+            continue;
+
+        pollard_mpz_to_bytes(key, bytes, pos);
+        index = pollard_table_search(records, (size_t)header.entries, bytes, key);
+        if (index == -1)
+            continue;
+
+        /* g^log = g^(x + dist) --> x = log - dist */
+        mpz_import(x, bytes, 1, 1, 1, 0, records + (size_t)index * (bytes << 1) + bytes);
+        mpz_sub(x, x, dist);
+        mpz_mod(x, x, order);
+
+#pragma omp critical
+        {
+            if (!finish)
+            {
+                mpz_set(res, x);
+
+#pragma omp atomic write
+                finish = true;
+            }
+        }
+
+        done = true;
+    }
+
+    if (key != NULL)
+        FREE(key);
+
+    gmp_randclear(state);
+    mpz_clear(dist);
+    mpz_clear(pos);
+    mpz_clear(x);
+}
+
+    /* cleanup */
+    (void)munmap(data, size);
+
+    mpz_clear(order);
+    mpz_clear(width);
+    mpz_clear(temp);
+    mpz_clear(params.mean);
+
+    for (i = 0; i < params.r; ++i)
+    {
+        mpz_clear(dists[i]);
+        mpz_clear(jumps[i]);
+    }
+
+    FREE(dists);
+    FREE(jumps);
+
+    /* every wild kangaroo has used its budget */
+    if (!finish)
+        ERROR("kangaroo budget exceeded\n", 1);
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,271 @@
+#!/bin/bash
+
+#Author: Michal Kukowski
+#email: michalkukowski10@gmail.com
+
+# This script compares digits extraction for prime powers f^e:
+# linear O(e^2) exponentiations vs divide and conquer O(e log e) exponentiations.
+# Only time of f^e subproblem is measured
+# Usage: ./bench.sh [repeats]
+
+exec=./pohling.out
+repeats=${1:-3}
+
+# g h p [2 1] f e q 1, where p - 1 = [2] * f^e * q
+instances=(
+    "3 \
+4129945870591111452680159721675066035607671622674909527183240565\
+7975390691433865628112355122755739612342187019098938142456916354\
+7551534333025700334677780248903889486903919242585752090248400120\
+4948725015034448620953847448113048719313315302703491218416078724\
+1242173109286207760016477043991364606982645892803395 \
+4642545302402688783653550330390560922511542067289323094702553321\
+8172125755143263898100203038832165665946694271917936671051620755\
+7691432450723688025741426091067142491064486155143378358015962839\
+4210327163201676190052876045300399122177669930563544141890148061\
+7691563312880991836765950312443732637036902088694689 \
+2 \
+5 \
+1450795407000840244891734478247050288284856896027913467094547913\
+0678789298482269968156313449635051770608341959974355209703631486\
+1778572640851152508044195653458482028457651923482305736879988387\
+3190727238500523809391523764156374725680521853301107544340671269\
+302861353527530994898935947263866644907403190271709 \
+1"
+    "3 \
+6877066640360285763795008627540691948683191762476982693546011929\
+7479930012296651478177324238520589719088181830167054018751190330\
+2695629874105480216629789605695005860046849084414729287518302207\
+9407654585275375271289354434231626120978542362868775890626014011\
+1945056455504661529205624515855613810726655103874220 \
+8855407720261060175492227554650014118468683010502299699304416093\
+5459696128847770944247970913776380212985873802831644626477194116\
+4068315132621220420463286559365771127710724320186293130327698413\
+9343435303991509957633178964550120761028233344883760728183814231\
+8111605410370436486801058367787392547635061631249153 \
+2 \
+8 \
+3459143640726976631051651388535161765026829300977460820040787536\
+5413943800331160525096863638193898520697606954231111182217653951\
+7214185598680164226743471312252254346762001687572770754034257192\
+9431029415621683577200460533027390922276653650345219034446802434\
+30123458634259517526566634249169502139199459497067 \
+1"
+    "3 \
+1914464393539519299067524193685989478615624139734236152340454857\
+3737652196703376396176999256786092089203728524302580582039996230\
+8989394289931444851379809192179754718315813021885338343699946568\
+2598463734363371950071675308112004626737743063249688811221775635\
+0621502257446172937253832362615299219524593290545101 \
+5334322472510153224592122718338620189038740649494406658738878440\
+8341149525039182263262567350152368625536661909171906925033650954\
+7422910557563071863021629260167467112025188670734235486202337323\
+2690314445842682609191340763257360859458822560571446920120395013\
+0143960644770465122391629575674484554292528219881473 \
+2 \
+16 \
+8139530139938588294360538815824310591184601821127939847929196839\
+6516646614134494420261485824817457009180697493243266181997148063\
+2664353267765917759737593475597331408729841111349846628116359441\
+0233023751591007399278779240810181975492588135637583801453239460\
+77636118236854021032587121210853340977364017027 \
+1"
+    "3 \
+3751352181644979190811719139796456803073067657596894403823454707\
+0687237486181673788709116843927267297341675164066280795756014710\
+6905994531264640625398052531550724601955043604572963071129348325\
+2923299347007954780488315144440659689071112769987860364590105677\
+8452603525915388828293535730807180899690500203596665 \
+6800225925002343157370415071367449339310084851941263952178989559\
+1885807955372967151753090622143055490804115109502320167097955300\
+0118841453464819729566102900651684430999521509694169106457631259\
+0853593767484511491210392132990024167916561761732071019303110606\
+2805737735512543462647414369181332255055629414039553 \
+2 \
+24 \
+4053250506521667931896695537190109097546389610732355089294308161\
+2518911335094551534505540503348741227867671912611913780628416121\
+0130954655089866953829588234813025254606915420111518565689105545\
+9292884926488704378134245951765790085742808438379806887688106659\
+818037613362821546950782201837380662861801947 \
+1"
+    "3 \
+8123503846116160788996157466142116263879893576532690693533579181\
+8618581775064014955752821035819199733970653956555707017070345536\
+8420915615233298053576914700539613041191061668542020711931392760\
+2078731363085044317776169749174265111070201585854729765517341673\
+1923765280300697061448861022035735703717993920485956 \
+8649963280660824511629577472531778346779407716947511295001361966\
+1660019823586494029946752124363554040385853797428860524240626869\
+8357087515389367324461708494664743547424664810528173608473884037\
+8881642464259376460747168809709903097058050589883432119566459728\
+6680501832668669141639965858115597064755611688763393 \
+2 \
+32 \
+2013976518218597516331257641439274499839965188165081500774566541\
+9301954056971355814008682995187946138993337237608819390703138632\
+1959338969408852822254809666114101081021284873254637608414954514\
+6823311798334907847630597839530069170766056186958083910766630370\
+3254205601445555021436877049998286428105927 \
+1"
+    "3 \
+6623047284425600377404392684253304992992006588335875454504074738\
+7660396961139282604731027464409828670529011674207663575067536113\
+7449689177966715421851867866736283301950905743497341706441501927\
+1080926828330730336262115458968457399815774185573568025669149972\
+6973900550908093347518624845684235503712475819984586 \
+7330071172087268139024021677154578076044287078309643848119404832\
+1210891432323153778023222616730792902154056017787956464125120100\
+3486807533784283363442553604422205533428135628846824635903930553\
+3323676282186270321829284693242891700862675723102527078778533272\
+6265346622428632868820089325355633560486825460498433 \
+2 \
+48 \
+2604164411965565811266295411440757617087728831361077598714148291\
+5351848046840343108251837597581894422004486961621678796108312816\
+7944809495460945698909879412647045716308062292244622652469818487\
+9484470955257176542058518255815219682198842478407572925923763759\
+43762477840083963332134293457029747147 \
+1"
+    "3 \
+3726406213613822083120667125078149310157764237853734519820808871\
+9261980601620200963792974670522716592947220554250040142191956684\
+5589963399089342756737301294417157405960523610669068999085935589\
+1134682323855032956516707613847497895053707574209875263102198868\
+5952201303883552773811778686667366909904332445733934 \
+8192297872056235972821207930020036736015279325778704666730581712\
+8978625482958038531573610362061321074385022328986043731233583272\
+5836765787206926679743233388668904595239244775890662861298523241\
+6982549915071053069940119302392038377462290135329506717276988732\
+5098935454865902324672519738060799356938805818949633 \
+2 \
+64 \
+4441053575265873044735204716127015059376437875793700735873639042\
+7732637047442803836788590626350197644147745550474955706522937151\
+4328264075082844017753753360701050669650150047016293447791812134\
+1072100417244658689737922683394968902387554948886628449539642654\
+093459192840147738919776429872277 \
+1"
+    "2 \
+5806360692100450543179670952382858725203479152518891312921756413\
+5407250988819227754520855986569989036542784584582311952146909555\
+6971082597821486040974845747210580181041989626393431779076643511\
+6819360886164161452665107332618761685359136016789052373577612099\
+5617168859739835144632848550427463471886085323221935 \
+6527769840185793148232305370021127442707644304771428078306509982\
+9014172604096004001190651957207892472105360622414455448794169954\
+2280906508809556906830892019362238858283700380820062548005174706\
+7704698662662229876566507419493027406659716980425449791924313715\
+3798882891966468779546604158071932451508102865217227 \
+2 \
+1 \
+257 \
+5 \
+2911181086846453474083803367023067462484425251510811361028541436\
+2206969098427869735912518024979919263152896852413337863218445338\
+3200762975720550116530040111985585512454853832761272715183338015\
+9183630893949680133383783878418695910075284150178911719205206099\
+6492902938419534616688676045304216222309 \
+1"
+    "5 \
+1668236815450021600857791747733939318374192059832749672426786517\
+6239720163234703115928423189859504199238345363954348518698703012\
+4230972369124473714403153201030420245393391229273836647768858572\
+1217394688161235390540402798314464064980159690992614098794142788\
+4621370434178332623783091605398346650492409972309210 \
+9220519591486308573250399544460042862896022247617411512165821393\
+1595607368536493611982220909541489250236655759282177349718058336\
+7571557856526310986245741728311049943644377310285308913388968849\
+8862638380501771131695211995018985801905325109069563618395419267\
+6391450954714768597380276220936551434031973188728543 \
+2 \
+1 \
+257 \
+8 \
+2422481184970968050405024842214530113980228028635747524179269464\
+7721276407587712122997280060867250401638508419300659952022026263\
+4087414818640402291988118393323780271312897648071743339767503597\
+9016169293456946811494736523471194874920594904759636601433040017\
+661490909142081122772661746287471 \
+1"
+    "2 \
+2539586979145021481763155728077104892081924529053942993842970233\
+4586076196811467500182853303001690698988053652718191023448426131\
+0448918526097432996067899375369080109594727323500641036826245035\
+1059351978864825064751114418913480430463058803052640678929750510\
+2497233345939986344380774321412180031833493986999671 \
+8569413495325563518897535151300149989924476548492967860782676361\
+7035305729643395768883688561705916278218388544028419680280174212\
+1136498071896314579766039528377517209769897825968534162940091382\
+2172984022464948190218623773543630666361225191194660853316345646\
+7431685894003902489194854887623689103581974323638867 \
+2 \
+1 \
+257 \
+16 \
+1183017394025644496699648427912524462709123399995861811808349273\
+5084075807604161833878698825667361620169487583792929393065119331\
+5999554951577821009528005652414452149655181731898535248433834834\
+1594017290826712313861030323385447783233474832723658953166909532\
+24762665486633 \
+1"
+    "2 \
+6138715062170400683465520916410286676181368149819130644776263094\
+6068957601377318269235219516703244376900323484480631587780662286\
+7086580272680077501904946669918039751317687622827202991751466232\
+2094498950915515772349122364845371497928098866681513256847992919\
+7060643426480291921112192943914763207957759926731537 \
+8256793046152536556339876935185278931788594446874963098828859095\
+7825629814393760832333707301119414160542649147541324677634423163\
+0538431798445831858892079753134338598163516319317341166769783699\
+9120705552914594435842443421610885249464333090362688970759843746\
+4420557697750148269161952732849102116824801491207579 \
+2 \
+1 \
+257 \
+32 \
+3147179089300614130516308103427912087623271076549483848476221474\
+6204678792325466544863942848908764210703633218251156803351391119\
+7693422754807847618811416969979235733338717750602378802135705229\
+427715727172936757382365095095831478989 \
+1"
+    "5 \
+7833568199895016666771545367464821633354012558264136135324049888\
+8612332077595682833984851061010354016675170445010478504771482630\
+6669085561791194119912985244671418669242263576990431911407424154\
+3961221897786350820981042468521221368835744608051468229891826653\
+7814883889384457931365238701223409636039241156160146 \
+1028290246625089773209378237371295106442194310931759368867970544\
+5612928350670409196352951122492165759347134771197131183912734157\
+7962443496549229026961685010833588942289429305291653573380185551\
+5581918826090205949155167054824245009922235541661679920405414376\
+13862078602899934778489494570493341321567321378691767 \
+2 \
+1 \
+257 \
+64 \
+2987898413341566905762095916748230004180297174198587587332665653\
+1933852328126647925122875217984630432781516071029338012960135107\
+42241574839798959209614683 \
+1"
+)
+
+for instance in "${instances[@]}"; do
+    set -- $instance
+    if [ $# -eq 9 ]; then
+        f=$6
+        e=$7
+    else
+        f=$4
+        e=$5
+    fi
+
+    for digits in linear tree; do
+        total=0
+        for ((i = 0; i < repeats; ++i)); do
+            t=$($exec $instance $digits | grep "DIGITS = .*, f = $f," | awk '{print $(NF - 1)}')
+            total=$(echo "$total + $t" | bc -l)
+        done
+        printf "f = %-4s e = %-3s %-8s avg = %s [s]\n" $f $e $digits $(echo "scale=6; $total / $repeats" | bc -l)
+    done
+done
@@ -0,0 +1,27 @@
+#!/bin/bash
+
+#Author: Michal Kukowski
+#email: michalkukowski10@gmail.com
+
+# This script compares crt methods: naive (current), Garner mixed radix and product / remainder tree
+# for 10, 100 and 10000 random prime moduli of several sizes, AUTO is the method chosen by crt
+# Usage: ./bench_crt.sh [repeats]
+
+exec=./pohling.out
+repeats=${1:-3}
+
+counts=(10 100 10000)
+bits=(64 1024)
+
+for count in "${counts[@]}"; do
+    for b in "${bits[@]}"; do
+        for method in NAIVE GARNER TREE AUTO; do
+            total=0
+            for ((i = 0; i < repeats; ++i)); do
+                t=$($exec crt $count $b $i | grep "CRT $method TIME" | awk '{print $(NF - 1)}')
+                total=$(echo "$total + $t" | bc -l)
+            done
+            printf "moduli = %-6s bits = %-5s %-7s avg = %s [s]\n" $count $b $method $(echo "scale=6; $total / $repeats" | bc -l)
+        done
+    done
+done
@@ -0,0 +1,27 @@
+#!/bin/bash
+
+#Author: Michal Kukowski
+#email: michalkukowski10@gmail.com
+
+# This script compares BSGS with kangaroo (and dense table below 2^24) in subgroups of prime order 2^20 .. 2^48
+# for single limb and 1024 bits p. Build is paid once, query is average of few targets
+# Usage: ./bench_dlog.sh [baby / giant ratio]
+
+exec=./pohling.out
+ratio=${1:-1}
+
+for p_bits in 64 1024; do
+    for ((f_bits = 16; f_bits <= 48; f_bits += 4)); do
+        out=$($exec dlog $f_bits $p_bits $ratio)
+        bsgs_build=$(echo "$out" | grep "BSGS BABY" | awk '{print $(NF - 1)}')
+        bsgs_query=$(echo "$out" | grep "BSGS QUERY" | awk '{print $(NF - 1)}')
+        kangaroo_build=$(echo "$out" | grep "KANGAROO BUILD" | awk '{print $(NF - 1)}')
+        kangaroo_query=$(echo "$out" | grep "KANGAROO QUERY" | awk '{print $(NF - 1)}')
+        dense_build=$(echo "$out" | grep "DENSE TABLE =" | awk '{print $(NF - 1)}')
+        dense_query=$(echo "$out" | grep "DENSE TABLE QUERY" | awk '{print $(NF - 1)}')
+        status=$(echo "$out" | tail -n 1)
+
+        printf "p = %-4s f = 2^%-2s BSGS build = %s query = %s | KANGAROO build = %s query = %s | DENSE build = %s query = %s %s\n" \
+            $p_bits $f_bits $bsgs_build $bsgs_query $kangaroo_build $kangaroo_query ${dense_build:--} ${dense_query:--} $status
+    done
+done
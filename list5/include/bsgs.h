@@ -0,0 +1,109 @@
+#ifndef BSGS_H
+#define BSGS_H
+
+/*
+    Implementation of parallel Baby Step Giant Step discrete logarithm algo
+
+    Find x such that
+    g^x = h (mod) P, where x is in [0, ord(g))
+
+    Baby steps g^j, j in [0, m) are stored in open addressing table as 32 bit fingerprint and j,
+    giant steps h * g^(-m * i) are searched in table. Table is built in parallel once per context
+    and reused by all queries, so for ord(g) <= m context works as direct lookup table.
+    m = sqrt(ord(g) * ratio) in memory budget, ratio > 1 means more baby steps and cheaper queries.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+
+    LICENCE: GPL 3.0+
+*/
+
+#include <gmp.h>
+#include <stdint.h>
+
+/*
+    Solver context for single group <g>, baby steps table survive across calls
+*/
+typedef struct Bsgs_ctx Bsgs_ctx;
+
+/*
+    Create solver context, baby steps are computed in parallel
+
+    PARAMS
+    @IN g - generator
+    @IN p - prime
+    @IN order - ord(g), must fit in unsigned long
+    @IN memory - max size of table in bytes, 0 means no limit
+    @IN ratio - baby steps / giant steps, 1 means m = sqrt(order)
+    @IN threads - number of threads, 0 means all available threads
+
+    RETURN
+    NULL iff failure
+    Pointer to new context iff success
+*/
+Bsgs_ctx *bsgs_ctx_create(const mpz_t g, const mpz_t p, const mpz_t order, size_t memory, double ratio, unsigned int threads);
+
+/*
+    Destroy solver context
+
+    PARAMS
+    @IN ctx - pointer to context
+
+    RETURN
+    This is a void function
+*/
+void bsgs_ctx_destroy(Bsgs_ctx *ctx);
+
+/*
+    Function find X such that g^x = h (mod)p using precomputed context,
+    giant steps are split between threads
+
+    PARAMS
+    @IN ctx - context created for g and p
+    @IN h - result of power, must be in <g>
+    @OUT x - discrete log in [0, ord(g))
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int bsgs_ctx_discrete_log(Bsgs_ctx *ctx, const mpz_t h, mpz_t x);
+
+/*
+    Set number of threads used by queries, table is already built. Many queries
+    running concurrently in one context need less threads per query
+
+    PARAMS
+    @IN ctx - pointer to context
+    @IN threads - number of threads, 0 means all available threads
+
+    RETURN
+    This is a void function
+*/
+void bsgs_ctx_set_threads(Bsgs_ctx *ctx, unsigned int threads);
+
+/*
+    Get number of baby steps used by context created with the same params
+
+    PARAMS
+    @IN order - ord(g)
+    @IN memory - max size of table in bytes, 0 means no limit
+    @IN ratio - baby steps / giant steps
+
+    RETURN
+    Number of baby steps
+*/
+unsigned long bsgs_baby_steps(const mpz_t order, size_t memory, double ratio);
+
+/*
+    Get memory used by table for given number of baby steps
+
+    PARAMS
+    @IN baby - number of baby steps
+
+    RETURN
+    Size of table in bytes
+*/
+size_t bsgs_table_size(unsigned long baby);
+
+#endif
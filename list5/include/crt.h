@@ -10,6 +10,11 @@
 
     Finding x
 
+    Methods:
+    naive - x = SUM r * (N / n) * ((N / n)^-1 mod n), len divisions of big N
+    garner - mixed radix, inversions of small numbers in parallel, quadratic in len
+    tree - product tree and remainder tree, quasi linear in len, levels in parallel
+
     Author: Michal Kukowski
     email: michalkukowski10@gmail.com
 
@@ -20,6 +25,7 @@
 
 /*
     Chinese remainder theorem, note that n must be pairwise coprime
+    Method is chosen by number of moduli
 
     PARAMS
     @IN r - remainders
@@ -33,4 +39,49 @@
 */
 int crt(const mpz_t *restrict r, const mpz_t *restrict n, size_t len, mpz_t x);
 
+/*
+    Chinese remainder theorem by sum of r * (N / n) * ((N / n)^-1 mod n)
+
+    PARAMS
+    @IN r - remainders
+    @IN n - modulus
+    @IN len - len of arrays
+    @OUT x - x
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int crt_naive(const mpz_t *restrict r, const mpz_t *restrict n, size_t len, mpz_t x);
+
+/*
+    Chinese remainder theorem by Garner mixed radix representation
+
+    PARAMS
+    @IN r - remainders
+    @IN n - modulus
+    @IN len - len of arrays
+    @OUT x - x
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int crt_garner(const mpz_t *restrict r, const mpz_t *restrict n, size_t len, mpz_t x);
+
+/*
+    Chinese remainder theorem by product tree and remainder tree
+
+    PARAMS
+    @IN r - remainders
+    @IN n - modulus
+    @IN len - len of arrays
+    @OUT x - x
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int crt_tree(const mpz_t *restrict r, const mpz_t *restrict n, size_t len, mpz_t x);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,111 @@
+#ifndef DLOG_TABLE_H
+#define DLOG_TABLE_H
+
+/*
+    Dense discrete logarithm table for tiny prime subgroups
+
+    Find x such that
+    g^x = h (mod) P, where x is in [0, ord(g)) and ord(g) <= DLOG_TABLE_MAX
+
+    All powers g^k are stored in open addressing table as 8 bit fingerprint and k,
+    so every query is one lookup and one short verification. Table can be kept in directory
+    as memory mapped file, then other runs and processes with the same g, p map it instead of building.
+    File is published by rename, so concurrent builders never see half written table.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+
+    LICENCE: GPL 3.0+
+*/
+
+#include <gmp.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* k + 1 is stored in 24 bits */
+#define DLOG_TABLE_MAX ((1ul << 24) - 1)
+
+/*
+    Table of all powers of g, read only after creation
+*/
+typedef struct Dlog_table Dlog_table;
+
+/*
+    Map table from directory or build it in parallel and store it there
+
+    PARAMS
+    @IN g - generator
+    @IN p - prime
+    @IN order - ord(g), must be <= DLOG_TABLE_MAX
+    @IN dir - directory with tables, NULL means table only in memory
+    @IN threads - number of threads used to build table, 0 means all available threads
+
+    RETURN
+    NULL iff failure
+    Pointer to new table iff success
+*/
+Dlog_table *dlog_table_create(const mpz_t g, const mpz_t p, const mpz_t order, const char *dir, unsigned int threads);
+
+/*
+    Unmap table, file stays in directory
+
+    PARAMS
+    @IN table - pointer to table
+
+    RETURN
+    This is a void function
+*/
+void dlog_table_destroy(Dlog_table *table);
+
+/*
+    Function find X such that g^x = h (mod)p, many threads can query one table
+
+    PARAMS
+    @IN table - table created for g and p
+    @IN h - result of power, must be in <g>
+    @OUT x - discrete log in [0, ord(g))
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int dlog_table_discrete_log(const Dlog_table *table, const mpz_t h, mpz_t x);
+
+/*
+    Check whether table for g, p is already stored in directory
+
+    PARAMS
+    @IN g - generator
+    @IN p - prime
+    @IN order - ord(g)
+    @IN dir - directory with tables, NULL means no directory
+
+    RETURN
+    true iff table file exists
+*/
+bool dlog_table_exists(const mpz_t g, const mpz_t p, const mpz_t order, const char *dir);
+
+/*
+    Check whether table was mapped from file instead of built
+
+    PARAMS
+    @IN table - pointer to table
+
+    RETURN
+    true iff table was loaded
+*/
+bool dlog_table_loaded(const Dlog_table *table);
+
+/*
+    Get size of table for subgroup of given order
+
+    PARAMS
+    @IN order - ord(g)
+
+    RETURN
+    Size of table in bytes
+*/
+size_t dlog_table_size(unsigned long order);
+
+#endif
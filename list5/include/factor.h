@@ -0,0 +1,51 @@
+#ifndef FACTOR_H
+#define FACTOR_H
+
+/*
+    Factorization of n (p - 1 for Pohling - Hellman)
+
+    Stages:
+    1. trial division by primes < FACTOR_TRIAL_BOUND
+    2. splitting of composite cofactors by parallel Pollard rho (Brent variant)
+    3. primality test of every part
+
+    Rho finds factor q in O(sqrt(q)) steps, the same cost as discrete log in subgroup of order q,
+    so factorization never dominates Pohling - Hellman.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+
+    LICENCE: GPL 3.0+
+*/
+
+#include <gmp.h>
+
+/*
+    Factorize n > 1 into primes
+
+    PARAMS
+    @IN n - number to factorize
+    @OUT factors - new array of primes, ascending
+    @OUT exponents - new array of exponents
+    @OUT len - len of arrays
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int factorize(const mpz_t n, mpz_t **factors, mpz_t **exponents, size_t *len);
+
+/*
+    Destroy arrays created by factorize
+
+    PARAMS
+    @IN factors - primes
+    @IN exponents - exponents
+    @IN len - len of arrays
+
+    RETURN
+    This is a void function
+*/
+void factors_destroy(mpz_t *factors, mpz_t *exponents, size_t len);
+
+#endif
@@ -12,6 +12,13 @@
 
 #include <gmp.h>
 
+typedef enum POHLING_DIGITS
+{
+    POHLING_DIGITS_AUTO,    /* tree for big exponents, linear otherwise */
+    POHLING_DIGITS_LINEAR,  /* digit by digit, O(e^2) exponentiations */
+    POHLING_DIGITS_TREE     /* Shoup divide and conquer, O(e log e) exponentiations */
+} pohling_digits_t;
+
 /*
     Solve discrete log problem by pohling hellman algo
 
@@ -30,4 +37,49 @@
 */
 int pohling_discrete_log(mpz_t g, mpz_t h, const mpz_t p, mpz_t *factors, mpz_t *exponents, size_t f_len, mpz_t x);
 
+/*
+    Solve discrete log problem by pohling hellman algo with chosen digits extraction
+
+    PARAMS
+    @IN g - generator
+    @IN h - result
+    @IN p - group prime
+    @IN factors - prime factors of p - 1
+    @IN exponents - exponennts of factors of p - 1
+    @IN f_len - factors and exponents arrays len
+    @IN mode - digits extraction strategy for prime powers
+    @OUT x - x such that g^x = h mod p
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int pohling_discrete_log_digits(mpz_t g, mpz_t h, const mpz_t p, mpz_t *factors, mpz_t *exponents, size_t f_len,
+                                pohling_digits_t mode, mpz_t x);
+
+/*
+    Solve many discrete log problems g^x = h[k] mod p in the same group.
+    Order of g, subgroups generators and engines (baby steps tables, tame kangaroos)
+    are computed once and shared, subproblems of all targets run in parallel.
+    Like in pohling_discrete_log g and h are replaced by g^Q and h^Q, where Q is power of the last factor,
+    when Q is not order of g
+
+    PARAMS
+    @IN g - generator
+    @IN h - results
+    @IN h_len - number of results
+    @IN p - group prime
+    @IN factors - prime factors of p - 1
+    @IN exponents - exponennts of factors of p - 1
+    @IN f_len - factors and exponents arrays len
+    @IN mode - digits extraction strategy for prime powers
+    @OUT x - x[k] such that g^x[k] = h[k] mod p, 0 for unsolved target
+
+    RETURN
+    0 iff every target is solved
+    Non-zero value iff failure
+*/
+int pohling_discrete_log_batch(mpz_t g, mpz_t *h, size_t h_len, const mpz_t p, mpz_t *factors, mpz_t *exponents, size_t f_len,
+                               pohling_digits_t mode, mpz_t *x);
+
 #endif
\ No newline at end of file
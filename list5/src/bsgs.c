@@ -0,0 +1,337 @@
+#include <bsgs.h>
+#include <log.h>
+#include <omp.h>
+#include <stdbool.h>
+#include <common.h>
+#include <stdlib.h>
+
+/* threads check cancellation every BSGS_CANCEL_STEPS giant steps, must be power of 2 */
+#define BSGS_CANCEL_STEPS (1ul << 10)
+
+/* table is filled at most in BSGS_LOAD_NUM / BSGS_LOAD_DEN, so linear probing stays short */
+#define BSGS_LOAD_NUM 3
+#define BSGS_LOAD_DEN 4
+
+/* j is stored in 32 bits as j + 1, 0 means empty slot */
+#define BSGS_MAX_BABY ((1ul << 32) - 2)
+
+#define BSGS_SLOT(fp, j)    (((uint64_t)(fp) << 32) | ((uint64_t)(j) + 1))
+#define BSGS_SLOT_FP(slot)  ((uint32_t)((slot) >> 32))
+#define BSGS_SLOT_J(slot)   (((slot) & 0xffffffffull) - 1)
+
+struct Bsgs_ctx
+{
+    unsigned int threads;
+    unsigned long baby; /* m */
+    unsigned long giant; /* ceil(order / m) */
+
+    mpz_t g;
+    mpz_t p;
+    mpz_t order;
+    mpz_t giant_step; /* g^(-m) */
+
+    /* open addressing, slot = fingerprint (32 bits) | j + 1 (32 bits) */
+    uint64_t *table;
+    uint64_t mask; /* slots - 1 */
+    unsigned int bits; /* log2(slots) */
+};
+
+/*
+    Get hash of element, low limb is enough to find candidates, every candidate is verified.
+    High bits of hash are slot index, low 32 bits are fingerprint
+
+    PARAMS
+    @IN pos - element
+
+    RETURN
+    Hash of element
+*/
+static ___inline___ uint64_t bsgs_hash(const mpz_t pos);
+
+/*
+    Get number of slots for table with baby entries, always power of 2
+
+    PARAMS
+    @IN baby - number of baby steps
+
+    RETURN
+    Number of slots
+*/
+static uint64_t bsgs_slots(unsigned long baby);
+
+/*
+    Insert baby step into table, many threads can insert at the same time
+
+    PARAMS
+    @IN ctx - context
+    @IN pos - g^j
+    @IN j - exponent
+
+    RETURN
+    This is a void function
+*/
+static void bsgs_table_insert(Bsgs_ctx *ctx, const mpz_t pos, unsigned long j);
+
+static ___inline___ uint64_t bsgs_hash(const mpz_t pos)
+{
+    /* splitmix64 finalizer */
+    uint64_t key = (uint64_t)mpz_getlimbn(pos, 0);
+
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ull;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebull;
+    key ^= key >> 31;
+
+    return key;
+}
+
+static uint64_t bsgs_slots(unsigned long baby)
+{
+    uint64_t slots = 2;
+
+    while (slots * BSGS_LOAD_NUM < (uint64_t)baby * BSGS_LOAD_DEN)
+        slots <<= 1;
+
+    return slots;
+}
+
+static void bsgs_table_insert(Bsgs_ctx *ctx, const mpz_t pos, unsigned long j)
+{
+    const uint64_t hash = bsgs_hash(pos);
+    const uint64_t slot = BSGS_SLOT(hash, j);
+    uint64_t i;
+
+    /* elements are distinct, so the first empty slot on probe path is ours */
+    for (i = hash >> (64 - ctx->bits); !__sync_bool_compare_and_swap(&ctx->table[i], 0, slot); i = (i + 1) & ctx->mask)
+        ;
+}
+
+size_t bsgs_table_size(unsigned long baby)
+{
+    return (size_t)bsgs_slots(baby) * sizeof(uint64_t);
+}
+
+unsigned long bsgs_baby_steps(const mpz_t order, size_t memory, double ratio)
+{
+    unsigned long baby;
+    uint64_t slots;
+    mpz_t temp;
+
+    TRACE();
+
+    if (ratio <= 0.0)
+        ratio = 1.0;
+
+    /* m = ceil(sqrt(order * ratio)) */
+    mpz_init(temp);
+    mpz_set_d(temp, mpz_get_d(order) * ratio);
+    mpz_sqrt(temp, temp);
+    mpz_add_ui(temp, temp, 1);
+
+    if (mpz_cmp(temp, order) > 0)
+        mpz_set(temp, order);
+
+    baby = mpz_fits_ulong_p(temp) ? mpz_get_ui(temp) : BSGS_MAX_BABY;
+    baby = MIN(baby, BSGS_MAX_BABY);
+
+    mpz_clear(temp);
+
+    /* the biggest table in memory budget */
+    if (memory != 0)
+    {
+        for (slots = 2; (slots << 1) * sizeof(uint64_t) <= memory; slots <<= 1)
+            ;
+
+        baby = MIN(baby, (unsigned long)(slots * BSGS_LOAD_NUM / BSGS_LOAD_DEN));
+    }
+
+    return baby == 0 ? 1 : baby;
+}
+
+Bsgs_ctx *bsgs_ctx_create(const mpz_t g, const mpz_t p, const mpz_t order, size_t memory, double ratio, unsigned int threads)
+{
+    Bsgs_ctx *ctx;
+    mpz_t temp;
+    mpz_t pos;
+
+    unsigned long chunk;
+    unsigned long start;
+    unsigned long end;
+    unsigned long j;
+    uint64_t slots;
+
+    TRACE();
+
+    if (!mpz_fits_ulong_p(order) || mpz_cmp_ui(order, 0) == 0)
+        ERROR("order out of range\n", NULL);
+
+    ctx = (Bsgs_ctx *)malloc(sizeof(Bsgs_ctx));
+    if (ctx == NULL)
+        ERROR("malloc error\n", NULL);
+
+    /* m >= order gives direct lookup table */
+    ctx->baby = bsgs_baby_steps(order, memory, ratio);
+    ctx->giant = (mpz_get_ui(order) + ctx->baby - 1) / ctx->baby;
+    ctx->threads = threads == 0 ? (unsigned int)omp_get_max_threads() : threads;
+
+    slots = bsgs_slots(ctx->baby);
+    ctx->mask = slots - 1;
+    for (ctx->bits = 0; (1ull << ctx->bits) < slots; ++ctx->bits)
+        ;
+
+    ctx->table = (uint64_t *)calloc((size_t)slots, sizeof(uint64_t));
+    if (ctx->table == NULL)
+    {
+        FREE(ctx);
+        ERROR("malloc error\n", NULL);
+    }
+
+    mpz_init(temp);
+    mpz_init_set(ctx->g, g);
+    mpz_init_set(ctx->p, p);
+    mpz_init_set(ctx->order, order);
+    mpz_init(ctx->giant_step);
+
+    /* giant_step = g^(-m) = g^(order - m) */
+    mpz_sub_ui(temp, order, ctx->baby);
+    mpz_powm(ctx->giant_step, g, temp, p);
+
+#pragma omp parallel num_threads(ctx->threads) private(pos, start, end, j, chunk) shared(ctx)
+{
+    mpz_init(pos);
+
+    /* team can be smaller than requested in nested region */
+    chunk = (ctx->baby + (unsigned long)omp_get_num_threads() - 1) / (unsigned long)omp_get_num_threads();
+
+    start = MIN(chunk * (unsigned long)omp_get_thread_num(), ctx->baby);
+    end = MIN(start + chunk, ctx->baby);
+
+    mpz_powm_ui(pos, ctx->g, start, ctx->p);
+    for (j = start; j < end; ++j)
+    {
+        bsgs_table_insert(ctx, pos, j);
+
+        mpz_mul(pos, pos, ctx->g);
+        mpz_mod(pos, pos, ctx->p);
+    }
+
+    mpz_clear(pos);
+}
+
+    mpz_clear(temp);
+
+    return ctx;
+}
+
+void bsgs_ctx_destroy(Bsgs_ctx *ctx)
+{
+    TRACE();
+
+    if (ctx == NULL)
+        return;
+
+    mpz_clear(ctx->g);
+    mpz_clear(ctx->p);
+    mpz_clear(ctx->order);
+    mpz_clear(ctx->giant_step);
+
+    FREE(ctx->table);
+    FREE(ctx);
+}
+
+void bsgs_ctx_set_threads(Bsgs_ctx *ctx, unsigned int threads)
+{
+    TRACE();
+
+    ctx->threads = threads == 0 ? (unsigned int)omp_get_max_threads() : threads;
+}
+
+int bsgs_ctx_discrete_log(Bsgs_ctx *ctx, const mpz_t h, mpz_t res)
+{
+    unsigned long chunk;
+    unsigned long start;
+    unsigned long end;
+    unsigned long i;
+    uint64_t hash;
+    uint64_t slot;
+
+    mpz_t gamma;
+    mpz_t cand;
+    mpz_t temp;
+
+    bool finish = false;
+    bool done;
+
+    TRACE();
+
+#pragma omp parallel num_threads(ctx->threads) private(gamma, cand, temp, start, end, i, hash, slot, done, chunk) shared(ctx, h, res, finish)
+{
+    mpz_init(gamma);
+    mpz_init(cand);
+    mpz_init(temp);
+
+    chunk = (ctx->giant + (unsigned long)omp_get_num_threads() - 1) / (unsigned long)omp_get_num_threads();
+
+    start = MIN(chunk * (unsigned long)omp_get_thread_num(), ctx->giant);
+    end = MIN(start + chunk, ctx->giant);
+
+    /* gamma = h * g^(-m * start) */
+    mpz_powm_ui(gamma, ctx->giant_step, start, ctx->p);
+    mpz_mul(gamma, gamma, h);
+    mpz_mod(gamma, gamma, ctx->p);
+
+    for (i = start; i < end; ++i)
+    {
+        if (((i - start) & (BSGS_CANCEL_STEPS - 1)) == 0)
+        {
+#pragma omp atomic read
+            done = finish;
+
+            if (done)
+                break;
+        }
+
+        hash = bsgs_hash(gamma);
+        for (slot = hash >> (64 - ctx->bits); ctx->table[slot] != 0; slot = (slot + 1) & ctx->mask)
+        {
+            if (BSGS_SLOT_FP(ctx->table[slot]) != (uint32_t)hash)
+                continue;
+
+            /* candidate x = i * m + j, fingerprint is only part of element so check it */
+            mpz_set_ui(cand, i);
+            mpz_mul_ui(cand, cand, ctx->baby);
+            mpz_add_ui(cand, cand, (unsigned long)BSGS_SLOT_J(ctx->table[slot]));
+
+            mpz_powm(temp, ctx->g, cand, ctx->p);
+            if (mpz_cmp(temp, h))
+                continue;
+
+#pragma omp critical
+            {
+                if (!finish)
+                {
+                    mpz_mod(res, cand, ctx->order);
+
+#pragma omp atomic write
+                    finish = true;
+                }
+            }
+
+            break;
+        }
+
+        mpz_mul(gamma, gamma, ctx->giant_step);
+        mpz_mod(gamma, gamma, ctx->p);
+    }
+
+    mpz_clear(gamma);
+    mpz_clear(cand);
+    mpz_clear(temp);
+}
+
+    if (!finish)
+        ERROR("h is not in <g>\n", 1);
+
+    return 0;
+}
@@ -1,17 +1,64 @@
 #include <gmp.h>
 #include <log.h>
 #include <crt.h>
+#include <omp.h>
+#include <common.h>
+#include <stdlib.h>
 
-int crt(const mpz_t *restrict r, const mpz_t *restrict n, size_t len, mpz_t x)
-{
-    mpz_t product;
-    mpz_t temp;
-    mpz_t inv;
+/* up to CRT_NAIVE_MAX moduli or for single limb moduli simple formula is the fastest */
+#define CRT_NAIVE_MAX 4
 
-    size_t i;
+/* naive and Garner are quadratic, product tree wins from CRT_TREE_MIN moduli and CRT_TREE_MIN_LIMBS limbs in total */
+#define CRT_TREE_MIN 64
+#define CRT_TREE_MIN_LIMBS 128
 
-    TRACE();
+/* below CRT_PARALLEL_MIN moduli thread creation costs more than work */
+#define CRT_PARALLEL_MIN 32
+
+/*
+    Check input of crt functions
+
+    PARAMS
+    @IN r - remainders
+    @IN n - modulus
+    @IN len - len of arrays
 
+    RETURN
+    0 iff input is correct
+    Non-zero value iff input is incorrect
+*/
+static int crt_check(const mpz_t *restrict r, const mpz_t *restrict n, size_t len);
+
+/*
+    Create product tree, tree[0] are moduli, tree[depth - 1][0] is product of all moduli
+
+    PARAMS
+    @IN n - modulus
+    @IN len - len of array
+    @OUT sizes - new array with number of nodes on each level
+    @OUT depth - number of levels
+
+    RETURN
+    NULL iff failure
+    Pointer to new tree iff success
+*/
+static mpz_t **crt_tree_create(const mpz_t *n, size_t len, size_t **sizes, size_t *depth);
+
+/*
+    Destroy product tree
+
+    PARAMS
+    @IN tree - tree
+    @IN sizes - number of nodes on each level
+    @IN depth - number of levels
+
+    RETURN
+    This is a void function
+*/
+static void crt_tree_destroy(mpz_t **tree, size_t *sizes, size_t depth);
+
+static int crt_check(const mpz_t *restrict r, const mpz_t *restrict n, size_t len)
+{
     if (r == NULL)
         ERROR("r == NULL\n", 1);
 
@@ -21,6 +68,120 @@ int crt(const mpz_t *restrict r, const mpz_t *restrict n, size_t len, mpz_t x)
     if (len == 0)
         ERROR("len == 0\n", 1);
 
+    return 0;
+}
+
+static mpz_t **crt_tree_create(const mpz_t *n, size_t len, size_t **sizes, size_t *depth)
+{
+    mpz_t **tree;
+    size_t level;
+    size_t i;
+    size_t levels = 1;
+
+    for (i = len; i > 1; i = (i + 1) >> 1)
+        ++levels;
+
+    tree = (mpz_t **)malloc(sizeof(mpz_t *) * levels);
+    if (tree == NULL)
+        ERROR("malloc error\n", NULL);
+
+    *sizes = (size_t *)malloc(sizeof(size_t) * levels);
+    if (*sizes == NULL)
+    {
+        FREE(tree);
+        ERROR("malloc error\n", NULL);
+    }
+
+    (*sizes)[0] = len;
+    for (level = 1; level < levels; ++level)
+        (*sizes)[level] = ((*sizes)[level - 1] + 1) >> 1;
+
+    for (level = 0; level < levels; ++level)
+    {
+        tree[level] = (mpz_t *)malloc(sizeof(mpz_t) * (*sizes)[level]);
+        if (tree[level] == NULL)
+        {
+            crt_tree_destroy(tree, *sizes, level);
+            ERROR("malloc error\n", NULL);
+        }
+
+        for (i = 0; i < (*sizes)[level]; ++i)
+            mpz_init(tree[level][i]);
+    }
+
+    for (i = 0; i < len; ++i)
+        mpz_set(tree[0][i], n[i]);
+
+    /* node = left * right, the last node without pair is copied */
+    for (level = 1; level < levels; ++level)
+    {
+#pragma omp parallel for schedule(dynamic) if(len >= CRT_PARALLEL_MIN)
+        for (i = 0; i < (*sizes)[level]; ++i)
+        {
+            if ((i << 1) + 1 < (*sizes)[level - 1])
+                mpz_mul(tree[level][i], tree[level - 1][i << 1], tree[level - 1][(i << 1) + 1]);
+            else
+                mpz_set(tree[level][i], tree[level - 1][i << 1]);
+        }
+    }
+
+    *depth = levels;
+
+    return tree;
+}
+
+static void crt_tree_destroy(mpz_t **tree, size_t *sizes, size_t depth)
+{
+    size_t level;
+    size_t i;
+
+    for (level = 0; level < depth; ++level)
+    {
+        for (i = 0; i < sizes[level]; ++i)
+            mpz_clear(tree[level][i]);
+
+        FREE(tree[level]);
+    }
+
+    FREE(tree);
+    FREE(sizes);
+}
+
+int crt(const mpz_t *restrict r, const mpz_t *restrict n, size_t len, mpz_t x)
+{
+    size_t limbs = 0;
+    size_t i;
+
+    TRACE();
+
+    if (crt_check(r, n, len))
+        return 1;
+
+    for (i = 0; i < len; ++i)
+        limbs = MAX(limbs, mpz_size(n[i]));
+
+    if (len >= CRT_TREE_MIN && len * limbs >= CRT_TREE_MIN_LIMBS)
+        return crt_tree(r, n, len, x);
+
+    if (len <= CRT_NAIVE_MAX || limbs == 1)
+        return crt_naive(r, n, len, x);
+
+    return crt_garner(r, n, len, x);
+}
+
+int crt_naive(const mpz_t *restrict r, const mpz_t *restrict n, size_t len, mpz_t x)
+{
+    mpz_t product;
+    mpz_t temp;
+    mpz_t inv;
+
+    size_t i;
+
+    TRACE();
+
+    if (crt_check(r, n, len))
+        return 1;
+
     mpz_init(product);
     mpz_init(temp);
     mpz_init(inv);
@@ -52,4 +213,188 @@ int crt(const mpz_t *restrict r, const mpz_t *restrict n, size_t len, mpz_t x)
     mpz_clear(inv);
 
     return 0;
-}
\ No newline at end of file
+}
+
+int crt_garner(const mpz_t *restrict r, const mpz_t *restrict n, size_t len, mpz_t x)
+{
+    mpz_t *c;
+    mpz_t product;
+    mpz_t temp;
+
+    size_t i;
+    size_t j;
+    int ret = 0;
+
+    TRACE();
+
+    if (crt_check(r, n, len))
+        return 1;
+
+    c = (mpz_t *)malloc(sizeof(mpz_t) * len);
+    if (c == NULL)
+        ERROR("malloc error\n", 1);
+
+    /* c[i] = (n[0] * ... * n[i - 1])^-1 mod n[i], only small numbers, so every thread works on its own i */
+#pragma omp parallel for private(j) schedule(dynamic) reduction(|:ret) if(len >= CRT_PARALLEL_MIN)
+    for (i = 0; i < len; ++i)
+    {
+        mpz_init_set_ui(c[i], 1);
+        for (j = 0; j < i; ++j)
+        {
+            mpz_mul(c[i], c[i], n[j]);
+            mpz_mod(c[i], c[i], n[i]);
+        }
+
+        if (mpz_invert(c[i], c[i], n[i]) == 0)
+            ret |= 1;
+    }
+
+    if (ret)
+    {
+        for (i = 0; i < len; ++i)
+            mpz_clear(c[i]);
+
+        FREE(c);
+        ERROR("moduli are not pairwise coprime\n", 1);
+    }
+
+    mpz_init_set_ui(product, 1);
+    mpz_init(temp);
+
+    /* mixed radix: x = v[0] + v[1] * n[0] + v[2] * n[0] * n[1] ..., v[i] = (r[i] - x) * c[i] mod n[i] */
+    mpz_set_ui(x, 0);
+    for (i = 0; i < len; ++i)
+    {
+        mpz_sub(temp, r[i], x);
+        mpz_mul(temp, temp, c[i]);
+        mpz_mod(temp, temp, n[i]);
+
+        mpz_addmul(x, temp, product);
+        mpz_mul(product, product, n[i]);
+    }
+
+    mpz_clear(product);
+    mpz_clear(temp);
+
+    for (i = 0; i < len; ++i)
+        mpz_clear(c[i]);
+
+    FREE(c);
+
+    return 0;
+}
+
+int crt_tree(const mpz_t *restrict r, const mpz_t *restrict n, size_t len, mpz_t x)
+{
+    mpz_t **tree;
+    mpz_t **rem;
+    size_t *sizes;
+    size_t depth;
+
+    mpz_t square;
+
+    size_t level;
+    size_t i;
+    int ret = 0;
+
+    TRACE();
+
+    if (crt_check(r, n, len))
+        return 1;
+
+    tree = crt_tree_create(n, len, &sizes, &depth);
+    if (tree == NULL)
+        ERROR("crt_tree_create error\n", 1);
+
+    rem = (mpz_t **)malloc(sizeof(mpz_t *) * depth);
+    if (rem == NULL)
+    {
+        crt_tree_destroy(tree, sizes, depth);
+        ERROR("malloc error\n", 1);
+    }
+
+    for (level = 0; level < depth; ++level)
+    {
+        rem[level] = (mpz_t *)malloc(sizeof(mpz_t) * sizes[level]);
+        if (rem[level] == NULL)
+        {
+            /* rem shares sizes with tree, so only its built levels are freed here */
+            while (level > 0)
+            {
+                --level;
+                for (i = 0; i < sizes[level]; ++i)
+                    mpz_clear(rem[level][i]);
+
+                FREE(rem[level]);
+            }
+
+            FREE(rem);
+            crt_tree_destroy(tree, sizes, depth);
+            ERROR("malloc error\n", 1);
+        }
+
+        for (i = 0; i < sizes[level]; ++i)
+            mpz_init(rem[level][i]);
+    }
+
+    /* remainder tree: rem = N mod node^2, at leaves (N mod n[i]^2) / n[i] = (N / n[i]) mod n[i] */
+    mpz_set(rem[depth - 1][0], tree[depth - 1][0]);
+    for (level = depth - 1; level > 0; --level)
+    {
+#pragma omp parallel for private(square) schedule(dynamic) if(len >= CRT_PARALLEL_MIN)
+        for (i = 0; i < sizes[level - 1]; ++i)
+        {
+            mpz_init(square);
+            mpz_mul(square, tree[level - 1][i], tree[level - 1][i]);
+            mpz_mod(rem[level - 1][i], rem[level][i >> 1], square);
+            mpz_clear(square);
+        }
+    }
+
+    /* leaves: a[i] = r[i] * ((N / n[i])^-1 mod n[i]) mod n[i] */
+#pragma omp parallel for schedule(dynamic) reduction(|:ret) if(len >= CRT_PARALLEL_MIN)
+    for (i = 0; i < len; ++i)
+    {
+        mpz_divexact(rem[0][i], rem[0][i], n[i]);
+        if (mpz_invert(rem[0][i], rem[0][i], n[i]) == 0)
+            ret |= 1;
+
+        mpz_mul(rem[0][i], rem[0][i], r[i]);
+        mpz_mod(rem[0][i], rem[0][i], n[i]);
+    }
+
+    /* up the tree: value = left * right_product + right * left_product, root = sum a[i] * N / n[i] */
+    for (level = 1; level < depth && ret == 0; ++level)
+    {
+#pragma omp parallel for schedule(dynamic) if(len >= CRT_PARALLEL_MIN)
+        for (i = 0; i < sizes[level]; ++i)
+        {
+            if ((i << 1) + 1 < sizes[level - 1])
+            {
+                mpz_mul(rem[level][i], rem[level - 1][i << 1], tree[level - 1][(i << 1) + 1]);
+                mpz_addmul(rem[level][i], rem[level - 1][(i << 1) + 1], tree[level - 1][i << 1]);
+            }
+            else
+                mpz_set(rem[level][i], rem[level - 1][i << 1]);
+        }
+    }
+
+    if (ret == 0)
+        mpz_mod(x, rem[depth - 1][0], tree[depth - 1][0]);
+
+    for (level = 0; level < depth; ++level)
+    {
+        for (i = 0; i < sizes[level]; ++i)
+            mpz_clear(rem[level][i]);
+
+        FREE(rem[level]);
+    }
+
+    FREE(rem);
+    crt_tree_destroy(tree, sizes, depth);
+
+    if (ret)
+        ERROR("moduli are not pairwise coprime\n", 1);
+
+    return 0;
+}
@@ -0,0 +1,417 @@
+#include <dlog_table.h>
+#include <log.h>
+#include <omp.h>
+#include <common.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* "DLOGTBL1" */
+#define DLOG_TABLE_MAGIC 0x314c4254474f4c44ull
+
+/* table is filled at most in DLOG_TABLE_LOAD_NUM / DLOG_TABLE_LOAD_DEN, so linear probing stays short */
+#define DLOG_TABLE_LOAD_NUM 3
+#define DLOG_TABLE_LOAD_DEN 4
+
+#define DLOG_TABLE_PATH_LEN 4096
+
+#define DLOG_TABLE_SLOT(fp, k)      ((((uint32_t)(fp) & 0xffu) << 24) | ((uint32_t)(k) + 1))
+#define DLOG_TABLE_SLOT_FP(slot)    ((uint32_t)(slot) >> 24)
+#define DLOG_TABLE_SLOT_K(slot)     (((uint32_t)(slot) & 0xffffffu) - 1)
+
+/* file layout: header, then slots */
+typedef struct Dlog_table_header
+{
+    uint64_t magic;
+    uint64_t key; /* hash of g, p and order */
+    uint64_t order;
+    uint64_t bits;
+} Dlog_table_header;
+
+struct Dlog_table
+{
+    mpz_t g;
+    mpz_t p;
+    unsigned long order;
+
+    void *map; /* header and slots, file or anonymous mapping */
+    size_t map_size;
+    bool loaded; /* mapped from file, not built */
+
+    /* open addressing, slot = fingerprint (8 bits) | k + 1 (24 bits) */
+    uint32_t *slots;
+    uint64_t mask; /* slots - 1 */
+    unsigned int bits; /* log2(slots) */
+};
+
+/*
+    splitmix64 finalizer
+
+    PARAMS
+    @IN key - value to mix
+
+    RETURN
+    Mixed value
+*/
+static ___inline___ uint64_t dlog_table_mix(uint64_t key);
+
+/*
+    Get hash of element, high bits are slot index, low 8 bits are fingerprint
+
+    PARAMS
+    @IN pos - element
+
+    RETURN
+    Hash of element
+*/
+static ___inline___ uint64_t dlog_table_hash(const mpz_t pos);
+
+/*
+    Get key which identifies table of g, p in file name and header
+
+    PARAMS
+    @IN g - generator
+    @IN p - prime
+    @IN order - ord(g)
+
+    RETURN
+    Key of table
+*/
+static uint64_t dlog_table_key(const mpz_t g, const mpz_t p, unsigned long order);
+
+/*
+    Get number of slots for subgroup of given order, always power of 2
+
+    PARAMS
+    @IN order - ord(g)
+
+    RETURN
+    Number of slots
+*/
+static uint64_t dlog_table_slots(unsigned long order);
+
+/*
+    Get path of table file in directory
+
+    PARAMS
+    @IN dir - directory
+    @IN key - key of table
+    @IN order - ord(g)
+    @OUT path - buffer of DLOG_TABLE_PATH_LEN bytes
+
+    RETURN
+    0 iff success
+    Non-zero value iff path is too long
+*/
+static int dlog_table_path(const char *dir, uint64_t key, unsigned long order, char *path);
+
+/*
+    Map table file read only, file is accepted only when size and header match
+
+    PARAMS
+    @IN table - table with order, bits and map_size set
+    @IN path - path of file
+    @IN key - expected key
+
+    RETURN
+    0 iff success
+    Non-zero value iff there is no valid file
+*/
+static int dlog_table_load(Dlog_table *table, const char *path, uint64_t key);
+
+/*
+    Write header and insert all powers of g into zeroed mapping in parallel
+
+    PARAMS
+    @IN table - table with mapping
+    @IN key - key of table
+    @IN threads - number of threads
+
+    RETURN
+    This is a void function
+*/
+static void dlog_table_build(Dlog_table *table, uint64_t key, unsigned int threads);
+
+static ___inline___ uint64_t dlog_table_mix(uint64_t key)
+{
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ull;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebull;
+    key ^= key >> 31;
+
+    return key;
+}
+
+static ___inline___ uint64_t dlog_table_hash(const mpz_t pos)
+{
+    return dlog_table_mix((uint64_t)mpz_getlimbn(pos, 0));
+}
+
+static uint64_t dlog_table_key(const mpz_t g, const mpz_t p, unsigned long order)
+{
+    uint64_t key = DLOG_TABLE_MAGIC;
+    size_t i;
+
+    for (i = 0; i < mpz_size(g); ++i)
+        key = dlog_table_mix(key ^ (uint64_t)mpz_getlimbn(g, (mp_size_t)i));
+
+    for (i = 0; i < mpz_size(p); ++i)
+        key = dlog_table_mix(key ^ (uint64_t)mpz_getlimbn(p, (mp_size_t)i));
+
+    return dlog_table_mix(key ^ (uint64_t)order);
+}
+
+static uint64_t dlog_table_slots(unsigned long order)
+{
+    uint64_t slots = 2;
+
+    while (slots * DLOG_TABLE_LOAD_NUM < (uint64_t)order * DLOG_TABLE_LOAD_DEN)
+        slots <<= 1;
+
+    return slots;
+}
+
+static int dlog_table_path(const char *dir, uint64_t key, unsigned long order, char *path)
+{
+    int len;
+
+    len = snprintf(path, DLOG_TABLE_PATH_LEN, "%s/dlog_%016" PRIx64 "_%lu.tbl", dir, key, order);
+    if (len < 0 || len >= DLOG_TABLE_PATH_LEN)
+        ERROR("path too long\n", 1);
+
+    return 0;
+}
+
+static int dlog_table_load(Dlog_table *table, const char *path, uint64_t key)
+{
+    const Dlog_table_header *header;
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 1;
+
+    if (fstat(fd, &st) || (size_t)st.st_size != table->map_size)
+    {
+        (void)close(fd);
+        return 1;
+    }
+
+    map = mmap(NULL, table->map_size, PROT_READ, MAP_SHARED, fd, 0);
+    (void)close(fd);
+    if (map == MAP_FAILED)
+        return 1;
+
+    header = (const Dlog_table_header *)map;
+    if (header->magic != DLOG_TABLE_MAGIC || header->key != key || header->order != table->order || header->bits != table->bits)
+    {
+        (void)munmap(map, table->map_size);
+        return 1;
+    }
+
+    table->map = map;
+    table->slots = (uint32_t *)((char *)map + sizeof(Dlog_table_header));
+    table->loaded = true;
+
+    return 0;
+}
+
+static void dlog_table_build(Dlog_table *table, uint64_t key, unsigned int threads)
+{
+    Dlog_table_header *header = (Dlog_table_header *)table->map;
+    mpz_t pos;
+
+    unsigned long chunk;
+    unsigned long start;
+    unsigned long end;
+    unsigned long k;
+    uint64_t hash;
+    uint64_t i;
+
+    header->magic = DLOG_TABLE_MAGIC;
+    header->key = key;
+    header->order = table->order;
+    header->bits = table->bits;
+
+    table->slots = (uint32_t *)((char *)table->map + sizeof(Dlog_table_header));
+
+#pragma omp parallel num_threads(threads) private(pos, start, end, k, chunk, hash, i) shared(table)
+{
+    mpz_init(pos);
+
+    chunk = (table->order + (unsigned long)omp_get_num_threads() - 1) / (unsigned long)omp_get_num_threads();
+
+    start = MIN(chunk * (unsigned long)omp_get_thread_num(), table->order);
+    end = MIN(start + chunk, table->order);
+
+    mpz_powm_ui(pos, table->g, start, table->p);
+    for (k = start; k < end; ++k)
+    {
+        /* powers are distinct, so the first empty slot on probe path is ours */
+        hash = dlog_table_hash(pos);
+        for (i = hash >> (64 - table->bits); !__sync_bool_compare_and_swap(&table->slots[i], 0, DLOG_TABLE_SLOT(hash, k)); i = (i + 1) & table->mask)
+            ;
+
+        mpz_mul(pos, pos, table->g);
+        mpz_mod(pos, pos, table->p);
+    }
+
+    mpz_clear(pos);
+}
+}
+
+Dlog_table *dlog_table_create(const mpz_t g, const mpz_t p, const mpz_t order, const char *dir, unsigned int threads)
+{
+    Dlog_table *table;
+    char path[DLOG_TABLE_PATH_LEN];
+    char temp_path[DLOG_TABLE_PATH_LEN + 8];
+    uint64_t key;
+    uint64_t slots;
+    int fd = -1;
+
+    TRACE();
+
+    if (mpz_cmp_ui(order, 0) == 0 || mpz_cmp_ui(order, DLOG_TABLE_MAX) > 0)
+        ERROR("order out of range\n", NULL);
+
+    table = (Dlog_table *)malloc(sizeof(Dlog_table));
+    if (table == NULL)
+        ERROR("malloc error\n", NULL);
+
+    table->order = mpz_get_ui(order);
+    table->loaded = false;
+    table->map = MAP_FAILED;
+
+    slots = dlog_table_slots(table->order);
+    table->mask = slots - 1;
+    for (table->bits = 0; (1ull << table->bits) < slots; ++table->bits)
+        ;
+
+    table->map_size = sizeof(Dlog_table_header) + (size_t)slots * sizeof(uint32_t);
+
+    mpz_init_set(table->g, g);
+    mpz_init_set(table->p, p);
+
+    key = dlog_table_key(g, p, table->order);
+    if (dir != NULL && dlog_table_path(dir, key, table->order, path) == 0)
+    {
+        if (dlog_table_load(table, path, key) == 0)
+            return table;
+
+        /* build in temporary file, other processes see table after rename */
+        (void)snprintf(temp_path, sizeof(temp_path), "%s.XXXXXX", path);
+        fd = mkstemp(temp_path);
+        if (fd >= 0 && fchmod(fd, 0644) == 0 && ftruncate(fd, (off_t)table->map_size) == 0)
+            table->map = mmap(NULL, table->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        if (fd >= 0 && table->map == MAP_FAILED)
+        {
+            (void)unlink(temp_path);
+            (void)close(fd);
+            fd = -1;
+        }
+    }
+
+    /* without directory table lives only in this process */
+    if (table->map == MAP_FAILED)
+        table->map = mmap(NULL, table->map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (table->map == MAP_FAILED)
+    {
+        mpz_clear(table->g);
+        mpz_clear(table->p);
+        FREE(table);
+        ERROR("mmap error\n", NULL);
+    }
+
+    dlog_table_build(table, key, threads == 0 ? (unsigned int)omp_get_max_threads() : threads);
+
+    if (fd >= 0)
+    {
+        if (rename(temp_path, path))
+            (void)unlink(temp_path);
+
+        (void)close(fd);
+    }
+
+    return table;
+}
+
+void dlog_table_destroy(Dlog_table *table)
+{
+    TRACE();
+
+    if (table == NULL)
+        return;
+
+    (void)munmap(table->map, table->map_size);
+
+    mpz_clear(table->g);
+    mpz_clear(table->p);
+
+    FREE(table);
+}
+
+int dlog_table_discrete_log(const Dlog_table *table, const mpz_t h, mpz_t x)
+{
+    const uint64_t hash = dlog_table_hash(h);
+    uint64_t i;
+    uint32_t slot;
+    mpz_t temp;
+
+    TRACE();
+
+    mpz_init(temp);
+
+    for (i = hash >> (64 - table->bits); (slot = table->slots[i]) != 0; i = (i + 1) & table->mask)
+    {
+        if (DLOG_TABLE_SLOT_FP(slot) != (uint32_t)(hash & 0xffu))
+            continue;
+
+        /* fingerprint is only 8 bits of hash, so check candidate */
+        mpz_powm_ui(temp, table->g, DLOG_TABLE_SLOT_K(slot), table->p);
+        if (mpz_cmp(temp, h) == 0)
+        {
+            mpz_set_ui(x, DLOG_TABLE_SLOT_K(slot));
+            mpz_clear(temp);
+
+            return 0;
+        }
+    }
+
+    mpz_clear(temp);
+
+    ERROR("h is not in <g>\n", 1);
+}
+
+bool dlog_table_exists(const mpz_t g, const mpz_t p, const mpz_t order, const char *dir)
+{
+    char path[DLOG_TABLE_PATH_LEN];
+
+    TRACE();
+
+    if (dir == NULL || mpz_cmp_ui(order, DLOG_TABLE_MAX) > 0)
+        return false;
+
+    if (dlog_table_path(dir, dlog_table_key(g, p, mpz_get_ui(order)), mpz_get_ui(order), path))
+        return false;
+
+    return access(path, R_OK) == 0;
+}
+
+bool dlog_table_loaded(const Dlog_table *table)
+{
+    return table->loaded;
+}
+
+size_t dlog_table_size(unsigned long order)
+{
+    return sizeof(Dlog_table_header) + (size_t)dlog_table_slots(order) * sizeof(uint32_t);
+}
@@ -0,0 +1,515 @@
+#include <factor.h>
+#include <log.h>
+#include <omp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <common.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+/* trial division by primes < FACTOR_TRIAL_BOUND */
+#define FACTOR_TRIAL_BOUND (1ul << 16)
+
+/* rho accumulates FACTOR_RHO_BATCH differences before single gcd */
+#define FACTOR_RHO_BATCH 128
+
+/* single rho walk gives up after FACTOR_RHO_MAX_STEPS steps */
+#define FACTOR_RHO_MAX_STEPS (1ull << 40)
+
+/* Miller - Rabin rounds after BPSW in mpz_probab_prime_p */
+#define FACTOR_PRIME_REPS 25
+
+/* stages of factorization, time of each one is reported */
+typedef enum FACTOR_STAGE
+{
+    FACTOR_STAGE_TRIAL,
+    FACTOR_STAGE_RHO,
+    FACTOR_STAGE_PRIME,
+    FACTOR_STAGES
+} factor_stage_t;
+
+/* growable array of numbers */
+typedef struct Factor_list
+{
+    mpz_t *nums;
+    size_t len;
+    size_t size;
+} Factor_list;
+
+/*
+    Push copy of number to list
+
+    PARAMS
+    @IN list - list
+    @IN num - number
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int factor_list_push(Factor_list *list, const mpz_t num);
+
+/*
+    Clear all numbers and free list memory
+
+    PARAMS
+    @IN list - list
+
+    RETURN
+    This is a void function
+*/
+static void factor_list_clear(Factor_list *list);
+
+/*
+    Std compare function for mpz_t in array
+
+    PARAMS
+    @IN a - (void *)mpz_t
+    @IN b - (void *)mpz_t
+
+    RETURN
+    -1 iff a < b
+    1 iff a > b
+    0 iff a = b
+*/
+static int factor_mpz_cmp(const void *a, const void *b);
+
+/*
+    Divide n by all primes < FACTOR_TRIAL_BOUND
+
+    PARAMS
+    @IN / OUT n - number, after cofactor without small primes
+    @OUT primes - found primes with multiplicity
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int trial_division(mpz_t n, Factor_list *primes);
+
+/*
+    Pollard rho in Brent variant for x -> x^2 + c mod n with batched gcd
+
+    PARAMS
+    @IN n - odd composite number
+    @IN c - constant of iteration
+    @IN finish - shared flag, walk stops when other thread has found factor
+    @OUT d - nontrivial divisor of n
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure (walk cycled or was cancelled)
+*/
+static int rho_brent(const mpz_t n, unsigned long c, bool *finish, mpz_t d);
+
+/*
+    Find nontrivial divisor of composite n, every thread walks with own constant c
+
+    PARAMS
+    @IN n - composite number
+    @OUT d - nontrivial divisor of n
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int rho_parallel(const mpz_t n, mpz_t d);
+
+/*
+    Split n into primes: trial division, then rho on composite cofactors, every part is tested for primality
+
+    PARAMS
+    @IN n - number, destroyed
+    @OUT primes - primes with multiplicity
+    @OUT times - time of each stage is added here
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int factor_split(mpz_t n, Factor_list *primes, double *times);
+
+/*
+    Sort primes and merge equal ones into exponents
+
+    PARAMS
+    @IN primes - primes with multiplicity
+    @OUT factors - new array of distinct primes, ascending
+    @OUT exponents - new array of exponents
+    @OUT len - len of arrays
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int factor_collect(Factor_list *primes, mpz_t **factors, mpz_t **exponents, size_t *len);
+
+static int factor_list_push(Factor_list *list, const mpz_t num)
+{
+    mpz_t *nums;
+
+    if (list->len == list->size)
+    {
+        list->size = list->size == 0 ? 8 : list->size << 1;
+        nums = (mpz_t *)realloc(list->nums, sizeof(mpz_t) * list->size);
+        if (nums == NULL)
+            ERROR("realloc error\n", 1);
+
+        list->nums = nums;
+    }
+
+    mpz_init_set(list->nums[list->len], num);
+    ++list->len;
+
+    return 0;
+}
+
+static void factor_list_clear(Factor_list *list)
+{
+    size_t i;
+
+    for (i = 0; i < list->len; ++i)
+        mpz_clear(list->nums[i]);
+
+    FREE(list->nums);
+    list->len = 0;
+    list->size = 0;
+}
+
+static int factor_mpz_cmp(const void *a, const void *b)
+{
+    return mpz_cmp(*(const mpz_t *)a, *(const mpz_t *)b);
+}
+
+static int trial_division(mpz_t n, Factor_list *primes)
+{
+    unsigned char *composite;
+    unsigned long i;
+    unsigned long j;
+    mpz_t prime;
+
+    TRACE();
+
+    composite = (unsigned char *)calloc(FACTOR_TRIAL_BOUND, sizeof(unsigned char));
+    if (composite == NULL)
+        ERROR("malloc error\n", 1);
+
+    mpz_init(prime);
+
+    /* sieve of Eratosthenes, primes are used as soon as they are found */
+    for (i = 2; i < FACTOR_TRIAL_BOUND && mpz_cmp_ui(n, 1) > 0; ++i)
+    {
+        if (composite[i])
+            continue;
+
+        for (j = i * i; j < FACTOR_TRIAL_BOUND; j += i)
+            composite[j] = 1;
+
+        mpz_set_ui(prime, i);
+        while (mpz_divisible_ui_p(n, i))
+        {
+            mpz_divexact_ui(n, n, i);
+            if (factor_list_push(primes, prime))
+            {
+                mpz_clear(prime);
+                FREE(composite);
+                ERROR("factor_list_push error\n", 1);
+            }
+        }
+    }
+
+    mpz_clear(prime);
+    FREE(composite);
+
+    return 0;
+}
+
+static int rho_brent(const mpz_t n, unsigned long c, bool *finish, mpz_t d)
+{
+    mpz_t x;
+    mpz_t y;
+    mpz_t ys;
+    mpz_t q;
+    mpz_t diff;
+
+    uint64_t r;
+    uint64_t k;
+    uint64_t i;
+    uint64_t batch;
+    uint64_t steps = 0;
+
+    bool done = false;
+    int ret = 0;
+
+    mpz_init(x);
+    mpz_init(ys);
+    mpz_init(diff);
+    mpz_init_set_ui(y, 2);
+    mpz_init_set_ui(q, 1);
+
+    mpz_set_ui(d, 1);
+
+    /* walk doubles its power of 2 checkpoint r, differences y - x are multiplied and gcd is taken once per batch */
+    for (r = 1; mpz_cmp_ui(d, 1) == 0 && !done; r <<= 1)
+    {
+        mpz_set(x, y);
+        for (i = 0; i < r; ++i)
+        {
+            mpz_mul(y, y, y);
+            mpz_add_ui(y, y, c);
+            mpz_mod(y, y, n);
+        }
+        steps += r;
+
+        for (k = 0; k < r && mpz_cmp_ui(d, 1) == 0; k += batch)
+        {
+            mpz_set(ys, y);
+            batch = MIN(FACTOR_RHO_BATCH, r - k);
+            for (i = 0; i < batch; ++i)
+            {
+                mpz_mul(y, y, y);
+                mpz_add_ui(y, y, c);
+                mpz_mod(y, y, n);
+
+                mpz_sub(diff, x, y);
+                mpz_mul(q, q, diff);
+                mpz_mod(q, q, n);
+            }
+
+            mpz_gcd(d, q, n);
+            steps += batch;
+
+#pragma omp atomic read
+            done = *finish;
+
+            if (done || steps > FACTOR_RHO_MAX_STEPS)
+            {
+                done = true;
+                break;
+            }
+        }
+    }
+
+    /* product has hit all factors at once, repeat last batch step by step */
+    if (!done && mpz_cmp(d, n) == 0)
+        do
+        {
+            mpz_mul(ys, ys, ys);
+            mpz_add_ui(ys, ys, c);
+            mpz_mod(ys, ys, n);
+
+            mpz_sub(diff, x, ys);
+            mpz_gcd(d, diff, n);
+        } while (mpz_cmp_ui(d, 1) == 0);
+
+    if (done || mpz_cmp(d, n) == 0 || mpz_cmp_ui(d, 1) == 0)
+        ret = 1;
+
+    mpz_clear(x);
+    mpz_clear(y);
+    mpz_clear(ys);
+    mpz_clear(q);
+    mpz_clear(diff);
+
+    return ret;
+}
+
+static int rho_parallel(const mpz_t n, mpz_t d)
+{
+    const unsigned long stride = (unsigned long)omp_get_max_threads();
+
+    unsigned long c;
+    mpz_t local;
+    bool finish = false;
+    bool done;
+
+    TRACE();
+
+    /* even n is handled by trial division, but be safe */
+    if (mpz_even_p(n))
+    {
+        mpz_set_ui(d, 2);
+        return 0;
+    }
+
+#pragma omp parallel private(c, local, done) shared(n, d, finish)
+{
+    mpz_init(local);
+
+    /* walk that has cycled without factor is restarted with next constant */
+    for (c = (unsigned long)omp_get_thread_num() + 1; ; c += stride)
+    {
+        if (rho_brent(n, c, &finish, local) == 0)
+        {
+#pragma omp critical
+            {
+                if (!finish)
+                {
+                    mpz_set(d, local);
+
+#pragma omp atomic write
+                    finish = true;
+                }
+            }
+        }
+
+#pragma omp atomic read
+        done = finish;
+
+        if (done || c > FACTOR_RHO_MAX_STEPS)
+            break;
+    }
+
+    mpz_clear(local);
+}
+
+    if (!finish)
+        ERROR("rho has not found factor\n", 1);
+
+    return 0;
+}
+
+static int factor_split(mpz_t n, Factor_list *primes, double *times)
+{
+    Factor_list composites = {NULL, 0, 0};
+    mpz_t d;
+
+    double start;
+    bool prime;
+    int ret = 0;
+
+    TRACE();
+
+    mpz_init(d);
+
+    start = omp_get_wtime();
+    ret = trial_division(n, primes);
+    times[FACTOR_STAGE_TRIAL] += omp_get_wtime() - start;
+
+    if (ret == 0 && mpz_cmp_ui(n, 1) > 0)
+        ret = factor_list_push(&composites, n);
+
+    /* split cofactors until every part is prime */
+    while (ret == 0 && composites.len > 0)
+    {
+        --composites.len;
+        mpz_swap(n, composites.nums[composites.len]);
+        mpz_clear(composites.nums[composites.len]);
+
+        start = omp_get_wtime();
+        prime = mpz_probab_prime_p(n, FACTOR_PRIME_REPS) != 0;
+        times[FACTOR_STAGE_PRIME] += omp_get_wtime() - start;
+
+        if (prime)
+        {
+            ret = factor_list_push(primes, n);
+            continue;
+        }
+
+        start = omp_get_wtime();
+        ret = rho_parallel(n, d);
+        times[FACTOR_STAGE_RHO] += omp_get_wtime() - start;
+
+        if (ret)
+            break;
+
+        mpz_divexact(n, n, d);
+        ret = factor_list_push(&composites, d) || factor_list_push(&composites, n);
+    }
+
+    factor_list_clear(&composites);
+    mpz_clear(d);
+
+    return ret;
+}
+
+static int factor_collect(Factor_list *primes, mpz_t **factors, mpz_t **exponents, size_t *len)
+{
+    size_t i;
+    size_t j;
+
+    TRACE();
+
+    /* ascending primes with multiplicity --> distinct primes and exponents */
+    qsort(primes->nums, primes->len, sizeof(mpz_t), factor_mpz_cmp);
+
+    *len = 0;
+    for (i = 0; i < primes->len; ++i)
+        if (i == 0 || mpz_cmp(primes->nums[i], primes->nums[i - 1]))
+            ++*len;
+
+    *factors = (mpz_t *)malloc(sizeof(mpz_t) * *len);
+    if (*factors == NULL)
+        ERROR("malloc error\n", 1);
+
+    *exponents = (mpz_t *)malloc(sizeof(mpz_t) * *len);
+    if (*exponents == NULL)
+    {
+        FREE(*factors);
+        ERROR("malloc error\n", 1);
+    }
+
+    for (i = 0, j = 0; i < primes->len; ++i)
+    {
+        if (i > 0 && mpz_cmp(primes->nums[i], primes->nums[i - 1]) == 0)
+        {
+            mpz_add_ui((*exponents)[j - 1], (*exponents)[j - 1], 1);
+            continue;
+        }
+
+        mpz_init_set((*factors)[j], primes->nums[i]);
+        mpz_init_set_ui((*exponents)[j], 1);
+        ++j;
+    }
+
+    return 0;
+}
+
+int factorize(const mpz_t n, mpz_t **factors, mpz_t **exponents, size_t *len)
+{
+    Factor_list primes = {NULL, 0, 0};
+    mpz_t cofactor;
+    double times[FACTOR_STAGES] = {0.0};
+    int ret;
+
+    TRACE();
+
+    if (mpz_cmp_ui(n, 1) <= 0)
+        ERROR("n must be greater than 1\n", 1);
+
+    mpz_init_set(cofactor, n);
+
+    ret = factor_split(cofactor, &primes, times);
+    if (ret == 0)
+        ret = factor_collect(&primes, factors, exponents, len);
+
+    (void)printf("FACTOR TRIAL DIVISION TIME = %lf [s]\n", times[FACTOR_STAGE_TRIAL]);
+    (void)printf("FACTOR RHO TIME = %lf [s]\n", times[FACTOR_STAGE_RHO]);
+    (void)printf("FACTOR PRIMALITY TIME = %lf [s]\n", times[FACTOR_STAGE_PRIME]);
+
+    factor_list_clear(&primes);
+    mpz_clear(cofactor);
+
+    if (ret)
+        ERROR("factorize error\n", 1);
+
+    return 0;
+}
+
+void factors_destroy(mpz_t *factors, mpz_t *exponents, size_t len)
+{
+    size_t i;
+
+    if (factors == NULL || exponents == NULL)
+        return;
+
+    for (i = 0; i < len; ++i)
+    {
+        mpz_clear(factors[i]);
+        mpz_clear(exponents[i]);
+    }
+
+    FREE(factors);
+    FREE(exponents);
+}
@@ -1,4 +1,10 @@
 #include <pohling.h>
+#include <factor.h>
+#include <crt.h>
+#include <bsgs.h>
+#include <dlog_table.h>
+#include <pollard.h>
+#include <omp.h>
 #include <stdio.h>
 #include <gmp.h>
 #include <compiler.h>
@@ -9,8 +15,79 @@
 
 #define BASE 10
 
+#define DIGITS_LINEAR   "linear"
+#define DIGITS_TREE     "tree"
+#define DIGITS_AUTO     "auto"
+
+#define MODE_CRT        "crt"
+#define MODE_BATCH      "batch"
+#define MODE_DLOG       "dlog"
+
+/* targets solved by every engine in dlog benchmark */
+#define DLOG_BENCH_TARGETS 3
+
+/* memory budget of BSGS in dlog benchmark */
+#define DLOG_BENCH_MEMORY (1ul << 30)
+
 static int help(void);
 
+/*
+    Load factors of p - 1 and digits mode from args after p, without factors p - 1 is factorized.
+    Exit when factors are incorrect
+
+    PARAMS
+    @IN argc - number of args after p
+    @IN argv - args after p: list of f e and optional digits mode
+    @IN p - prime
+    @OUT factors - new array of factors
+    @OUT exponents - new array of exponents
+    @OUT f_len - len of arrays
+    @OUT mode - digits mode
+
+    RETURN
+    This is a void function
+*/
+static void load_factors(int argc, char **argv, const mpz_t p, mpz_t **factors, mpz_t **exponents, size_t *f_len, pohling_digits_t *mode);
+
+/*
+    Solve g^x = h (mod p) for many h read from stdin, group precomputation is shared
+
+    PARAMS
+    @IN argc - argc from main
+    @IN argv - argv from main: batch g p [f e ...] [digits]
+
+    RETURN
+    0 iff every target is solved
+    Non-zero value iff failure
+*/
+static int batch(int argc, char **argv);
+
+/*
+    Benchmark crt methods on random prime moduli
+
+    PARAMS
+    @IN argc - argc from main
+    @IN argv - argv from main: crt count bits [seed]
+
+    RETURN
+    0 iff all methods give the same x
+    Non-zero value iff failure
+*/
+static int crt_bench(int argc, char **argv);
+
+/*
+    Benchmark BSGS against kangaroo in subgroup of prime order f, p = k * f + 1
+
+    PARAMS
+    @IN argc - argc from main
+    @IN argv - argv from main: dlog f_bits p_bits [ratio]
+
+    RETURN
+    0 iff both engines find every x
+    Non-zero value iff failure
+*/
+static int dlog_bench(int argc, char **argv);
+
 ___before_main___(1) void init(void);
 ___after_main___(1) void deinit(void);
 
@@ -32,54 +109,272 @@ static int help(void)
                  "g - generator\n"
                  "h - result of power\n"
                  "p - prime\n"
-                 "list of f e such that (p - 1) = PRODUCT[fi^fei]\n"
-                 "Output x\n");
+                 "list of f e such that (p - 1) = PRODUCT[fi^fei], without list p - 1 is factorized\n"
+                 "[%s|%s|%s] - optional digits extraction for prime powers\n"
+                 "Output x\n\n"
+                 "Many targets: " MODE_BATCH " g p [f e ...] [digits] < file with h values\n"
+                 "CRT benchmark: " MODE_CRT " count bits [seed]\n"
+                 "BSGS vs kangaroo: " MODE_DLOG " f_bits p_bits [baby / giant ratio]\n"
+                 "POHLING_TABLE_DIR=dir keeps dense tables of small subgroups for next runs\n", DIGITS_AUTO, DIGITS_LINEAR, DIGITS_TREE);
 
     return 0;
 }
 
-int main(int argc, char **argv)
+static int crt_bench(int argc, char **argv)
+{
+    mpz_t *r;
+    mpz_t *n;
+    mpz_t x[4];
+    gmp_randstate_t state;
+
+    int (* const method[4])(const mpz_t *restrict, const mpz_t *restrict, size_t, mpz_t) = {crt_naive, crt_garner, crt_tree, crt};
+    const char * const name[4] = {"NAIVE", "GARNER", "TREE", "AUTO"};
+
+    size_t count;
+    unsigned long bits;
+    size_t i;
+    int ret = 0;
+    double elapsed;
+
+    if (argc < 4)
+        return help();
+
+    count = (size_t)strtoul(argv[2], NULL, BASE);
+    bits = strtoul(argv[3], NULL, BASE);
+    if (count == 0 || bits < 2)
+        return help();
+
+    r = (mpz_t *)malloc(sizeof(mpz_t) * count);
+    if (r == NULL)
+        FATAL("malloc error\n");
+
+    n = (mpz_t *)malloc(sizeof(mpz_t) * count);
+    if (n == NULL)
+        FATAL("malloc error\n");
+
+    gmp_randinit_default(state);
+    gmp_randseed_ui(state, argc > 4 ? strtoul(argv[4], NULL, BASE) : 1);
+
+    /* distinct primes: consecutive primes after random start */
+    for (i = 0; i < count; ++i)
+    {
+        mpz_init(n[i]);
+        if (i == 0)
+        {
+            mpz_urandomb(n[i], state, bits - 1);
+            mpz_setbit(n[i], bits - 1);
+        }
+        else
+            mpz_set(n[i], n[i - 1]);
+
+        mpz_nextprime(n[i], n[i]);
+
+        mpz_init(r[i]);
+        mpz_urandomm(r[i], state, n[i]);
+    }
+
+    for (i = 0; i < 4; ++i)
+        mpz_init(x[i]);
+
+    /* warm up, first call pays for page faults and thread creation */
+    ret |= crt((const mpz_t *)r, (const mpz_t *)n, count, x[0]);
+
+    (void)printf("CRT for %zu moduli of %lu bits\n", count, bits);
+    for (i = 0; i < 4; ++i)
+    {
+        elapsed = omp_get_wtime();
+        ret |= method[i]((const mpz_t *)r, (const mpz_t *)n, count, x[i]);
+        elapsed = omp_get_wtime() - elapsed;
+
+        (void)printf("CRT %s TIME = %lf [s]\n", name[i], elapsed);
+
+        if (mpz_cmp(x[i], x[0]))
+            ret = 1;
+    }
+
+    if (ret)
+        (void)printf("FAILED!!!\n");
+    else
+        (void)printf("SUCCESS!!!\n");
+
+    for (i = 0; i < 4; ++i)
+        mpz_clear(x[i]);
+
+    for (i = 0; i < count; ++i)
+    {
+        mpz_clear(r[i]);
+        mpz_clear(n[i]);
+    }
+
+    FREE(r);
+    FREE(n);
+    gmp_randclear(state);
+
+    return ret;
+}
+
+static int dlog_bench(int argc, char **argv)
 {
+    mpz_t f;
+    mpz_t k;
+    mpz_t p;
     mpz_t g;
     mpz_t h;
-    mpz_t p;
     mpz_t x;
+    mpz_t res;
+    gmp_randstate_t state;
 
-    mpz_t *factors;
-    mpz_t *exponents;
-    int res;
-    int ret;
-
-    size_t f_len;
-    size_t i;
+    Bsgs_ctx *bsgs;
+    Pollard_ctx *pollard;
+    Dlog_table *table = NULL;
 
-    /* for checking inputs */
-    mpz_t ord_p;
-    mpz_t temp;
-    mpz_t prod;
+    unsigned long f_bits;
+    unsigned long p_bits;
+    unsigned long a;
+    double ratio;
+    double elapsed;
+    double query[3] = {0.0, 0.0, 0.0};
+    int ret = 0;
+    int i;
 
     if (argc < 4)
         return help();
 
+    f_bits = strtoul(argv[2], NULL, BASE);
+    p_bits = strtoul(argv[3], NULL, BASE);
+    ratio = argc > 4 ? strtod(argv[4], NULL) : 1.0;
+    if (f_bits < 2 || p_bits <= f_bits)
+        return help();
+
+    mpz_init(f);
+    mpz_init(k);
+    mpz_init(p);
     mpz_init(g);
     mpz_init(h);
-    mpz_init(p);
     mpz_init(x);
+    mpz_init(res);
 
-    /* set g h p */
-    mpz_set_str(g, argv[1], BASE);
-    mpz_set_str(h, argv[2], BASE);
-    mpz_set_str(p, argv[3], BASE);
+    gmp_randinit_default(state);
+    gmp_randseed_ui(state, f_bits * p_bits);
 
-    /* load (p-1) factors */
-    f_len = (size_t)(argc - 4) >> 1;
-    factors = (mpz_t *)malloc(sizeof(mpz_t) * f_len);
-    if (factors == NULL)
-        FATAL("malloc error\n");
+    /* prime f of f_bits, p = k * f + 1 of about p_bits, k even */
+    mpz_urandomb(f, state, f_bits - 1);
+    mpz_setbit(f, f_bits - 1);
+    mpz_nextprime(f, f);
 
-    exponents = (mpz_t *)malloc(sizeof(mpz_t) * f_len);
-    if (exponents == NULL)
-        FATAL("malloc error\n");
+    mpz_urandomb(k, state, p_bits - f_bits);
+    mpz_setbit(k, p_bits - f_bits - 1);
+    mpz_clrbit(k, 0);
+    do
+    {
+        mpz_add_ui(k, k, 2);
+        mpz_mul(p, k, f);
+        mpz_add_ui(p, p, 1);
+    } while (!mpz_probab_prime_p(p, 30));
+
+    /* g of order f */
+    for (a = 2; mpz_cmp_ui(g, 1) <= 0; ++a)
+    {
+        mpz_set_ui(g, a);
+        mpz_powm(g, g, k, p);
+    }
+
+    (void)gmp_printf("Subgroup of order %Zd (%lu bits) mod %lu bits prime\n", f, f_bits, mpz_sizeinbase(p, 2));
+
+    elapsed = omp_get_wtime();
+    bsgs = bsgs_ctx_create(g, p, f, DLOG_BENCH_MEMORY, ratio, 0);
+    if (bsgs == NULL)
+        FATAL("bsgs_ctx_create error\n");
+
+    (void)printf("BSGS BABY = %lu, TABLE = %zu [B], BUILD TIME = %lf [s]\n", bsgs_baby_steps(f, DLOG_BENCH_MEMORY, ratio),
+                 bsgs_table_size(bsgs_baby_steps(f, DLOG_BENCH_MEMORY, ratio)), omp_get_wtime() - elapsed);
+
+    elapsed = omp_get_wtime();
+    pollard = pollard_ctx_create(g, p, f, f, POLLARD_TUNE_AUTO, 0);
+    if (pollard == NULL)
+        FATAL("pollard_ctx_create error\n");
+
+    (void)printf("KANGAROO BUILD TIME = %lf [s]\n", omp_get_wtime() - elapsed);
+
+    /* dense table only for tiny subgroups, without directory it is always built */
+    if (mpz_cmp_ui(f, DLOG_TABLE_MAX) <= 0)
+    {
+        elapsed = omp_get_wtime();
+        table = dlog_table_create(g, p, f, NULL, 0);
+        if (table == NULL)
+            FATAL("dlog_table_create error\n");
+
+        (void)printf("DENSE TABLE = %zu [B], BUILD TIME = %lf [s]\n", dlog_table_size(mpz_get_ui(f)), omp_get_wtime() - elapsed);
+    }
+
+    for (i = 0; i < DLOG_BENCH_TARGETS; ++i)
+    {
+        mpz_urandomm(x, state, f);
+        mpz_powm(h, g, x, p);
+
+        elapsed = omp_get_wtime();
+        if (bsgs_ctx_discrete_log(bsgs, h, res) || mpz_cmp(res, x))
+            ret = 1;
+        query[0] += omp_get_wtime() - elapsed;
+
+        elapsed = omp_get_wtime();
+        if (pollard_ctx_dicsrete_log(pollard, h, res) || mpz_cmp(res, x))
+            ret = 1;
+        query[1] += omp_get_wtime() - elapsed;
+
+        if (table == NULL)
+            continue;
+
+        elapsed = omp_get_wtime();
+        if (dlog_table_discrete_log(table, h, res) || mpz_cmp(res, x))
+            ret = 1;
+        query[2] += omp_get_wtime() - elapsed;
+    }
+
+    (void)printf("BSGS QUERY TIME = %lf [s]\n", query[0] / DLOG_BENCH_TARGETS);
+    (void)printf("KANGAROO QUERY TIME = %lf [s]\n", query[1] / DLOG_BENCH_TARGETS);
+    if (table != NULL)
+        (void)printf("DENSE TABLE QUERY TIME = %lf [s]\n", query[2] / DLOG_BENCH_TARGETS);
+
+    if (ret)
+        (void)printf("FAILED!!!\n");
+    else
+        (void)printf("SUCCESS!!!\n");
+
+    bsgs_ctx_destroy(bsgs);
+    pollard_ctx_destroy(pollard);
+    dlog_table_destroy(table);
+
+    mpz_clear(f);
+    mpz_clear(k);
+    mpz_clear(p);
+    mpz_clear(g);
+    mpz_clear(h);
+    mpz_clear(x);
+    mpz_clear(res);
+    gmp_randclear(state);
+
+    return ret;
+}
+
+static void load_factors(int argc, char **argv, const mpz_t p, mpz_t **factors, mpz_t **exponents, size_t *f_len, pohling_digits_t *mode)
+{
+    /* for checking inputs */
+    mpz_t ord_p;
+    mpz_t temp;
+    mpz_t prod;
+
+    size_t i;
+
+    /* odd number of args after p, last one is digits mode */
+    *mode = POHLING_DIGITS_AUTO;
+    if (ODD(argc))
+    {
+        if (strcmp(argv[argc - 1], DIGITS_LINEAR) == 0)
+            *mode = POHLING_DIGITS_LINEAR;
+        else if (strcmp(argv[argc - 1], DIGITS_TREE) == 0)
+            *mode = POHLING_DIGITS_TREE;
+    }
 
     mpz_init(ord_p);
     mpz_sub_ui(ord_p, p, 1);
@@ -89,24 +384,190 @@ int main(int argc, char **argv)
     mpz_init(prod);
     mpz_set_ui(prod, 1);
 
-    argv += 4;
-    for (i = 0; i < f_len; ++i)
+    *f_len = (size_t)argc >> 1;
+    if (*f_len == 0)
     {
-        mpz_init(factors[i]);
-        mpz_set_str(factors[i], *(argv++), BASE);
+        /* factors are not given, find them */
+        if (factorize(ord_p, factors, exponents, f_len))
+            FATAL("Cannot factorize p - 1\n");
 
-        mpz_init(exponents[i]);
-        mpz_set_str(exponents[i], *(argv++), BASE);
+        for (i = 0; i < *f_len; ++i)
+        {
+            (void)gmp_printf("FACTOR %Zd ^ %Zd\n", (*factors)[i], (*exponents)[i]);
 
-        mpz_powm(temp, factors[i], exponents[i], p);
-        mpz_mul(prod, prod, temp);
+            mpz_powm(temp, (*factors)[i], (*exponents)[i], p);
+            mpz_mul(prod, prod, temp);
+        }
+    }
+    else
+    {
+        *factors = (mpz_t *)malloc(sizeof(mpz_t) * *f_len);
+        if (*factors == NULL)
+            FATAL("malloc error\n");
+
+        *exponents = (mpz_t *)malloc(sizeof(mpz_t) * *f_len);
+        if (*exponents == NULL)
+            FATAL("malloc error\n");
+
+        for (i = 0; i < *f_len; ++i)
+        {
+            mpz_init((*factors)[i]);
+            mpz_set_str((*factors)[i], *(argv++), BASE);
+
+            mpz_init((*exponents)[i]);
+            mpz_set_str((*exponents)[i], *(argv++), BASE);
+
+            mpz_powm(temp, (*factors)[i], (*exponents)[i], p);
+            mpz_mul(prod, prod, temp);
+        }
     }
 
     if (mpz_cmp(ord_p, prod))
         FATAL("Ord p has incorrect factors\n");
 
+    mpz_clear(ord_p);
+    mpz_clear(temp);
+    mpz_clear(prod);
+}
+
+static int batch(int argc, char **argv)
+{
+    mpz_t g;
+    mpz_t p;
+    mpz_t *h = NULL;
+    mpz_t *x;
+    mpz_t temp;
+
+    mpz_t *factors;
+    mpz_t *exponents;
+    size_t f_len;
+    pohling_digits_t mode;
+
+    size_t h_len = 0;
+    size_t h_size = 0;
+    size_t solved = 0;
+    size_t i;
+    int ret;
+
+    if (argc < 4)
+        return help();
+
+    mpz_init(g);
+    mpz_init(p);
+    mpz_init(temp);
+
+    mpz_set_str(g, argv[2], BASE);
+    mpz_set_str(p, argv[3], BASE);
+
+    load_factors(argc - 4, argv + 4, p, &factors, &exponents, &f_len, &mode);
+
+    /* targets are whitespace separated */
+    while (mpz_inp_str(temp, stdin, BASE) > 0)
+    {
+        if (h_len == h_size)
+        {
+            h_size = h_size == 0 ? 64 : h_size << 1;
+            h = (mpz_t *)realloc(h, sizeof(mpz_t) * h_size);
+            if (h == NULL)
+                FATAL("realloc error\n");
+        }
+
+        mpz_init_set(h[h_len++], temp);
+    }
+
+    if (h_len == 0)
+        FATAL("No targets on stdin\n");
+
+    x = (mpz_t *)malloc(sizeof(mpz_t) * h_len);
+    if (x == NULL)
+        FATAL("malloc error\n");
+
+    for (i = 0; i < h_len; ++i)
+        mpz_init(x[i]);
+
+    (void)gmp_printf("Trying find x such that %Zd^x = h (mod %Zd) for %zu targets\n", g, p, h_len);
+    ret = pohling_discrete_log_batch(g, h, h_len, p, factors, exponents, f_len, mode, x);
+    if (ret)
+        (void)printf("FAILED\n");
+
+    for (i = 0; i < h_len; ++i)
+    {
+        mpz_powm(temp, g, x[i], p);
+        if (mpz_cmp(temp, h[i]) == 0)
+            ++solved;
+
+        (void)gmp_printf("X[%zu] = %Zd %s\n", i, x[i], mpz_cmp(temp, h[i]) == 0 ? "SUCCESS!!!" : "FAILED!!!");
+    }
+
+    (void)printf("SOLVED = %zu / %zu\n", solved, h_len);
+    ret = solved == h_len ? 0 : 1;
+
+    for (i = 0; i < h_len; ++i)
+    {
+        mpz_clear(h[i]);
+        mpz_clear(x[i]);
+    }
+
+    for (i = 0; i < f_len; ++i)
+    {
+        mpz_clear(factors[i]);
+        mpz_clear(exponents[i]);
+    }
+
+    mpz_clear(g);
+    mpz_clear(p);
+    mpz_clear(temp);
+
+    FREE(h);
+    FREE(x);
+    FREE(factors);
+    FREE(exponents);
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    mpz_t g;
+    mpz_t h;
+    mpz_t p;
+    mpz_t x;
+
+    mpz_t *factors;
+    mpz_t *exponents;
+    int res;
+    int ret;
+
+    size_t f_len;
+    pohling_digits_t mode;
+    size_t i;
+
+    if (argc > 1 && strcmp(argv[1], MODE_CRT) == 0)
+        return crt_bench(argc, argv);
+
+    if (argc > 1 && strcmp(argv[1], MODE_BATCH) == 0)
+        return batch(argc, argv);
+
+    if (argc > 1 && strcmp(argv[1], MODE_DLOG) == 0)
+        return dlog_bench(argc, argv);
+
+    if (argc < 4)
+        return help();
+
+    mpz_init(g);
+    mpz_init(h);
+    mpz_init(p);
+    mpz_init(x);
+
+    /* set g h p */
+    mpz_set_str(g, argv[1], BASE);
+    mpz_set_str(h, argv[2], BASE);
+    mpz_set_str(p, argv[3], BASE);
+
+    load_factors(argc - 4, argv + 4, p, &factors, &exponents, &f_len, &mode);
+
     (void)gmp_printf("Trying find x such that %Zd^x = %Zd (mod %Zd)\n", g, h, p);
-    res = pohling_discrete_log(g, h, p, factors, exponents, f_len, x);
+    res = pohling_discrete_log_digits(g, h, p, factors, exponents, f_len, mode, x);
 
     if (res)
         (void)printf("FAILED\n");
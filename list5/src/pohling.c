@@ -1,10 +1,212 @@
 #include <log.h>
 #include <pollard.h>
+#include <bsgs.h>
+#include <dlog_table.h>
 #include <pohling.h>
 #include <crt.h>
 #include <stdlib.h>
 #include <common.h>
 #include <string.h>
+#include <omp.h>
+#include <stdbool.h>
+
+/* subgroups of order <= POHLING_TABLE_MAX are always solved by lookup in table of all powers, up to DLOG_TABLE_MAX if it is cheaper */
+#define POHLING_TABLE_MAX (1ul << 12)
+
+/* environment variable with directory of dense tables shared across runs, tables are only in memory without it */
+#define POHLING_TABLE_DIR_ENV "POHLING_TABLE_DIR"
+
+/* table stored in directory is expected to serve POHLING_TABLE_RUNS runs, so they share cost of building */
+#define POHLING_TABLE_RUNS 64
+
+/* memory budget for baby steps table in bytes */
+#define POHLING_BSGS_MEMORY (1ul << 28)
+
+/* hash table lookup costs about POHLING_BSGS_LOOKUP_COST single limb modular multiplications (cache miss) */
+#define POHLING_BSGS_LOOKUP_COST 2
+
+/* kangaroo query starts threads and tame herd, it costs about POHLING_KANGAROO_SETUP_COST single limb multiplications */
+#define POHLING_KANGAROO_SETUP_COST (1ul << 16)
+
+/* digits of f^e with e >= POHLING_TREE_MIN_E are extracted by divide and conquer */
+#define POHLING_TREE_MIN_E 3
+
+/* every thread should do at least POHLING_THREAD_WORK group operations, otherwise fork costs more than it gives */
+#define POHLING_THREAD_WORK (1ul << 14)
+
+/* nodes of order product tree with more than POHLING_ORD_TASK_MIN factors are split into tasks */
+#define POHLING_ORD_TASK_MIN 2
+
+typedef enum DLOG_ENGINE
+{
+    DLOG_ENGINE_TABLE,      /* all f powers in mapped table, one lookup per digit */
+    DLOG_ENGINE_BSGS,       /* baby steps table fits in memory budget */
+    DLOG_ENGINE_KANGAROO    /* parallel kangaroo, O(1) memory */
+} dlog_engine_t;
+
+/* engine chosen for single subgroup <g> of order f */
+typedef struct Dlog_engine
+{
+    dlog_engine_t type;
+    unsigned int threads;
+    unsigned long baby; /* baby steps for BSGS */
+    double ratio; /* baby steps / giant steps */
+
+    Dlog_table *table;
+    Bsgs_ctx *bsgs;
+    Pollard_ctx *pollard;
+    omp_lock_t lock; /* kangaroo context keeps its herd and tame set, so its queries are serialized */
+} Dlog_engine;
+
+/* precomputation for subgroup of order f^e, shared by all targets h */
+typedef struct Pohling_subgroup
+{
+    unsigned long e;
+    bool tree; /* digits extraction by divide and conquer */
+    bool trivial; /* generator is 1, every log is 0 */
+
+    Dlog_engine engine; /* engine for subgroup of order f */
+    mpz_t f;
+    mpz_t *gpow; /* gpow[k] = g^(f^k), k < e */
+    mpz_t *fpow; /* fpow[k] = f^k, k <= e */
+} Pohling_subgroup;
+
+/* prime power subproblem scheduled as OpenMP task */
+typedef struct Pohling_task
+{
+    size_t index; /* index of factor */
+    double cost; /* e * sqrt(f) */
+    unsigned int threads; /* share of cores */
+} Pohling_task;
+
+/*
+    Choose engine and number of threads for subgroup of order f.
+    BSGS pays m baby steps once and ~f / 2m giant steps per digit, kangaroo ~2 * sqrt(f) steps per digit.
+    Every BSGS step has also table lookup, which matters only for small p, so the cheaper one is chosen.
+    Many targets share the engine, so baby steps table grows with sqrt(targets).
+    Dense table pays f steps once (nothing if it is already in table directory) and one lookup per digit
+
+    PARAMS
+    @IN g - generator of subgroup
+    @IN f - order of subgroup
+    @IN e - number of digits
+    @IN p - prime
+    @IN nproc - available threads
+    @IN targets - number of h solved by this engine
+    @OUT engine - engine with type, threads and baby set
+
+    RETURN
+    This is a void function
+*/
+static void dlog_engine_choose(const mpz_t g, const mpz_t f, const mpz_t e, const mpz_t p, unsigned int nproc, size_t targets, Dlog_engine *engine);
+
+/*
+    Create chosen engine for subgroup <g> of order f
+
+    PARAMS
+    @IN engine - engine after dlog_engine_choose
+    @IN g - generator of subgroup
+    @IN p - prime
+    @IN f - order of g
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int dlog_engine_create(Dlog_engine *engine, const mpz_t g, const mpz_t p, const mpz_t f);
+
+/*
+    Destroy engine contexts
+
+    PARAMS
+    @IN engine - engine
+
+    RETURN
+    This is a void function
+*/
+static void dlog_engine_destroy(Dlog_engine *engine);
+
+/*
+    Solve g^x = h in subgroup by chosen engine
+
+    PARAMS
+    @IN engine - engine
+    @IN h - result of power
+    @OUT x - x in [0, f)
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int dlog_engine_discrete_log(Dlog_engine *engine, const mpz_t h, mpz_t x);
+
+/*
+    Get engine name
+
+    PARAMS
+    @IN type - engine type
+
+    RETURN
+    Engine name
+*/
+static const char *dlog_engine_name(dlog_engine_t type);
+
+/*
+    Prepare subgroup <g> of order f^e: engine for order f, powers of g and f
+
+    PARAMS
+    @IN sub - subgroup
+    @IN g - generator of order f^e or 1
+    @IN p - prime
+    @IN f - factor
+    @IN e - exponent
+    @IN threads - threads available for engine
+    @IN targets - number of h solved in this subgroup
+    @IN mode - digits extraction strategy
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int pohling_subgroup_create(Pohling_subgroup *sub, const mpz_t g, const mpz_t p, const mpz_t f, const mpz_t e,
+                                   unsigned int threads, size_t targets, pohling_digits_t mode);
+
+/*
+    Destroy subgroup precomputation
+
+    PARAMS
+    @IN sub - subgroup
+
+    RETURN
+    This is a void function
+*/
+static void pohling_subgroup_destroy(Pohling_subgroup *sub);
+
+/*
+    Solve g^x = h in subgroup, can be called concurrently for different h
+
+    PARAMS
+    @IN sub - subgroup
+    @IN h - result in subgroup
+    @IN p - prime
+    @OUT x - x in [0, f^e)
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int pohling_subgroup_discrete_log(Pohling_subgroup *sub, const mpz_t h, const mpz_t p, mpz_t x);
+
+/*
+    Get name of subgroup engine
+
+    PARAMS
+    @IN sub - subgroup
+
+    RETURN
+    Engine name
+*/
+static const char *pohling_subgroup_engine_name(const Pohling_subgroup *sub);
 
 /*
     Solve pohling subproblem
@@ -15,13 +217,99 @@
     @IN p - prime
     @IN f- factor
     @IN e - exponent
+    @IN threads - threads available for this subproblem
+    @IN mode - digits extraction strategy
     @OUT x - x
 
     RETURN
     0 iff success
     Non-zero value iff failure
 */
-static int solve_discrete_subproblem(const mpz_t g, const mpz_t h, const mpz_t p, const mpz_t f, const mpz_t e, mpz_t x);
+static int solve_discrete_subproblem(const mpz_t g, const mpz_t h, const mpz_t p, const mpz_t f, const mpz_t e, unsigned int threads,
+                                     pohling_digits_t mode, mpz_t x);
+
+/*
+    Extract digits one by one, digit i needs (h * g^-x)^(f^(e - i)), so O(e^2) exponentiations by f
+
+    PARAMS
+    @IN sub - subgroup of order f^e
+    @IN h - result
+    @IN p - prime
+    @OUT x - x in [0, f^e)
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int solve_digits_linear(Pohling_subgroup *sub, const mpz_t h, const mpz_t p, mpz_t x);
+
+/*
+    Extract digits by Shoup divide and conquer: log of order f^e is split into e1 = e / 2 low and e - e1 high digits,
+    low digits are log of h^(f^(e - e1)), high digits are log of h * g^-x_low in subgroup of order f^(e - e1).
+    Powers g^(f^k) and f^k are precomputed once per subgroup, so it costs O(e log e) exponentiations by f
+
+    PARAMS
+    @IN sub - subgroup of order f^e
+    @IN h - result
+    @IN p - prime
+    @OUT x - x in [0, f^e)
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int solve_digits_tree(Pohling_subgroup *sub, const mpz_t h, const mpz_t p, mpz_t x);
+
+/*
+    Recursive step of solve_digits_tree, base of order f^len is gpow[e - len]
+
+    PARAMS
+    @IN engine - engine for subgroup of order f
+    @IN gpow - gpow[k] = g^(f^k)
+    @IN fpow - fpow[k] = f^k
+    @IN e - exponent
+    @IN len - number of digits to extract
+    @IN h - result in subgroup of order f^len
+    @IN p - prime
+    @OUT x - x in [0, f^len)
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int solve_digits_tree_rec(Dlog_engine *engine, const mpz_t *gpow, const mpz_t *fpow, unsigned long e, unsigned long len,
+                                 const mpz_t h, const mpz_t p, mpz_t x);
+
+/*
+    Compute expected cost e * sqrt(f) of every subproblem, divide threads in proportion to cost
+    and sort tasks, the most expensive first. Subgroup with generator 1 is trivial and costs nothing
+
+    PARAMS
+    @IN g - generators of subgroups
+    @IN factors - factors
+    @IN exponents - exponents
+    @IN len - len of arrays
+    @IN nproc - available threads
+    @OUT tasks - tasks sorted by cost
+
+    RETURN
+    This is a void function
+*/
+static void schedule_subproblems(mpz_t *g, mpz_t *factors, mpz_t *exponents, size_t len, unsigned int nproc, Pohling_task *tasks);
+
+/*
+    Compare tasks by cost, descending
+
+    PARAMS
+    @IN a - (void *)&Pohling_task
+    @IN b - (void *)&Pohling_task
+
+    RETURN
+    -1 iff a is more expensive than b
+    1 iff a is cheaper than b
+    0 iff costs are equal
+*/
+static int pohling_task_cmp(const void *a, const void *b);
 
 /*
     Delete e == zeros in array
@@ -37,7 +325,57 @@ static int solve_discrete_subproblem(const mpz_t g, const mpz_t h, const mpz_t p
 static size_t delete_zeros(mpz_t *f, mpz_t *e, size_t len);
 
 /*
-    Calculate Order of subgroup generate by g
+    Build product tree of prime powers, node covers factors [lo, hi)
+
+    PARAMS
+    @IN tree - tree in heap layout
+    @IN node - index of node
+    @IN factors - factors
+    @IN exponents - exponents
+    @IN lo - first factor
+    @IN hi - last factor + 1
+
+    RETURN
+    This is a void function
+*/
+static void ord_tree_build(mpz_t *tree, size_t node, mpz_t *factors, mpz_t *exponents, size_t lo, size_t hi);
+
+/*
+    Destroy product tree
+
+    PARAMS
+    @IN tree - tree in heap layout
+    @IN node - index of node
+    @IN lo - first factor
+    @IN hi - last factor + 1
+
+    RETURN
+    This is a void function
+*/
+static void ord_tree_destroy(mpz_t *tree, size_t node, size_t lo, size_t hi);
+
+/*
+    Find exponents of factors [lo, hi) in ord(a), ord(a) divides tree[node].
+    Element is split into a^(right product) and a^(left product), so every level needs 2 exponentiations
+    per node instead of exponentiation per factor and exponent
+
+    PARAMS
+    @IN tree - product tree
+    @IN node - index of node
+    @IN a - element
+    @IN p - prime
+    @IN factors - factors
+    @IN / OUT exponents - exponents of p - 1, after exponents of ord(a)
+    @IN lo - first factor
+    @IN hi - last factor + 1
+
+    RETURN
+    This is a void function
+*/
+static void ord_tree_descend(mpz_t *tree, size_t node, const mpz_t a, const mpz_t p, mpz_t *factors, mpz_t *exponents, size_t lo, size_t hi);
+
+/*
+    Calculate Order of subgroup generate by g, O(log len) levels of exponentiations
 
     PARAMS
     @IN g - generator
@@ -51,155 +389,635 @@ static size_t delete_zeros(mpz_t *f, mpz_t *e, size_t len);
 */
 static void calculate_ord(const mpz_t g, const mpz_t p, mpz_t *factors, mpz_t *exponents, size_t len, mpz_t ord);
 
-static void calculate_ord(const mpz_t g, const mpz_t p, mpz_t *factors, mpz_t *exponents, size_t len, mpz_t ord)
+static void ord_tree_build(mpz_t *tree, size_t node, mpz_t *factors, mpz_t *exponents, size_t lo, size_t hi)
+{
+    const size_t mid = lo + ((hi - lo) >> 1);
+
+    mpz_init(tree[node]);
+    if (hi - lo == 1)
+    {
+        mpz_pow_ui(tree[node], factors[lo], mpz_get_ui(exponents[lo]));
+        return;
+    }
+
+#pragma omp task if(hi - lo > POHLING_ORD_TASK_MIN)
+    ord_tree_build(tree, (node << 1) + 1, factors, exponents, lo, mid);
+
+#pragma omp task if(hi - lo > POHLING_ORD_TASK_MIN)
+    ord_tree_build(tree, (node << 1) + 2, factors, exponents, mid, hi);
+
+#pragma omp taskwait
+    mpz_mul(tree[node], tree[(node << 1) + 1], tree[(node << 1) + 2]);
+}
+
+static void ord_tree_destroy(mpz_t *tree, size_t node, size_t lo, size_t hi)
+{
+    const size_t mid = lo + ((hi - lo) >> 1);
+
+    mpz_clear(tree[node]);
+    if (hi - lo == 1)
+        return;
+
+    ord_tree_destroy(tree, (node << 1) + 1, lo, mid);
+    ord_tree_destroy(tree, (node << 1) + 2, mid, hi);
+}
+
+static void ord_tree_descend(mpz_t *tree, size_t node, const mpz_t a, const mpz_t p, mpz_t *factors, mpz_t *exponents, size_t lo, size_t hi)
+{
+    const size_t mid = lo + ((hi - lo) >> 1);
+    unsigned long k;
+    unsigned long max;
+    size_t i;
+
+    mpz_t a_left;
+    mpz_t a_right;
+
+    /* ord(a) = 1, so no factor from this node divides it */
+    if (mpz_cmp_ui(a, 1) == 0)
+    {
+        for (i = lo; i < hi; ++i)
+            mpz_set_ui(exponents[i], 0);
+
+        return;
+    }
+
+    /* ord(a) = f^k, k <= e */
+    if (hi - lo == 1)
+    {
+        mpz_init_set(a_left, a);
+
+        max = mpz_get_ui(exponents[lo]);
+        for (k = 0; k < max && mpz_cmp_ui(a_left, 1) != 0; ++k)
+            mpz_powm(a_left, a_left, factors[lo], p);
+
+        mpz_set_ui(exponents[lo], k);
+        mpz_clear(a_left);
+
+        return;
+    }
+
+    mpz_init(a_left);
+    mpz_init(a_right);
+
+    /* a^(right product) has order from left factors only and vice versa */
+    mpz_powm(a_left, a, tree[(node << 1) + 2], p);
+    mpz_powm(a_right, a, tree[(node << 1) + 1], p);
+
+#pragma omp task if(hi - lo > POHLING_ORD_TASK_MIN)
+    ord_tree_descend(tree, (node << 1) + 1, a_left, p, factors, exponents, lo, mid);
+
+#pragma omp task if(hi - lo > POHLING_ORD_TASK_MIN)
+    ord_tree_descend(tree, (node << 1) + 2, a_right, p, factors, exponents, mid, hi);
+
+#pragma omp taskwait
+    mpz_clear(a_left);
+    mpz_clear(a_right);
+}
+
+static void calculate_ord(const mpz_t g, const mpz_t p, mpz_t *factors, mpz_t *exponents, size_t len, mpz_t ord)
+{
+    mpz_t *tree;
+    mpz_t temp;
+    size_t i;
+
+    TRACE();
+
+    /* heap layout, node i has children 2i + 1 and 2i + 2 */
+    tree = (mpz_t *)malloc(sizeof(mpz_t) * (len << 2));
+    if (tree == NULL)
+        FATAL("malloc error\n");
+
+#pragma omp parallel shared(tree, g, p, factors, exponents, len)
+{
+#pragma omp single
+    {
+        ord_tree_build(tree, 0, factors, exponents, 0, len);
+        ord_tree_descend(tree, 0, g, p, factors, exponents, 0, len);
+    }
+}
+
+    ord_tree_destroy(tree, 0, 0, len);
+    FREE(tree);
+
+    mpz_init(temp);
+    mpz_set_ui(ord, 1);
+    for (i = 0; i < len; ++i)
+    {
+        mpz_pow_ui(temp, factors[i], mpz_get_ui(exponents[i]));
+        mpz_mul(ord, ord, temp);
+    }
+
+    if (mpz_cmp_ui(ord, 1) == 0)
+    {
+        mpz_set(ord, factors[len - 1]);
+        mpz_set_ui(exponents[len - 1], 1);
+    }
+
+    mpz_clear(temp);
+}
+
+static size_t delete_zeros(mpz_t *f, mpz_t *e, size_t len)
+{
+    size_t i;
+
+    TRACE();
+
+    for (i = 0; i < len; ++i)
+        while (mpz_cmp_ui(e[i], 0) == 0)
+        {
+            (void)memmove(f + i, f + i + 1, (len - i - 1) * sizeof(mpz_t));
+            (void)memmove(e + i, e + i + 1, (len - i - 1) * sizeof(mpz_t));
+            --len;
+        }
+
+    return len;
+}
+
+static void dlog_engine_choose(const mpz_t g, const mpz_t f, const mpz_t e, const mpz_t p, unsigned int nproc, size_t targets, Dlog_engine *engine)
+{
+    const double fd = mpz_get_d(f);
+    const double ed = mpz_get_d(e) * (double)targets;
+
+    /* cost of modular multiplication in single limb multiplications */
+    const size_t limbs = mpz_size(p);
+    const double mul = (double)(limbs * limbs);
+    const size_t bits = mpz_sizeinbase(f, 2);
+    const char *dir = getenv(POHLING_TABLE_DIR_ENV);
+
+    double bsgs_cost;
+    double kangaroo_cost;
+    double table_cost;
+    double best;
+    double work;
+    mpz_t root;
+
+    TRACE();
+
+    engine->table = NULL;
+    engine->bsgs = NULL;
+    engine->pollard = NULL;
+    engine->baby = 0;
+    engine->ratio = 1.0;
+
+    if (mpz_cmp_ui(f, POHLING_TABLE_MAX) <= 0)
+    {
+        engine->type = DLOG_ENGINE_TABLE;
+        engine->threads = 1;
+        return;
+    }
+
+    mpz_init(root);
+    mpz_sqrt(root, f);
+
+    /* kangaroo steps of single digit */
+    work = 2.0 * mpz_get_d(root);
+    kangaroo_cost = work * mul + (double)POHLING_KANGAROO_SETUP_COST;
+
+    engine->type = DLOG_ENGINE_KANGAROO;
+    best = ed * kangaroo_cost;
+    if (mpz_fits_ulong_p(f))
+    {
+        /* m = sqrt(f * targets), so giant steps of every target are cheaper */
+        engine->ratio = (double)targets;
+        engine->baby = bsgs_baby_steps(f, POHLING_BSGS_MEMORY, engine->ratio);
+
+        bsgs_cost = (double)engine->baby + ed * fd / (2.0 * (double)engine->baby);
+        bsgs_cost *= mul + POHLING_BSGS_LOOKUP_COST;
+        if (bsgs_cost <= best)
+        {
+            engine->type = DLOG_ENGINE_BSGS;
+            best = bsgs_cost;
+            work = (double)engine->baby;
+        }
+    }
+
+    if (mpz_cmp_ui(f, DLOG_TABLE_MAX) <= 0)
+    {
+        /* lookup is verified by exponentiation with log2(f) bits exponent */
+        table_cost = ed * (double)bits * mul;
+        if (!dlog_table_exists(g, p, f, dir))
+            table_cost += fd * (mul + POHLING_BSGS_LOOKUP_COST) / (dir != NULL ? (double)POHLING_TABLE_RUNS : 1.0);
+
+        if (table_cost <= best)
+        {
+            engine->type = DLOG_ENGINE_TABLE;
+            work = fd;
+        }
+    }
+
+    mpz_clear(root);
+
+    work /= (double)POHLING_THREAD_WORK;
+    engine->threads = work < (double)nproc ? (unsigned int)work : nproc;
+    if (engine->threads == 0)
+        engine->threads = 1;
+}
+
+static int dlog_engine_create(Dlog_engine *engine, const mpz_t g, const mpz_t p, const mpz_t f)
+{
+    TRACE();
+
+    switch (engine->type)
+    {
+        case DLOG_ENGINE_TABLE:
+        {
+            /* tiny tables are built faster than read from disk */
+            engine->table = dlog_table_create(g, p, f, mpz_cmp_ui(f, POHLING_TABLE_MAX) > 0 ? getenv(POHLING_TABLE_DIR_ENV) : NULL, engine->threads);
+            if (engine->table == NULL)
+                ERROR("dlog_table_create error\n", 1);
+
+            break;
+        }
+        case DLOG_ENGINE_BSGS:
+        {
+            engine->bsgs = bsgs_ctx_create(g, p, f, POHLING_BSGS_MEMORY, engine->ratio, engine->threads);
+            if (engine->bsgs == NULL)
+                ERROR("bsgs_ctx_create error\n", 1);
+
+            break;
+        }
+        case DLOG_ENGINE_KANGAROO:
+        {
+            engine->pollard = pollard_ctx_create(g, p, f, f, POLLARD_TUNE_AUTO, engine->threads);
+            if (engine->pollard == NULL)
+                ERROR("pollard_ctx_create error\n", 1);
+
+            omp_init_lock(&engine->lock);
+            break;
+        }
+        default:
+            ERROR("unknown engine\n", 1);
+    }
+
+    return 0;
+}
+
+static void dlog_engine_destroy(Dlog_engine *engine)
+{
+    TRACE();
+
+    if (engine->pollard != NULL)
+        omp_destroy_lock(&engine->lock);
+
+    dlog_table_destroy(engine->table);
+    bsgs_ctx_destroy(engine->bsgs);
+    pollard_ctx_destroy(engine->pollard);
+
+    engine->table = NULL;
+    engine->bsgs = NULL;
+    engine->pollard = NULL;
+}
+
+static int dlog_engine_discrete_log(Dlog_engine *engine, const mpz_t h, mpz_t x)
+{
+    int ret;
+
+    TRACE();
+
+    /* tables are read only, many queries can share them */
+    if (engine->table != NULL)
+        return dlog_table_discrete_log(engine->table, h, x);
+
+    if (engine->bsgs != NULL)
+        return bsgs_ctx_discrete_log(engine->bsgs, h, x);
+
+    omp_set_lock(&engine->lock);
+    ret = pollard_ctx_dicsrete_log(engine->pollard, h, x);
+    omp_unset_lock(&engine->lock);
+
+    return ret;
+}
+
+static const char *dlog_engine_name(dlog_engine_t type)
+{
+    switch (type)
+    {
+        case DLOG_ENGINE_TABLE:
+            return "TABLE";
+        case DLOG_ENGINE_BSGS:
+            return "BSGS";
+        case DLOG_ENGINE_KANGAROO:
+            return "KANGAROO";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+static int pohling_task_cmp(const void *a, const void *b)
+{
+    const Pohling_task *t1 = (const Pohling_task *)a;
+    const Pohling_task *t2 = (const Pohling_task *)b;
+
+    if (t1->cost != t2->cost)
+        return t1->cost > t2->cost ? -1 : 1;
+
+    return 0;
+}
+
+static void schedule_subproblems(mpz_t *g, mpz_t *factors, mpz_t *exponents, size_t len, unsigned int nproc, Pohling_task *tasks)
 {
-
+    double total = 0.0;
+    double share;
     size_t i;
-    size_t j;
-    size_t max;
-    mpz_t temp;
+    mpz_t root;
 
     TRACE();
 
-    mpz_init(temp);
+    mpz_init(root);
 
-    /* for each factors */
     for (i = 0; i < len; ++i)
     {
-        /* max for each exponent */
-        max = (size_t)mpz_get_ui(exponents[i]);
-        for (j = 0; j < max; ++j)
-        {
-            /* check if g^(ord / factors[i]) == 1 */
-            mpz_div(temp, ord, factors[i]);
-            mpz_powm(temp, g, temp, p);
-            if (mpz_cmp_ui(temp, 1) == 0) /* if yes we know that ord is not order */
-            {
-                mpz_sub_ui(exponents[i], exponents[i], 1);
-                mpz_div(ord, ord, factors[i]);
-            }
-            else
-                break;
-        }
-    }
+        mpz_sqrt(root, factors[i]);
 
-    if (mpz_cmp_ui(ord, 1) == 0)
-    {
-        mpz_set(ord, factors[len - 1]);
-        mpz_set_ui(exponents[len - 1], 1);
+        tasks[i].index = i;
+        tasks[i].cost = mpz_cmp_ui(g[i], 1) == 0 ? 0.0 : mpz_get_d(exponents[i]) * mpz_get_d(root);
+        total += tasks[i].cost;
     }
 
-    mpz_clear(temp);
-}
-
-static size_t delete_zeros(mpz_t *f, mpz_t *e, size_t len)
-{
-    size_t i;
-
-    TRACE();
+    mpz_clear(root);
 
+    /* every task gets at least one thread */
     for (i = 0; i < len; ++i)
-        while (mpz_cmp_ui(e[i], 0) == 0)
-        {
-            (void)memmove(f + i, f + i + 1, (len - i - 1) * sizeof(mpz_t));
-            (void)memmove(e + i, e + i + 1, (len - i - 1) * sizeof(mpz_t));
-            --len;
-        }
+    {
+        share = total > 0.0 ? (double)nproc * tasks[i].cost / total + 0.5 : 1.0;
+        tasks[i].threads = share < 1.0 ? 1 : (unsigned int)share;
+        tasks[i].threads = MIN(tasks[i].threads, nproc);
+    }
 
-    return len;
+    /* the most expensive start first, cheap ones fill the gaps */
+    qsort(tasks, len, sizeof(Pohling_task), pohling_task_cmp);
 }
 
-static int solve_discrete_subproblem(const mpz_t g, const mpz_t h, const mpz_t p, const mpz_t f, const mpz_t e, mpz_t x)
+static int solve_digits_linear(Pohling_subgroup *sub, const mpz_t h, const mpz_t p, mpz_t x)
 {
     mpz_t inv;
-    mpz_t less_e;
-
-    mpz_t new_g;
 
     mpz_t temp1;
-    mpz_t temp2;
     mpz_t temp_x;
 
-    mpz_t temp_mod;
-
-    mpz_t i;
+    unsigned long i;
 
     TRACE();
 
     mpz_init(inv);
-    mpz_invert(inv, g, p);
-
-    mpz_init(less_e);
-    mpz_sub_ui(less_e, e, 1);
+    mpz_invert(inv, sub->gpow[0], p);
 
     mpz_init(temp1);
-    mpz_init(temp2);
     mpz_init(temp_x);
-    mpz_init(temp_mod);
-    mpz_init(new_g);
 
-    mpz_init(i);
     mpz_set_ui(x, 0);
 
-    /* new_g = g^(f^(e-1)) mod p */
-    mpz_powm(new_g, f, less_e, p);
-    mpz_powm(new_g, g, new_g, p);
-
     /* x = x[0] * q^0 + x[1] * q^1 ... + x[e - 1] ^g(e - 1) */
-    for (mpz_set_ui(i, 1); mpz_cmp(i, e) <= 0; mpz_add_ui(i, i, 1))
+    for (i = 1; i <= sub->e; ++i)
     {
-        gmp_printf("\tSUB = %Zd / %Zd\n", i, e);
-        mpz_powm(temp_mod, f, i, p);
+        gmp_printf("\tSUB = %lu / %lu\n", i, sub->e);
         /* temp1 = (h *(g^-x))^f^(e - i) mod p */
         mpz_powm(temp1, inv, x, p);
         mpz_mul(temp1, temp1, h);
+        mpz_powm(temp1, temp1, sub->fpow[sub->e - i], p);
 
-        mpz_sub(temp2, e, i);
-        mpz_powm(temp2, f, temp2, p);
-
-        mpz_powm(temp1, temp1, temp2, p);
+        gmp_printf("x = log %Zd mod %Zd\n", temp1, p);
+        if (dlog_engine_discrete_log(&sub->engine, temp1, temp_x))
+        {
+            mpz_clear(temp1);
+            mpz_clear(temp_x);
+            mpz_clear(inv);
 
-        gmp_printf("%Zd ^x = %Zd mod %Zd\n", new_g, temp1, p);
-        if (pollard_lambda_parallel_dicsrete_log(new_g, temp1, p, temp_x))
-            ERROR("pollard error\n", 1);
+            ERROR("dlog engine error\n", 1);
+        }
 
-        /* x must be in [0 ... f^e] */
-        mpz_mod(temp_x, temp_x, temp_mod);
+        /* digit must be in [0, f) */
+        mpz_mod(temp_x, temp_x, sub->f);
 
         /* X = x * f ^ (i - 1) */
-        mpz_sub_ui(temp2, i, 1);
-        mpz_powm(temp1, f, temp2, p);
-        mpz_mul(temp_x, temp_x, temp1);
-        mpz_add(x, x, temp_x);
+        mpz_addmul(x, temp_x, sub->fpow[i - 1]);
     }
 
-    mpz_clear(i);
     mpz_clear(temp1);
-    mpz_clear(temp2);
     mpz_clear(temp_x);
     mpz_clear(inv);
-    mpz_clear(less_e);
-    mpz_clear(new_g);
-    mpz_clear(temp_mod);
 
     return 0;
 }
 
+static int solve_digits_tree_rec(Dlog_engine *engine, const mpz_t *gpow, const mpz_t *fpow, unsigned long e, unsigned long len,
+                                 const mpz_t h, const mpz_t p, mpz_t x)
+{
+    unsigned long low;
+    mpz_t temp;
+    mpz_t x_high;
+    int ret;
+
+    /* single digit, base is g^(f^(e - 1)) */
+    if (len == 1)
+    {
+        if (dlog_engine_discrete_log(engine, h, x))
+            ERROR("dlog engine error\n", 1);
+
+        mpz_mod(x, x, fpow[1]);
+
+        return 0;
+    }
+
+    low = len >> 1;
+
+    mpz_init(temp);
+    mpz_init(x_high);
+
+    /* low digits: h^(f^(len - low)) is in subgroup of order f^low */
+    mpz_powm(temp, h, fpow[len - low], p);
+    ret = solve_digits_tree_rec(engine, gpow, fpow, e, low, temp, p, x);
+
+    if (ret == 0)
+    {
+        /* high digits: h * base^(-x_low) = base^(f^low * x_high), base^(-x_low) = base^(f^len - x_low) */
+        mpz_sub(temp, fpow[len], x);
+        mpz_powm(temp, gpow[e - len], temp, p);
+        mpz_mul(temp, temp, h);
+        mpz_mod(temp, temp, p);
+
+        ret = solve_digits_tree_rec(engine, gpow, fpow, e, len - low, temp, p, x_high);
+
+        /* x = x_low + f^low * x_high */
+        mpz_addmul(x, fpow[low], x_high);
+    }
+
+    mpz_clear(temp);
+    mpz_clear(x_high);
+
+    return ret;
+}
+
+static int solve_digits_tree(Pohling_subgroup *sub, const mpz_t h, const mpz_t p, mpz_t x)
+{
+    TRACE();
+
+    return solve_digits_tree_rec(&sub->engine, (const mpz_t *)sub->gpow, (const mpz_t *)sub->fpow, sub->e, sub->e, h, p, x);
+}
+
+static int pohling_subgroup_create(Pohling_subgroup *sub, const mpz_t g, const mpz_t p, const mpz_t f, const mpz_t e,
+                                   unsigned int threads, size_t targets, pohling_digits_t mode)
+{
+    unsigned long i;
+
+    TRACE();
+
+    sub->e = mpz_get_ui(e);
+    sub->tree = mode == POHLING_DIGITS_TREE || (mode == POHLING_DIGITS_AUTO && sub->e >= POHLING_TREE_MIN_E);
+    sub->trivial = mpz_cmp_ui(g, 1) == 0;
+
+    sub->gpow = (mpz_t *)malloc(sizeof(mpz_t) * sub->e);
+    if (sub->gpow == NULL)
+        ERROR("malloc error\n", 1);
+
+    sub->fpow = (mpz_t *)malloc(sizeof(mpz_t) * (sub->e + 1));
+    if (sub->fpow == NULL)
+    {
+        FREE(sub->gpow);
+        ERROR("malloc error\n", 1);
+    }
+
+    /* fpow[k] = f^k, gpow[k] = g^(f^k), gpow[e - 1] has order f */
+    mpz_init_set(sub->f, f);
+    mpz_init_set_ui(sub->fpow[0], 1);
+    mpz_init_set(sub->gpow[0], g);
+    for (i = 1; i <= sub->e; ++i)
+    {
+        mpz_init(sub->fpow[i]);
+        mpz_mul(sub->fpow[i], sub->fpow[i - 1], f);
+
+        if (i == sub->e)
+            break;
+
+        mpz_init(sub->gpow[i]);
+        mpz_powm(sub->gpow[i], sub->gpow[i - 1], f, p);
+    }
+
+    /*
+        ord(gpow[e - 1]) = f, so every digit is in [0, f) and costs O(sqrt(f)) steps.
+        Engine precomputation (tables, jumps, tame kangaroos) is shared by all digits and all targets
+    */
+    sub->engine.table = NULL;
+    sub->engine.bsgs = NULL;
+    sub->engine.pollard = NULL;
+    if (sub->trivial)
+        return 0;
+
+    dlog_engine_choose(sub->gpow[sub->e - 1], f, e, p, threads, targets, &sub->engine);
+    if (dlog_engine_create(&sub->engine, sub->gpow[sub->e - 1], p, f))
+    {
+        pohling_subgroup_destroy(sub);
+        ERROR("dlog_engine_create error\n", 1);
+    }
+
+    /* table is built by all threads, but queries of many targets run concurrently */
+    if (sub->engine.bsgs != NULL && targets > 1)
+        bsgs_ctx_set_threads(sub->engine.bsgs, sub->engine.threads / (unsigned int)MIN(targets, (size_t)sub->engine.threads));
+
+    return 0;
+}
+
+static void pohling_subgroup_destroy(Pohling_subgroup *sub)
+{
+    unsigned long i;
+
+    TRACE();
+
+    dlog_engine_destroy(&sub->engine);
+
+    for (i = 0; i < sub->e; ++i)
+    {
+        mpz_clear(sub->gpow[i]);
+        mpz_clear(sub->fpow[i]);
+    }
+    mpz_clear(sub->fpow[sub->e]);
+    mpz_clear(sub->f);
+
+    FREE(sub->gpow);
+    FREE(sub->fpow);
+}
+
+static int pohling_subgroup_discrete_log(Pohling_subgroup *sub, const mpz_t h, const mpz_t p, mpz_t x)
+{
+    TRACE();
+
+    if (sub->trivial)
+    {
+        mpz_set_ui(x, 0);
+        return 0;
+    }
+
+    if (sub->tree)
+        return solve_digits_tree(sub, h, p, x);
+
+    return solve_digits_linear(sub, h, p, x);
+}
+
+static const char *pohling_subgroup_engine_name(const Pohling_subgroup *sub)
+{
+    if (sub->trivial)
+        return "TRIVIAL";
+
+    if (sub->engine.table != NULL && dlog_table_loaded(sub->engine.table))
+        return "MAPPED TABLE";
+
+    return dlog_engine_name(sub->engine.type);
+}
+
+static int solve_discrete_subproblem(const mpz_t g, const mpz_t h, const mpz_t p, const mpz_t f, const mpz_t e, unsigned int threads,
+                                     pohling_digits_t mode, mpz_t x)
+{
+    Pohling_subgroup sub;
+    double start;
+    int ret;
+
+    TRACE();
+
+    start = omp_get_wtime();
+
+    if (pohling_subgroup_create(&sub, g, p, f, e, threads, 1, mode))
+        ERROR("pohling_subgroup_create error\n", 1);
+
+    gmp_printf("\tENGINE = %s, THREADS = %u, f = %Zd\n", pohling_subgroup_engine_name(&sub), sub.trivial ? 1 : sub.engine.threads, f);
+
+    ret = pohling_subgroup_discrete_log(&sub, h, p, x);
+
+    gmp_printf("\tENGINE = %s, DIGITS = %s, f = %Zd, TIME = %lf [s]\n", pohling_subgroup_engine_name(&sub), sub.tree ? "TREE" : "LINEAR", f, omp_get_wtime() - start);
+
+    pohling_subgroup_destroy(&sub);
+
+    return ret;
+}
+
 int pohling_discrete_log(mpz_t g, mpz_t h, const mpz_t p, mpz_t *factors, mpz_t *exponents, size_t f_len, mpz_t x)
 {
+    return pohling_discrete_log_digits(g, h, p, factors, exponents, f_len, POHLING_DIGITS_AUTO, x);
+}
+
+int pohling_discrete_log_digits(mpz_t g, mpz_t h, const mpz_t p, mpz_t *factors, mpz_t *exponents, size_t f_len,
+                                pohling_digits_t mode, mpz_t x)
+{
+    const unsigned int nproc = (unsigned int)omp_get_max_threads();
+
     mpz_t *x_array;
     mpz_t *p_array;
+    mpz_t *g_array;
+    mpz_t *h_array;
+
+    Pohling_task *tasks;
+    int *status;
 
     mpz_t ord_p;
-    mpz_t new_g;
-    mpz_t new_h;
 
-    mpz_t temp1;
-    mpz_t temp2;
+    mpz_t temp;
 
     mpz_t Q;
 
     size_t i;
+    size_t j;
+    int levels;
+    int ret = 0;
+    double start;
 
     TRACE();
 
@@ -211,13 +1029,31 @@ int pohling_discrete_log(mpz_t g, mpz_t h, const mpz_t p, mpz_t *factors, mpz_t
     if (p_array == NULL)
         ERROR("malloc error\n", 1);
 
+    g_array = (mpz_t *)malloc(sizeof(mpz_t) * f_len);
+    if (g_array == NULL)
+        ERROR("malloc error\n", 1);
+
+    h_array = (mpz_t *)malloc(sizeof(mpz_t) * f_len);
+    if (h_array == NULL)
+        ERROR("malloc error\n", 1);
+
+    tasks = (Pohling_task *)malloc(sizeof(Pohling_task) * f_len);
+    if (tasks == NULL)
+        ERROR("malloc error\n", 1);
+
+    status = (int *)calloc(f_len, sizeof(int));
+    if (status == NULL)
+        ERROR("malloc error\n", 1);
+
     /* ord_p = p - 1 */
     mpz_init(ord_p);
     mpz_sub_ui(ord_p, p, 1);
 
+    start = omp_get_wtime();
     calculate_ord(g, p, factors, exponents, f_len, ord_p);
     f_len = delete_zeros(factors, exponents, f_len);
     (void)gmp_printf("Order g = %Zd\n", ord_p);
+    (void)printf("ORDER TIME = %lf [s]\n", omp_get_wtime() - start);
 
     mpz_init(Q);
     mpz_powm(Q, factors[f_len - 1], exponents[f_len - 1], p);
@@ -227,50 +1063,246 @@ int pohling_discrete_log(mpz_t g, mpz_t h, const mpz_t p, mpz_t *factors, mpz_t
         mpz_powm(h, h, Q, p);
     }
 
-    mpz_init(temp1);
-    mpz_init(temp2);
-    mpz_init(new_g);
-    mpz_init(new_h);
+    start = omp_get_wtime();
+
+    /* subproblems are independent, so prepare all of them first */
+    mpz_init(temp);
     for (i = 0; i < f_len; ++i)
     {
-        printf("MAIN = %zu / %zu\n", i + 1, f_len);
+        mpz_init(x_array[i]);
+        mpz_init(p_array[i]);
+        mpz_init(g_array[i]);
+        mpz_init(h_array[i]);
 
         /* new_g = g^(n/f^e), new_h = h^(n/f^e) */
-        mpz_powm(temp1, factors[i], exponents[i], p);
-        mpz_div(temp2, ord_p, temp1);
+        mpz_powm(p_array[i], factors[i], exponents[i], p);
+        mpz_div(temp, ord_p, p_array[i]);
 
-        mpz_powm(new_g, g, temp2, p);
-        mpz_powm(new_h, h, temp2, p);
+        mpz_powm(g_array[i], g, temp, p);
+        mpz_powm(h_array[i], h, temp, p);
+    }
 
-        mpz_init(x_array[i]);
-        gmp_printf("MAIN %Zd^x = %Zd mod %Zd\n", new_g, new_h, p);
-        if (solve_discrete_subproblem(new_g, new_h, p, factors[i], exponents[i], x_array[i]))
-            ERROR("Cannot solve discrete log subproblem\n", 1);
+    schedule_subproblems(g_array, factors, exponents, f_len, nproc, tasks);
 
-        mpz_init(p_array[i]);
-        mpz_set(p_array[i], temp1);
+    /* every task opens its own parallel region for engine */
+    levels = omp_get_max_active_levels();
+    omp_set_max_active_levels(2);
+
+#pragma omp parallel num_threads(MIN(nproc, (unsigned int)f_len)) private(i, j) shared(tasks, status, factors, exponents, p, x_array, g_array, h_array, f_len, mode)
+{
+#pragma omp single
+    {
+        for (i = 0; i < f_len; ++i)
+        {
+            j = tasks[i].index;
+#pragma omp task firstprivate(i, j)
+            {
+                (void)gmp_printf("MAIN = %zu / %zu, THREADS = %u, %Zd^x = %Zd mod %Zd\n", i + 1, f_len, tasks[i].threads, g_array[j], h_array[j], p);
+                status[j] = solve_discrete_subproblem(g_array[j], h_array[j], p, factors[j], exponents[j], tasks[i].threads, mode, x_array[j]);
+            }
+        }
     }
+}
+
+    omp_set_max_active_levels(levels);
 
-    if (crt((const mpz_t *)x_array, (const mpz_t *)p_array, f_len, x))
-        ERROR("Chinese remainder error\n", 1);
+    printf("SUBPROBLEMS TIME = %lf [s]\n", omp_get_wtime() - start);
+
+    for (i = 0; i < f_len; ++i)
+        if (status[i])
+            ret = 1;
 
-    mpz_mod(x, x, ord_p);
+    if (ret)
+        LOG("Cannot solve discrete log subproblem\n");
+    else if (crt((const mpz_t *)x_array, (const mpz_t *)p_array, f_len, x))
+    {
+        LOG("Chinese remainder error\n");
+        ret = 1;
+    }
+    else
+        mpz_mod(x, x, ord_p);
 
     mpz_clear(ord_p);
-    mpz_clear(temp1);
-    mpz_clear(temp2);
-    mpz_clear(new_g);
-    mpz_clear(new_h);
+    mpz_clear(temp);
     mpz_clear(Q);
 
     for (i = 0; i < f_len; ++i)
     {
         mpz_clear(x_array[i]);
         mpz_clear(p_array[i]);
+        mpz_clear(g_array[i]);
+        mpz_clear(h_array[i]);
     }
 
     FREE(x_array);
     FREE(p_array);
+    FREE(g_array);
+    FREE(h_array);
+    FREE(tasks);
+    FREE(status);
 
-    return 0;
-}
\ No newline at end of file
+    return ret;
+}
+
+int pohling_discrete_log_batch(mpz_t g, mpz_t *h, size_t h_len, const mpz_t p, mpz_t *factors, mpz_t *exponents, size_t f_len,
+                               pohling_digits_t mode, mpz_t *x)
+{
+    const unsigned int nproc = (unsigned int)omp_get_max_threads();
+
+    Pohling_subgroup *subs;
+    mpz_t *p_array;
+    mpz_t *cof_array; /* h of target is moved to subgroup i by h^cof_array[i] */
+    mpz_t *x_array; /* x_array[k * f_len + i] = log of target k in subgroup i */
+    int *status;
+
+    mpz_t ord_p;
+    mpz_t temp;
+    mpz_t Q;
+
+    size_t i;
+    size_t k;
+    size_t failed = 0;
+    int levels;
+    double start;
+
+    TRACE();
+
+    if (h_len == 0)
+        ERROR("h_len == 0\n", 1);
+
+    /* group dependent part, the same for every target */
+    mpz_init(ord_p);
+    mpz_sub_ui(ord_p, p, 1);
+
+    start = omp_get_wtime();
+    calculate_ord(g, p, factors, exponents, f_len, ord_p);
+    f_len = delete_zeros(factors, exponents, f_len);
+    (void)gmp_printf("Order g = %Zd\n", ord_p);
+    (void)printf("ORDER TIME = %lf [s]\n", omp_get_wtime() - start);
+
+    subs = (Pohling_subgroup *)malloc(sizeof(Pohling_subgroup) * f_len);
+    if (subs == NULL)
+        ERROR("malloc error\n", 1);
+
+    p_array = (mpz_t *)malloc(sizeof(mpz_t) * f_len);
+    if (p_array == NULL)
+        ERROR("malloc error\n", 1);
+
+    cof_array = (mpz_t *)malloc(sizeof(mpz_t) * f_len);
+    if (cof_array == NULL)
+        ERROR("malloc error\n", 1);
+
+    x_array = (mpz_t *)malloc(sizeof(mpz_t) * f_len * h_len);
+    if (x_array == NULL)
+        ERROR("malloc error\n", 1);
+
+    status = (int *)calloc(f_len * h_len, sizeof(int));
+    if (status == NULL)
+        ERROR("malloc error\n", 1);
+
+    mpz_init(temp);
+
+    /* the same as single target: g = g^Q, h = h^Q */
+    mpz_init(Q);
+    mpz_powm(Q, factors[f_len - 1], exponents[f_len - 1], p);
+    if (mpz_cmp(Q, ord_p))
+    {
+        mpz_powm(g, g, Q, p);
+
+#pragma omp parallel for schedule(static)
+        for (k = 0; k < h_len; ++k)
+            mpz_powm(h[k], h[k], Q, p);
+    }
+
+    start = omp_get_wtime();
+
+    /* every subgroup gets all threads for its precomputation */
+    for (i = 0; i < f_len; ++i)
+    {
+        mpz_init(p_array[i]);
+        mpz_init(cof_array[i]);
+
+        /* new_g = g^(n/f^e), new_h = h^(n/f^e) */
+        mpz_powm(p_array[i], factors[i], exponents[i], p);
+        mpz_div(cof_array[i], ord_p, p_array[i]);
+
+        mpz_powm(temp, g, cof_array[i], p);
+
+        if (pohling_subgroup_create(&subs[i], temp, p, factors[i], exponents[i], nproc, h_len, mode))
+            FATAL("pohling_subgroup_create error\n");
+
+        (void)gmp_printf("\tENGINE = %s, THREADS = %u, f = %Zd\n", pohling_subgroup_engine_name(&subs[i]), subs[i].trivial ? 1 : subs[i].engine.threads, factors[i]);
+    }
+
+    (void)printf("PRECOMPUTATION TIME = %lf [s]\n", omp_get_wtime() - start);
+    start = omp_get_wtime();
+
+    for (i = 0; i < f_len * h_len; ++i)
+        mpz_init(x_array[i]);
+
+    /* engine queries open nested regions */
+    levels = omp_get_max_active_levels();
+    omp_set_max_active_levels(2);
+
+    /* targets are interleaved, so tasks waiting for the same kangaroo context do not block the whole team */
+#pragma omp parallel num_threads(MIN(nproc, (unsigned int)(f_len * h_len))) private(i, k) shared(subs, cof_array, x_array, status, h, p, f_len, h_len)
+{
+#pragma omp single
+    {
+        for (k = 0; k < h_len; ++k)
+            for (i = 0; i < f_len; ++i)
+            {
+#pragma omp task firstprivate(i, k) private(temp)
+                {
+                    mpz_init(temp);
+                    mpz_powm(temp, h[k], cof_array[i], p);
+                    status[k * f_len + i] = pohling_subgroup_discrete_log(&subs[i], temp, p, x_array[k * f_len + i]);
+                    mpz_clear(temp);
+                }
+            }
+    }
+}
+
+    omp_set_max_active_levels(levels);
+
+    /* every target has its own crt */
+#pragma omp parallel for private(i) reduction(+:failed) schedule(dynamic)
+    for (k = 0; k < h_len; ++k)
+    {
+        for (i = 0; i < f_len; ++i)
+            if (status[k * f_len + i])
+                break;
+
+        if (i < f_len || crt((const mpz_t *)&x_array[k * f_len], (const mpz_t *)p_array, f_len, x[k]))
+        {
+            mpz_set_ui(x[k], 0);
+            ++failed;
+        }
+        else
+            mpz_mod(x[k], x[k], ord_p);
+    }
+
+    (void)printf("TARGETS = %zu, FAILED = %zu, TIME = %lf [s]\n", h_len, failed, omp_get_wtime() - start);
+
+    for (i = 0; i < f_len; ++i)
+    {
+        pohling_subgroup_destroy(&subs[i]);
+        mpz_clear(p_array[i]);
+        mpz_clear(cof_array[i]);
+    }
+
+    for (i = 0; i < f_len * h_len; ++i)
+        mpz_clear(x_array[i]);
+
+    mpz_clear(ord_p);
+    mpz_clear(temp);
+    mpz_clear(Q);
+
+    FREE(subs);
+    FREE(p_array);
+    FREE(cof_array);
+    FREE(x_array);
+    FREE(status);
+
+    return failed > 0;
+}
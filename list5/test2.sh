@@ -46,4 +46,7 @@ $exec 4 2095940171833260 2152378464945887 2 1 1076189232472943 1
 $exec 4 1138260250360234 2152378464945887 2 1 1076189232472943 1
 $exec 4 1402828578892662 2152378464945887 2 1 1076189232472943 1
 $exec 4 667463534490455 2152378464945887 2 1 1076189232472943 1
-$exec 4 1676878410444462 2152378464945887 2 1 1076189232472943 1
\ No newline at end of file
+$exec 4 1676878410444462 2152378464945887 2 1 1076189232472943 1
+# the same group, many targets at once
+echo "772817142264131 2095940171833260 1138260250360234 1402828578892662 667463534490455 1676878410444462" | \
+$exec batch 4 2152378464945887 2 1 1076189232472943 1
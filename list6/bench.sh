@@ -0,0 +1,54 @@
+#!/bin/bash
+
+#Author: Michal Kukowski
+#email: michalkukowski10@gmail.com
+
+# This script compares curve models in stage 1:
+# curves per second on n without small factors (every curve does full work),
+# batch is affine Weierstrass in lockstep against single affine Weierstrass curve
+# and factors found per CPU hour on fixed set of semiprimes (12 digits * 25 digits),
+# then factors per CPU hour with stage 2 (B2 = 100 * B1) against stage 1 with larger B1 of similar cost
+# Usage: ./bench.sh [B1] [curves]
+
+exec=./ecm.out
+B1=${1:-100000}
+curves=${2:-8}
+
+n=137653180821196932877450529700947467757968058407350343312867
+
+semiprimes=(
+    908842788177970318927491680584730431
+    4591957426934751627564508304502412837
+    1735342152378441744496146082325892721
+    1106444605375092255444666375038808491
+)
+
+echo "Curves per second, B1 = $B1"
+for curve in weierstrass batch montgomery edwards; do
+    $exec bench $curve $B1 $curves $n
+done
+
+# factors_per_hour curve B1 B2
+factors_per_hour()
+{
+    found=0
+    cpu=0
+    for semiprime in ${semiprimes[@]}; do
+        out=$(OMP_NUM_THREADS=1 $exec bench $1 $2 $((curves * 25)) $semiprime $3 | grep "^CURVE")
+        found=$((found + $(echo "$out" | sed 's/.*FOUND = \([0-9]*\).*/\1/')))
+        cpu=$(echo "$cpu + $(echo "$out" | sed 's/.*TIME = \([0-9.]*\).*/\1/')" | bc -l)
+    done
+
+    echo "CURVE = $1, B1 = $2, B2 = $3, FOUND = $found, TIME = $cpu [s], FACTORS / CPU h = $(echo "$found * 3600 / $cpu" | bc -l)"
+}
+
+echo "Factors per CPU hour, B1 = 2000, single thread"
+for curve in weierstrass batch montgomery edwards; do
+    factors_per_hour $curve 2000 0
+done
+
+echo "Factors per CPU hour, stage 2, single thread"
+for curve in montgomery edwards; do
+    factors_per_hour $curve 4000 0
+    factors_per_hour $curve 2000 200000
+done
@@ -0,0 +1,85 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+/*
+    Stage 1 of Lenstra ECM on many affine Weierstrass curves y^2 = x^3 + ax + b in lockstep
+
+    Every curve runs the same NAF of stage 1 scalar from plan, so in every step all curves
+    double (or add the same odd multiple) together. Affine step needs inversion of denominator
+    2y or x2 - x1; Montgomery trick inverts all denominators of one step by single inversion
+    and 3 multiplications per curve. If inversion fails, denominators are checked one by one,
+    curve with gcd(den, n) in (1, n) gives factor, curve with den = 0 mod n is dropped.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+
+    LICENCE: GPL 3.0
+*/
+
+#include <gmp.h>
+#include <ecm_plan.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* curves advanced together by one call */
+#define ECM_BATCH_CURVES 32
+
+/* curves with their points and temporaries, workspace of one thread */
+typedef struct Abatch Abatch;
+
+/*
+    Create workspace for given number of curves mod n, all numbers are allocated here
+    and reused by every call, so batch_ecm allocates only when plan needs wider NAF (see abatch_reserve)
+
+    PARAMS
+    @IN n - modular
+    @IN curves - number of curves
+
+    RETURN
+    NULL iff failure
+    Pointer to new workspace iff success
+*/
+Abatch *abatch_create(const mpz_t n, size_t curves);
+
+/*
+    Destroy workspace
+
+    PARAMS
+    @IN batch - pointer to workspace
+
+    RETURN
+    This is a void function
+*/
+void abatch_destroy(Abatch *batch);
+
+/*
+    Make room for odd multiples of plan, only plan with NAF wider than all plans before allocates
+
+    PARAMS
+    @IN batch - workspace
+    @IN plan - plan
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int abatch_reserve(Abatch *batch, const Ecm_plan *plan);
+
+/*
+    Lenstra factorization method on all curves of workspace in lockstep
+
+    PARAMS
+    @IN batch - workspace with number to factor
+    @IN plan - bounds, only stage 1 is used
+    @IN seed - seed of curve coefficients, the same seed gives the same curves
+    @IN cancel - flag set by other thread when curves should stop
+    @OUT factor - first n factor
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int batch_ecm(Abatch *batch, const Ecm_plan *plan, uint64_t seed, const bool *cancel, mpz_t factor);
+
+#endif
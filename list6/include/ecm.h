@@ -4,6 +4,13 @@
 /*
     Implementation of Lenstra eliptic curve factorization
 
+    Curves can be affine Weierstrass (inversion in every addition),
+    Montgomery in X:Z coordinates or twisted Edwards with torsion Z/12 in extended coordinates
+    (no inversions in stage 1). Montgomery and Edwards curves continue with stage 2 up to B2,
+    Weierstrass curves run only stage 1, alone or many in lockstep with one inversion per step.
+    Every curve is given by one parameter sigma (Suyama sigma, Edwards family parameter
+    or seed of Weierstrass coefficients), so curve which found factor can be run again
+
     Author: Michal Kukowski
     email: michalkukowski10@gmail.com
 
@@ -11,22 +18,116 @@
 */
 
 #include <gmp.h>
-#include <darray.h>
+#include <ecm_plan.h>
+#include <stddef.h>
+#include <stdbool.h>
 #include <stdint.h>
 
+/* curve parameters are in [ECM_SIGMA_MIN, ECM_SIGMA_MIN + ECM_SIGMA_RANGE) */
+#define ECM_SIGMA_MIN 6
+#define ECM_SIGMA_RANGE (1ull << 31)
+
+typedef enum ECM_CURVE
+{
+    ECM_CURVE_WEIERSTRASS,  /* y^2 = x^3 + ax + b, affine */
+    ECM_CURVE_MONTGOMERY,   /* By^2 = x^3 + Ax^2 + x, X:Z ladder */
+    ECM_CURVE_EDWARDS,      /* ax^2 + y^2 = 1 + dx^2y^2, X:Y:Z:T, torsion Z/12 */
+    ECM_CURVE_BATCH         /* ECM_BATCH_CURVES affine Weierstrass curves, batch inversion */
+} ecm_curve_t;
+
+/* curves of one model mod n with all their numbers, workspace of one thread */
+typedef struct Ecm_workspace Ecm_workspace;
+
 /*
-    Lenstra factorization method
+    Create workspace for curves of given model mod n. Every point, curve and temporary
+    is allocated here with room for products mod n and reused by every call of lenstra_ecm,
+    which allocates only when plan needs more precomputed points than any plan before
 
     PARAMS
     @IN n - number to factor
-    @IN primes - list of primes < limit
-    @IN limit - max iteration
+    @IN curve - curve model
+
+    RETURN
+    NULL iff failure
+    Pointer to new workspace iff success
+*/
+Ecm_workspace *ecm_workspace_create(const mpz_t n, ecm_curve_t curve);
+
+/*
+    Destroy workspace
+
+    PARAMS
+    @IN ws - pointer to workspace
+
+    RETURN
+    This is a void function
+*/
+void ecm_workspace_destroy(Ecm_workspace *ws);
+
+/*
+    Make room for precomputed points of plan, after reserve for every used plan
+    lenstra_ecm does not allocate at all
+
+    PARAMS
+    @IN ws - workspace
+    @IN plan - plan
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int ecm_workspace_reserve(Ecm_workspace *ws, const Ecm_plan *plan);
+
+/*
+    Get number of curves tried by one call of lenstra_ecm
+
+    PARAMS
+    @IN curve - curve model
+
+    RETURN
+    Number of curves per call
+*/
+size_t lenstra_ecm_curves(ecm_curve_t curve);
+
+/*
+    Check if curve model runs stage 2, other models use only B1 of plan
+
+    PARAMS
+    @IN curve - curve model
+
+    RETURN
+    true iff model runs stage 2 up to B2 of plan
+*/
+bool lenstra_ecm_stage2(ecm_curve_t curve);
+
+/*
+    Get parameter of curve with given index in stream of given seed.
+    Parameter depends only on seed and index, so threads need no shared generator
+    and the same seed gives the same curves for any number of threads
+
+    PARAMS
+    @IN seed - seed of stream
+    @IN index - index of curve (call of lenstra_ecm)
+
+    RETURN
+    Curve parameter sigma
+*/
+uint64_t lenstra_ecm_sigma(uint64_t seed, uint64_t index);
+
+/*
+    Lenstra factorization method
+
+    PARAMS
+    @IN ws - workspace of calling thread with number to factor and curve model
+    @IN plan - bounds B1, B2 and stage 2 giant steps (ecm_plan_create)
+    @IN sigma - curve parameter (lenstra_ecm_sigma)
+    @IN cancel - flag set by other thread when curve should stop, read atomically
     @OUT factor - first n factor
 
     RETURN
     0 iff success
     Non-zero value iff failure
 */
-int lenstra_ecm(const mpz_t n, Darray *primes, uint32_t limit, mpz_t factor);
+int lenstra_ecm(Ecm_workspace *ws, const Ecm_plan *plan, uint64_t sigma, const bool *cancel, mpz_t factor);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,173 @@
+#ifndef ECM_PLAN_H
+#define ECM_PLAN_H
+
+/*
+    Precomputation for ECM bounds B1, B2 shared by all curves and threads
+
+    Stage 1 multiplies point by scalar s = product of max prime powers < B1.
+    Montgomery curves use PRAC chain of every prime factor of s (x-only differential chains),
+    for every prime the best of several PRAC parameters is chosen once, here.
+    Edwards curves use width w NAF of s, so they need only about bits(s) / (w + 1) additions.
+
+    Stage 2 looks for single prime q in (B1, B2] with qQ = 0. Every q is written as mD +- j
+    (odd j <= D / 2), so qQ = 0 iff mDQ = +-jQ, which is equality of x (Montgomery) or y (Edwards)
+    of giant step mDQ and baby step jQ. Both mD - j and mD + j are checked by one difference,
+    so every giant step m needs list of different j. Lists are not kept in plan, every thread
+    streams them from its own segmented sieve of (B1, B2] (Ecm_pairs), so memory does not depend on B2.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+
+    LICENCE: GPL 3.0
+*/
+
+#include <gmp.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+    Operation of PRAC chain, state is A, B, C = A - B and (d, e) such that result is dA + eB.
+    Assignments in one operation are simultaneous (right sides use old points), x-only so -P = P.
+    Chain of prime p >= 3 is PRAC_START, rules, PRAC_END, chain of 2 is PRAC_DBL
+*/
+typedef enum PRAC_OP
+{
+    PRAC_DBL,       /* A = 2A */
+    PRAC_START,     /* (A, B, C) = (2A, A, A) */
+    PRAC_RULE_1,    /* (A, B) = (2A + B, A + 2B) */
+    PRAC_RULE_2,    /* (A, B) = (2A, A + B) */
+    PRAC_RULE_3,    /* (B, C) = (A + B, B) */
+    PRAC_RULE_4,    /* (A, B) = (2A, A + B) */
+    PRAC_RULE_5,    /* (A, C) = (2A, 2A - B) */
+    PRAC_RULE_6,    /* (A, B, C) = (3A, 3A + B, B) */
+    PRAC_RULE_7,    /* (A, B) = (3A, 2A + B) */
+    PRAC_RULE_8,    /* (A, B, C) = (3A, A + B, 2A - B) */
+    PRAC_RULE_9,    /* (B, C) = (2B, C - B) */
+    PRAC_END        /* A = A + B */
+} prac_op_t;
+
+/* flag of operation: swap A and B before it */
+#define PRAC_SWAP 0x80
+
+typedef struct Ecm_plan
+{
+    uint32_t b1;
+    uint64_t b2; /* 0 means without stage 2 */
+
+    /* stage 1 */
+    mpz_t scalar;           /* product of max prime powers < B1 */
+    uint8_t *chain;         /* PRAC operations (prac_op_t | PRAC_SWAP) of all prime powers */
+    size_t chain_len;
+    int8_t *naf;            /* width naf_width NAF of scalar, most significant digit first */
+    size_t naf_len;
+    unsigned int naf_width;
+
+    /* stage 2: giant steps m in [m_first, m_last], baby steps jQ for odd j <= d / 2 */
+    unsigned long d;
+    unsigned long m_first;
+    unsigned long m_last;
+} Ecm_plan;
+
+/* stream of different j of every giant step, stage 2 workspace of one thread */
+typedef struct Ecm_pairs Ecm_pairs;
+
+/*
+    Create plan for bounds B1, B2, primes are streamed from segmented sieve, so only plan itself is kept in memory
+
+    PARAMS
+    @IN b1 - stage 1 bound, at least 3 with stage 2
+    @IN b2 - stage 2 bound, b2 <= b1 means without stage 2
+
+    RETURN
+    NULL iff failure
+    Pointer to new plan iff success
+*/
+Ecm_plan *ecm_plan_create(uint32_t b1, uint64_t b2);
+
+/*
+    Destroy plan
+
+    PARAMS
+    @IN plan - pointer to plan
+
+    RETURN
+    This is a void function
+*/
+void ecm_plan_destroy(Ecm_plan *plan);
+
+/*
+    Get number of baby steps jQ (all odd j <= d / 2)
+
+    PARAMS
+    @IN plan - plan with stage 2
+
+    RETURN
+    Number of baby steps
+*/
+size_t ecm_plan_baby_steps(const Ecm_plan *plan);
+
+/*
+    Create stream of stage 2 pairs
+
+    PARAMS
+    NO PARAMS
+
+    RETURN
+    NULL iff failure
+    Pointer to new stream iff success
+*/
+Ecm_pairs *ecm_pairs_create(void);
+
+/*
+    Destroy stream of stage 2 pairs
+
+    PARAMS
+    @IN pairs - pointer to stream
+
+    RETURN
+    This is a void function
+*/
+void ecm_pairs_destroy(Ecm_pairs *pairs);
+
+/*
+    Make room for pairs and sieve of plan without sieving,
+    only plan with B2 or D greater than all plans before allocates
+
+    PARAMS
+    @IN pairs - stream
+    @IN plan - plan with stage 2
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int ecm_pairs_reserve(Ecm_pairs *pairs, const Ecm_plan *plan);
+
+/*
+    Restart stream at first giant step of plan and sieve first segment of stage 2,
+    after ecm_pairs_reserve for this plan does not allocate
+
+    PARAMS
+    @IN pairs - stream
+    @IN plan - plan with stage 2
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int ecm_pairs_reset(Ecm_pairs *pairs, const Ecm_plan *plan);
+
+/*
+    Get different j of giant step m, giant steps must be read in ascending order
+
+    PARAMS
+    @IN pairs - stream
+    @IN m - giant step
+    @OUT len - number of j
+
+    RETURN
+    Pointer to odd j <= D / 2 such that mD - j or mD + j is prime in (B1, B2], valid until next call
+*/
+const uint32_t *ecm_pairs_next(Ecm_pairs *pairs, unsigned long m, size_t *len);
+
+#endif
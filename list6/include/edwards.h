@@ -0,0 +1,85 @@
+#ifndef EDWARDS_H
+#define EDWARDS_H
+
+/*
+    Lenstra ECM on twisted Edwards curves ax^2 + y^2 = 1 + dx^2y^2
+
+    Points are kept in extended coordinates X:Y:Z:T (x = X / Z, y = Y / Z, xy = T / Z),
+    so stage 1 has no inversions and factor is gcd(X, n) at the end.
+    Stage 1 multiplies by width w NAF of scalar precomputed in plan.
+    Curves come from Montgomery family with torsion Z/12: for (u, v) = k * (-2, 4) on v^2 = u^3 - 12u
+    t = v / 2u, s = (t^2 - 1) / (t^2 + 3), A = (-3s^4 - 6s^2 + 1) / 4s^3, x0 = (3s^2 + 1) / 4s,
+    so order of curve mod every prime is multiple of 12. Family has no member with a = -1
+    over Q, so a = (A + 2)B, d = (A - 2)B, where B = x0^3 + Ax0^2 + x0.
+    Stage 2 compares y of giant steps mDQ and baby steps jQ (see ecm_plan.h), -(x, y) = (-x, y),
+    so every difference Ym * Zj - Yj * Zm checks both mD - j and mD + j.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+
+    LICENCE: GPL 3.0
+*/
+
+#include <gmp.h>
+#include <ecm_plan.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* curve with its points and temporaries, workspace of one thread */
+typedef struct Edcurve Edcurve;
+
+/*
+    Create workspace for curves mod n, all numbers are allocated here and reused by every curve,
+    so edwards_ecm allocates only when plan needs wider NAF, more baby steps or larger stage 2 sieve (see edcurve_reserve)
+
+    PARAMS
+    @IN n - modular
+
+    RETURN
+    NULL iff failure
+    Pointer to new workspace iff success
+*/
+Edcurve *edcurve_create(const mpz_t n);
+
+/*
+    Destroy workspace
+
+    PARAMS
+    @IN curve - pointer to workspace
+
+    RETURN
+    This is a void function
+*/
+void edcurve_destroy(Edcurve *curve);
+
+/*
+    Make room for odd multiples, baby steps and stage 2 sieve of plan,
+    only plan larger than all plans before allocates
+
+    PARAMS
+    @IN curve - workspace
+    @IN plan - plan
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int edcurve_reserve(Edcurve *curve, const Ecm_plan *plan);
+
+/*
+    Lenstra factorization method on one Edwards curve with torsion Z/12
+
+    PARAMS
+    @IN curve - workspace with number to factor
+    @IN plan - bounds B1, B2 and stage 2 giant steps
+    @IN k - family parameter of curve, k >= 2
+    @IN cancel - flag set by other thread when curve should stop
+    @OUT factor - first n factor
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int edwards_ecm(Edcurve *curve, const Ecm_plan *plan, uint64_t k, const bool *cancel, mpz_t factor);
+
+#endif
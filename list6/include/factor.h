@@ -0,0 +1,124 @@
+#ifndef FACTOR_H
+#define FACTOR_H
+
+/*
+    Full factorization of n into proven primes
+
+    Stages:
+    1. trial division by primes < FACTOR_TRIAL_BOUND streamed from segmented sieve
+    2. work queue of composite cofactors, every round takes all queued cofactors in parallel:
+       perfect powers are split by roots, probable primes become leaves,
+       others get Pollard rho (Brent variant) with limited number of steps
+    3. cofactors which survived rho get ECM with B1 rising with tried curves, all threads run curves of one cofactor.
+       Cofactor without factor after budget of curves is reported as composite
+    Both parts of every split go back to queue, so found factor is factored too.
+    4. primality proof of every leaf in parallel: n < 2^64 by BPSW (no BPSW pseudoprime below 2^64),
+       bigger n by Pocklington: a^(n - 1) = 1 and gcd(a^((n - 1) / q) - 1, n) = 1 for every prime q | F,
+       where F | n - 1, F > sqrt(n) is factored part of n - 1 with recursively proven primes.
+       If trial division and rho do not find such F, leaf is reported as probable prime.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+
+    LICENCE: GPL 3.0
+*/
+
+#include <gmp.h>
+#include <ecm.h>
+#include <ecm_plan.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* methods of factorization, time and factors found by each one are reported */
+typedef enum FACTOR_METHOD
+{
+    FACTOR_METHOD_TRIAL,
+    FACTOR_METHOD_RHO,
+    FACTOR_METHOD_ECM,
+    FACTOR_METHOD_PROOF,    /* primality tests and proofs */
+    FACTOR_METHODS
+} factor_method_t;
+
+typedef enum PRIME_PROOF
+{
+    PRIME_PROOF_TRIAL,          /* prime of sieve or cofactor without prime factor <= sqrt */
+    PRIME_PROOF_BPSW,           /* n < 2^64 */
+    PRIME_PROOF_POCKLINGTON,
+    PRIME_PROOF_PROBABLE,       /* only BPSW and Miller - Rabin */
+    PRIME_PROOF_COMPOSITE       /* not a prime, ECM has not split cofactor within budget */
+} prime_proof_t;
+
+typedef struct Factor
+{
+    mpz_t prime;
+    unsigned long exponent;
+    prime_proof_t proof;
+} Factor;
+
+typedef struct Factorization
+{
+    Factor *factors;                        /* ascending primes */
+    size_t len;
+    double time[FACTOR_METHODS];            /* seconds summed over threads */
+    unsigned long found[FACTOR_METHODS];    /* splits, proven leaves for FACTOR_METHOD_PROOF */
+} Factorization;
+
+/* ECM settings, plan i is used until curves[i] curves were tried, the last plan without limit */
+typedef struct Factor_ecm
+{
+    Ecm_plan *const *plans;         /* B1 ascending */
+    const unsigned long *curves;    /* plans_len - 1 ascending limits */
+    size_t plans_len;
+    ecm_curve_t curve;
+    const char *name;               /* name of curve model printed with curve which found factor */
+    uint64_t seed;                  /* seed of curve parameters, see lenstra_ecm_sigma */
+    unsigned long budget;           /* curves per cofactor, 0 means no limit */
+} Factor_ecm;
+
+/*
+    Factorize n > 1 into primes
+
+    PARAMS
+    @IN n - number to factorize
+    @IN ecm - ECM settings
+
+    RETURN
+    NULL iff failure
+    Pointer to new factorization iff success
+*/
+Factorization *factorize(const mpz_t n, const Factor_ecm *ecm);
+
+/*
+    Destroy factorization
+
+    PARAMS
+    @IN f - pointer to factorization
+
+    RETURN
+    This is a void function
+*/
+void factorization_destroy(Factorization *f);
+
+/*
+    Get name of proof
+
+    PARAMS
+    @IN proof - proof
+
+    RETURN
+    Name of proof
+*/
+const char *prime_proof_name(prime_proof_t proof);
+
+/*
+    Get name of method
+
+    PARAMS
+    @IN method - method
+
+    RETURN
+    Name of method
+*/
+const char *factor_method_name(factor_method_t method);
+
+#endif
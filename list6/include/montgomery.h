@@ -0,0 +1,82 @@
+#ifndef MONTGOMERY_H
+#define MONTGOMERY_H
+
+/*
+    Lenstra ECM on Montgomery curves By^2 = x^3 + Ax^2 + x
+
+    Points are kept in projective X:Z coordinates without y, stage 1 multiplies by PRAC chains
+    precomputed in plan (Montgomery ladder for single multiples), so it has no inversions. Z of final point is multiple
+    of every prime p | n for which order of curve mod p is B1 smooth, so factor is given by single gcd.
+    Curves come from Suyama parametrization with given sigma, which gives torsion of order 6.
+    Stage 2 compares x of giant steps mDQ and baby steps jQ (see ecm_plan.h), x = X / Z is the same for +-P,
+    so every difference Xm * Zj - Xj * Zm checks both mD - j and mD + j.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+
+    LICENCE: GPL 3.0
+*/
+
+#include <gmp.h>
+#include <ecm_plan.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* curve with its points and temporaries, workspace of one thread */
+typedef struct Mcurve Mcurve;
+
+/*
+    Create workspace for curves mod n, all numbers are allocated here
+    and reused by every curve, so montgomery_ecm allocates only when plan needs more baby steps or larger stage 2 sieve (see mcurve_reserve)
+
+    PARAMS
+    @IN n - modular
+
+    RETURN
+    NULL iff failure
+    Pointer to new workspace iff success
+*/
+Mcurve *mcurve_create(const mpz_t n);
+
+/*
+    Destroy workspace
+
+    PARAMS
+    @IN curve - pointer to workspace
+
+    RETURN
+    This is a void function
+*/
+void mcurve_destroy(Mcurve *curve);
+
+/*
+    Make room for baby steps and stage 2 sieve of plan,
+    only plan larger than all plans before allocates
+
+    PARAMS
+    @IN curve - workspace
+    @IN plan - plan
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int mcurve_reserve(Mcurve *curve, const Ecm_plan *plan);
+
+/*
+    Lenstra factorization method on one Montgomery curve
+
+    PARAMS
+    @IN curve - workspace with number to factor
+    @IN plan - bounds B1, B2 and stage 2 giant steps
+    @IN sigma - Suyama parameter of curve, sigma >= 6
+    @IN cancel - flag set by other thread when curve should stop
+    @OUT factor - first n factor
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int montgomery_ecm(Mcurve *curve, const Ecm_plan *plan, uint64_t sigma, const bool *cancel, mpz_t factor);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef SIEVE_H
+#define SIEVE_H
+
+/*
+    Segmented sieve of Eratosthenes with streaming iterator over primes in [lo, hi)
+
+    Only odd numbers are kept, one bit per number, so segment of SIEVE_SEGMENT_BITS bits
+    covers 2 * SIEVE_SEGMENT_BITS numbers and fits L1 cache. Segments are grouped in blocks,
+    every thread sieves its own block by primes <= sqrt(hi), so batch of blocks is sieved in parallel,
+    then iterator reads primes from batch and sieves next batch when batch is empty.
+    Memory is O(sqrt(hi) + threads * block) independent of hi - lo.
+
+    Author: Michal Kukowski
+    email: michalkukowski10@gmail.com
+
+    LICENCE: GPL 3.0
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* odd numbers in one segment, 32KB */
+#define SIEVE_SEGMENT_BITS (1ul << 18)
+
+/* segments of one block, block is sieved by one thread */
+#define SIEVE_BLOCK_SEGMENTS 8
+
+typedef struct Sieve Sieve;
+
+/*
+    Create iterator over primes in [lo, hi)
+
+    PARAMS
+    @IN lo - lower bound (inclusive)
+    @IN hi - upper bound (exclusive)
+    @IN threads - number of blocks sieved in parallel, 0 means omp_get_max_threads()
+
+    RETURN
+    NULL iff failure
+    Pointer to new iterator iff success
+*/
+Sieve *sieve_create(uint64_t lo, uint64_t hi, unsigned int threads);
+
+/*
+    Destroy iterator
+
+    PARAMS
+    @IN sieve - pointer to iterator
+
+    RETURN
+    This is a void function
+*/
+void sieve_destroy(Sieve *sieve);
+
+/*
+    Restart iterator with new range, buffers are reused,
+    so range not wider than all ranges before does not allocate
+
+    PARAMS
+    @IN sieve - iterator
+    @IN lo - lower bound (inclusive)
+    @IN hi - upper bound (exclusive)
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+int sieve_reset(Sieve *sieve, uint64_t lo, uint64_t hi);
+
+/*
+    Get next prime
+
+    PARAMS
+    @IN sieve - iterator
+
+    RETURN
+    0 iff there is no more primes in range
+    Next prime iff success
+*/
+uint64_t sieve_next(Sieve *sieve);
+
+#endif
@@ -0,0 +1,569 @@
+#include <batch.h>
+#include <gmp.h>
+#include <log.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <common.h>
+
+/* batch checks cancellation every BATCH_CANCEL_STEPS NAF digits, must be power of 2 */
+#define BATCH_CANCEL_STEPS (1ul << 5)
+
+/* affine point, inf means point at infinity */
+typedef struct Apoint
+{
+    mpz_t x;
+    mpz_t y;
+    bool inf;
+} Apoint;
+
+/* what one curve does in current step */
+typedef enum BATCH_STEP
+{
+    BATCH_STEP_NONE,    /* result is known without inversion or curve is dead */
+    BATCH_STEP_DBL,
+    BATCH_STEP_ADD
+} batch_step_t;
+
+/* curves y^2 = x^3 + a_i x + b_i in Zn advanced in lockstep, allocated once and reused by every call */
+struct Abatch
+{
+    mpz_t n;
+    mp_bitcnt_t bits;       /* size of every number, product of two residues fits without realloc */
+    size_t curves;
+    size_t entries;         /* odd multiples per curve, grow to the largest plan */
+
+    mpz_t *a;               /* b is not needed by arithmetic */
+    bool *dead;             /* den = 0 mod n, curve is dropped */
+    Apoint *r;              /* accumulator of every curve */
+    Apoint *table;          /* table[k * curves + i] = (2k + 1)P_i */
+
+    /* state of current step */
+    batch_step_t *step;
+    mpz_t *num;
+    mpz_t *den;             /* denominators, after inversion their inverses */
+    mpz_t *prefix;          /* prefix products of denominators */
+    mpz_t t[3];
+    gmp_randstate_t state;
+};
+
+/*
+    Init affine point as point at infinity
+
+    PARAMS
+    @IN p - point
+    @IN bits - size of coordinates
+
+    RETURN
+    This is a void function
+*/
+static void apoint_init(Apoint *p, mp_bitcnt_t bits);
+
+/*
+    Clear affine point
+
+    PARAMS
+    @IN p - point
+
+    RETURN
+    This is a void function
+*/
+static void apoint_clear(Apoint *p);
+
+/*
+    Copy affine point: r = p
+
+    PARAMS
+    @OUT r - result
+    @IN p - point
+
+    RETURN
+    This is a void function
+*/
+static void apoint_set(Apoint *r, const Apoint *p);
+
+/*
+    Set pseudorandom curves, table[0 .. curves) are starting points.
+    Curves depend only on n and seed
+
+    PARAMS
+    @IN batch - batch
+    @IN seed - seed of curve coefficients
+
+    RETURN
+    This is a void function
+*/
+static void abatch_set(Abatch *batch, uint64_t seed);
+
+/*
+    Invert all denominators of current step by Montgomery trick:
+    prefix[i] = den[0] * ... * den[i], one inversion of prefix[curves - 1], then
+    1 / den[i] = prefix[i - 1] / prefix[i] going down
+
+    PARAMS
+    @IN batch - batch
+    @OUT factor - factor exposed by denominator of some curve
+
+    RETURN
+    0 iff all denominators are inverted
+    Non-zero value iff factor is found
+*/
+static int abatch_invert(Abatch *batch, mpz_t factor);
+
+/*
+    Finish step: lambda = num / den, x3 = lambda^2 - x1 - x2, y3 = lambda(x1 - x3) - y1
+
+    PARAMS
+    @IN batch - batch
+    @OUT res - results
+    @IN p - first points
+    @IN q - second points (NULL for doubling)
+
+    RETURN
+    This is a void function
+*/
+static void abatch_finish(Abatch *batch, Apoint *res, const Apoint *p, const Apoint *q);
+
+/*
+    Doubling of every curve: res_i = 2p_i, res can be p
+
+    PARAMS
+    @IN batch - batch
+    @OUT res - results
+    @IN p - points
+    @OUT factor - factor if found
+
+    RETURN
+    0 iff step is done
+    Non-zero value iff factor is found
+*/
+static int abatch_dbl(Abatch *batch, Apoint *res, const Apoint *p, mpz_t factor);
+
+/*
+    Addition on every curve: res_i = p_i + q_i (or p_i - q_i), res can be p
+
+    PARAMS
+    @IN batch - batch
+    @OUT res - results
+    @IN p - first points
+    @IN q - second points
+    @IN negate - add -q_i instead of q_i
+    @OUT factor - factor if found
+
+    RETURN
+    0 iff step is done
+    Non-zero value iff factor is found
+*/
+static int abatch_add(Abatch *batch, Apoint *res, const Apoint *p, const Apoint *q, bool negate, mpz_t factor);
+
+static void apoint_init(Apoint *p, mp_bitcnt_t bits)
+{
+    mpz_init2(p->x, bits);
+    mpz_init2(p->y, bits);
+    p->inf = true;
+}
+
+static void apoint_clear(Apoint *p)
+{
+    mpz_clear(p->x);
+    mpz_clear(p->y);
+}
+
+static void apoint_set(Apoint *r, const Apoint *p)
+{
+    if (r == p)
+        return;
+
+    mpz_set(r->x, p->x);
+    mpz_set(r->y, p->y);
+    r->inf = p->inf;
+}
+
+static void abatch_set(Abatch *batch, uint64_t seed)
+{
+    size_t i;
+
+    TRACE();
+
+    gmp_randseed_ui(batch->state, (unsigned long)seed);
+
+    /* random point (x, y) and random a, b = y^2 - x^3 - ax is never needed */
+    for (i = 0; i < batch->curves; ++i)
+    {
+        mpz_urandomm(batch->table[i].x, batch->state, batch->n);
+        mpz_urandomm(batch->table[i].y, batch->state, batch->n);
+        mpz_urandomm(batch->a[i], batch->state, batch->n);
+        batch->table[i].inf = false;
+        batch->dead[i] = false;
+    }
+}
+
+int abatch_reserve(Abatch *batch, const Ecm_plan *plan)
+{
+    Apoint *table;
+
+    const size_t entries = (size_t)1 << (plan->naf_width - 2);
+    size_t i;
+
+    TRACE();
+
+    if (entries <= batch->entries)
+        return 0;
+
+    /* table[k * curves + i], so new multiples go after old ones */
+    table = (Apoint *)realloc(batch->table, sizeof(Apoint) * batch->curves * entries);
+    if (table == NULL)
+        ERROR("realloc error\n", 1);
+
+    for (i = batch->curves * batch->entries; i < batch->curves * entries; ++i)
+        apoint_init(&table[i], batch->bits);
+
+    batch->table = table;
+    batch->entries = entries;
+
+    return 0;
+}
+
+Abatch *abatch_create(const mpz_t n, size_t curves)
+{
+    Abatch *batch;
+    size_t i;
+
+    TRACE();
+
+    if (curves == 0)
+        ERROR("curves == 0\n", NULL);
+
+    batch = (Abatch *)malloc(sizeof(Abatch));
+    if (batch == NULL)
+        ERROR("malloc error\n", NULL);
+
+    batch->curves = curves;
+    batch->entries = 0;
+    batch->table = NULL;
+    batch->bits = 2 * mpz_sizeinbase(n, 2) + 2 * GMP_NUMB_BITS;
+
+    batch->a = (mpz_t *)malloc(sizeof(mpz_t) * curves);
+    batch->dead = (bool *)calloc(curves, sizeof(bool));
+    batch->r = (Apoint *)malloc(sizeof(Apoint) * curves);
+    batch->step = (batch_step_t *)malloc(sizeof(batch_step_t) * curves);
+    batch->num = (mpz_t *)malloc(sizeof(mpz_t) * curves);
+    batch->den = (mpz_t *)malloc(sizeof(mpz_t) * curves);
+    batch->prefix = (mpz_t *)malloc(sizeof(mpz_t) * curves);
+
+    if (batch->a == NULL || batch->dead == NULL || batch->r == NULL ||
+        batch->step == NULL || batch->num == NULL || batch->den == NULL || batch->prefix == NULL)
+    {
+        FREE(batch->a);
+        FREE(batch->dead);
+        FREE(batch->r);
+        FREE(batch->step);
+        FREE(batch->num);
+        FREE(batch->den);
+        FREE(batch->prefix);
+        FREE(batch);
+
+        ERROR("malloc error\n", NULL);
+    }
+
+    mpz_init_set(batch->n, n);
+    for (i = 0; i < ARRAY_SIZE(batch->t); ++i)
+        mpz_init2(batch->t[i], batch->bits);
+
+    for (i = 0; i < curves; ++i)
+    {
+        mpz_init2(batch->a[i], batch->bits);
+        apoint_init(&batch->r[i], batch->bits);
+        mpz_init2(batch->num[i], batch->bits);
+        mpz_init2(batch->den[i], batch->bits);
+        mpz_init2(batch->prefix[i], batch->bits);
+    }
+
+    gmp_randinit_default(batch->state);
+
+    return batch;
+}
+
+void abatch_destroy(Abatch *batch)
+{
+    size_t i;
+
+    TRACE();
+
+    if (batch == NULL)
+        return;
+
+    for (i = 0; i < batch->curves; ++i)
+    {
+        mpz_clear(batch->a[i]);
+        apoint_clear(&batch->r[i]);
+        mpz_clear(batch->num[i]);
+        mpz_clear(batch->den[i]);
+        mpz_clear(batch->prefix[i]);
+    }
+
+    for (i = 0; i < batch->curves * batch->entries; ++i)
+        apoint_clear(&batch->table[i]);
+
+    for (i = 0; i < ARRAY_SIZE(batch->t); ++i)
+        mpz_clear(batch->t[i]);
+
+    mpz_clear(batch->n);
+    gmp_randclear(batch->state);
+
+    FREE(batch->a);
+    FREE(batch->dead);
+    FREE(batch->r);
+    FREE(batch->table);
+    FREE(batch->step);
+    FREE(batch->num);
+    FREE(batch->den);
+    FREE(batch->prefix);
+    FREE(batch);
+}
+
+static int abatch_invert(Abatch *batch, mpz_t factor)
+{
+    mpz_t *inv = &batch->t[0];
+    mpz_t *temp = &batch->t[1];
+    size_t i;
+
+    for (;;)
+    {
+        mpz_set(batch->prefix[0], batch->den[0]);
+        for (i = 1; i < batch->curves; ++i)
+        {
+            mpz_mul(batch->prefix[i], batch->prefix[i - 1], batch->den[i]);
+            mpz_mod(batch->prefix[i], batch->prefix[i], batch->n);
+        }
+
+        if (mpz_invert(*inv, batch->prefix[batch->curves - 1], batch->n) != 0)
+            break;
+
+        /* map failure back to curve */
+        for (i = 0; i < batch->curves; ++i)
+        {
+            mpz_gcd(*temp, batch->den[i], batch->n);
+            if (mpz_cmp_ui(*temp, 1) == 0)
+                continue;
+
+            if (mpz_cmp(*temp, batch->n) < 0)
+            {
+                mpz_set(factor, *temp);
+                LOG("Curve %zu of %zu in batch found factor\n", i, batch->curves);
+
+                return 1;
+            }
+
+            /* den = 0 mod n, this curve is useless */
+            batch->dead[i] = true;
+            batch->step[i] = BATCH_STEP_NONE;
+            mpz_set_ui(batch->den[i], 1);
+        }
+    }
+
+    /* inv = 1 / (den[0] * ... * den[i]) */
+    for (i = batch->curves - 1; i > 0; --i)
+    {
+        mpz_mul(*temp, *inv, batch->prefix[i - 1]);
+        mpz_mod(*temp, *temp, batch->n);
+
+        mpz_mul(*inv, *inv, batch->den[i]);
+        mpz_mod(*inv, *inv, batch->n);
+
+        mpz_set(batch->den[i], *temp);
+    }
+
+    mpz_set(batch->den[0], *inv);
+
+    return 0;
+}
+
+static void abatch_finish(Abatch *batch, Apoint *res, const Apoint *p, const Apoint *q)
+{
+    mpz_t *lambda = &batch->t[0];
+    mpz_t *x3 = &batch->t[1];
+    size_t i;
+
+    for (i = 0; i < batch->curves; ++i)
+    {
+        if (batch->step[i] == BATCH_STEP_NONE)
+            continue;
+
+        mpz_mul(*lambda, batch->num[i], batch->den[i]);
+        mpz_mod(*lambda, *lambda, batch->n);
+
+        /* x3 = lambda^2 - x1 - x2, x2 = x1 for doubling */
+        mpz_mul(*x3, *lambda, *lambda);
+        mpz_sub(*x3, *x3, p[i].x);
+        mpz_sub(*x3, *x3, batch->step[i] == BATCH_STEP_ADD ? q[i].x : p[i].x);
+        mpz_mod(*x3, *x3, batch->n);
+
+        /* y3 = lambda * (x1 - x3) - y1 */
+        mpz_sub(batch->t[2], p[i].x, *x3);
+        mpz_mul(batch->t[2], batch->t[2], *lambda);
+        mpz_sub(batch->t[2], batch->t[2], p[i].y);
+        mpz_mod(res[i].y, batch->t[2], batch->n);
+
+        mpz_set(res[i].x, *x3);
+        res[i].inf = false;
+    }
+}
+
+static int abatch_dbl(Abatch *batch, Apoint *res, const Apoint *p, mpz_t factor)
+{
+    size_t i;
+
+    for (i = 0; i < batch->curves; ++i)
+    {
+        batch->step[i] = BATCH_STEP_NONE;
+        mpz_set_ui(batch->den[i], 1);
+
+        if (batch->dead[i])
+            continue;
+
+        /* 2O = O, 2P = O for y = 0 */
+        if (p[i].inf || mpz_cmp_ui(p[i].y, 0) == 0)
+        {
+            res[i].inf = true;
+            continue;
+        }
+
+        /* lambda = (3x^2 + a) / 2y */
+        batch->step[i] = BATCH_STEP_DBL;
+        mpz_mul(batch->num[i], p[i].x, p[i].x);
+        mpz_mul_ui(batch->num[i], batch->num[i], 3);
+        mpz_add(batch->num[i], batch->num[i], batch->a[i]);
+        mpz_mod(batch->num[i], batch->num[i], batch->n);
+
+        mpz_mul_2exp(batch->den[i], p[i].y, 1);
+        mpz_mod(batch->den[i], batch->den[i], batch->n);
+    }
+
+    if (abatch_invert(batch, factor))
+        return 1;
+
+    abatch_finish(batch, res, p, NULL);
+
+    return 0;
+}
+
+static int abatch_add(Abatch *batch, Apoint *res, const Apoint *p, const Apoint *q, bool negate, mpz_t factor)
+{
+    mpz_t *y = &batch->t[0];
+    size_t i;
+
+    for (i = 0; i < batch->curves; ++i)
+    {
+        batch->step[i] = BATCH_STEP_NONE;
+        mpz_set_ui(batch->den[i], 1);
+
+        if (batch->dead[i] || q[i].inf)
+        {
+            apoint_set(&res[i], &p[i]);
+            continue;
+        }
+
+        /* y of second operand, -(x, y) = (x, -y) */
+        if (negate)
+        {
+            mpz_sub(*y, batch->n, q[i].y);
+            mpz_mod(*y, *y, batch->n);
+        }
+        else
+        {
+            mpz_set(*y, q[i].y);
+        }
+
+        if (p[i].inf)
+        {
+            mpz_set(res[i].x, q[i].x);
+            mpz_set(res[i].y, *y);
+            res[i].inf = false;
+            continue;
+        }
+
+        if (mpz_cmp(p[i].x, q[i].x) == 0)
+        {
+            mpz_add(batch->t[1], p[i].y, *y);
+            mpz_mod(batch->t[1], batch->t[1], batch->n);
+
+            /* P + (-P) = O */
+            if (mpz_cmp_ui(batch->t[1], 0) == 0)
+            {
+                res[i].inf = true;
+                continue;
+            }
+
+            /* P + P, lambda = (3x^2 + a) / 2y */
+            batch->step[i] = BATCH_STEP_DBL;
+            mpz_mul(batch->num[i], p[i].x, p[i].x);
+            mpz_mul_ui(batch->num[i], batch->num[i], 3);
+            mpz_add(batch->num[i], batch->num[i], batch->a[i]);
+            mpz_mod(batch->num[i], batch->num[i], batch->n);
+
+            mpz_mul_2exp(batch->den[i], p[i].y, 1);
+            mpz_mod(batch->den[i], batch->den[i], batch->n);
+        }
+        else
+        {
+            /* lambda = (y2 - y1) / (x2 - x1) */
+            batch->step[i] = BATCH_STEP_ADD;
+            mpz_sub(batch->num[i], *y, p[i].y);
+            mpz_mod(batch->num[i], batch->num[i], batch->n);
+
+            mpz_sub(batch->den[i], q[i].x, p[i].x);
+            mpz_mod(batch->den[i], batch->den[i], batch->n);
+        }
+    }
+
+    if (abatch_invert(batch, factor))
+        return 1;
+
+    abatch_finish(batch, res, p, q);
+
+    return 0;
+}
+
+int batch_ecm(Abatch *batch, const Ecm_plan *plan, uint64_t seed, const bool *cancel, mpz_t factor)
+{
+    const size_t entries = (size_t)1 << (plan->naf_width - 2);
+    const size_t curves = batch->curves;
+    size_t k;
+    size_t i;
+    int found = 0;
+    bool done = false;
+
+    TRACE();
+
+    if (abatch_reserve(batch, plan))
+        ERROR("abatch_reserve error\n", 1);
+
+    abatch_set(batch, seed);
+
+    /* table[k] = table[k - 1] + 2P, r holds 2P */
+    found = abatch_dbl(batch, batch->r, batch->table, factor);
+    for (k = 1; k < entries && !found; ++k)
+        found = abatch_add(batch, &batch->table[k * curves], &batch->table[(k - 1) * curves], batch->r, false, factor);
+
+    /* the most significant digit is positive */
+    for (i = 0; i < curves && !found; ++i)
+        apoint_set(&batch->r[i], &batch->table[(size_t)(plan->naf[0] >> 1) * curves + i]);
+
+    for (k = 1; k < plan->naf_len && !found && !done; ++k)
+    {
+        if ((k & (BATCH_CANCEL_STEPS - 1)) == 0)
+        {
+#pragma omp atomic read
+            done = *cancel;
+        }
+
+        found = abatch_dbl(batch, batch->r, batch->r, factor);
+        if (!found && plan->naf[k] != 0)
+            found = abatch_add(batch, batch->r, batch->r,
+                               &batch->table[(size_t)((plan->naf[k] > 0 ? plan->naf[k] : -plan->naf[k]) >> 1) * curves],
+                               plan->naf[k] < 0, factor);
+    }
+
+    return found ? 0 : 1;
+}
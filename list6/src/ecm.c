@@ -1,8 +1,13 @@
 #include <ecm.h>
+#include <montgomery.h>
+#include <edwards.h>
+#include <batch.h>
+#include <sieve.h>
 #include <gmp.h>
 #include <log.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <common.h>
 
 /* 3D point */
@@ -13,49 +18,65 @@ typedef struct Point
     mpz_t z;
 } Point;
 
-/* y^2 = x^3 + ax + b in Zn */
+/* y^2 = x^3 + ax + b in Zn, all numbers are allocated once and reused by every curve */
 typedef struct ECurve
 {
     mpz_t a;
     mpz_t b;
     mpz_t n;
+    mp_bitcnt_t bits;   /* size of every number, product of two residues fits without realloc */
+
+    Point point;
+    Point r;            /* accumulator of eliptic_mul */
+    mpz_t t[4];         /* temporaries of eliptic_add */
+    gmp_randstate_t state;
+    Sieve *primes;      /* primes < B1, one thread sieves, so every curve restarts it without allocation */
 } ECurve;
 
+/* one of backends is created, others are NULL */
+struct Ecm_workspace
+{
+    ecm_curve_t curve;
+    ECurve *ecurve;
+    Mcurve *mcurve;
+    Edcurve *edcurve;
+    Abatch *batch;
+};
+
 /*
-    Create new 3D Point
+    Init 3D point as point at infinity [0, 1, 0]
 
     PARAMS
-    @IN n - modular
+    @IN p - point
+    @IN bits - size of coordinates
 
     RETURN
-    NULL iff failure
-    Pointer to new Point iff success
+    This is a void function
 */
-static Point *point_create(void);
+static void point_init(Point *p, mp_bitcnt_t bits);
 
 /*
-    Destroy 3D point
+    Clear 3D point
 
     PARAMS
-    @IN p - pointer to 3D point
+    @IN p - point
 
     RETURN
     This is a void function
 */
-static void point_destroy(Point *p);
+static void point_clear(Point *p);
 
 /*
-    Create Curve from Point in Zn
+    Create Curve workspace in Zn
 
     PARAMS
-    @IN p - point
     @IN n - modular
 
     RETURN
     NULL iff failure
     Pointer to ECurve iff success
 */
-static ECurve *ecurve_create(const Point *p, const mpz_t n);
+static ECurve *ecurve_create(const mpz_t n);
 
 /*
     Destroy Curve
@@ -68,6 +89,18 @@ static ECurve *ecurve_create(const Point *p, const mpz_t n);
 */
 static void ecurve_destroy(ECurve *ecurve);
 
+/*
+    Set pseudorandom point and curve through it, both depend only on n and seed
+
+    PARAMS
+    @IN ecurve - curve
+    @IN seed - seed of point and curve coefficients
+
+    RETURN
+    This is a void function
+*/
+static void ecurve_set(ECurve *ecurve, uint64_t seed);
+
 /*
     Eliptic "scalar" mul, k * 3D Point p in Curve ecurve
 
@@ -79,7 +112,7 @@ static void ecurve_destroy(ECurve *ecurve);
     RETURN
     This is a void function
 */
-static void eliptic_mul(uint32_t k, Point *p, const ECurve *ecurve);
+static void eliptic_mul(uint32_t k, Point *p, ECurve *ecurve);
 
 /*
     Addition in eliptic curve: inout = inout + in
@@ -89,117 +122,80 @@ static void eliptic_mul(uint32_t k, Point *p, const ECurve *ecurve);
     @IN in - second point
 
 */
-static void eliptic_add(Point *inout, const Point *in, const ECurve *ecurve);
+static void eliptic_add(Point *inout, const Point *in, ECurve *ecurve);
 
-static Point *point_create(void)
-{
-    Point *p;
+/*
+    Lenstra factorization method on pseudorandom affine Weierstrass curve
 
-    TRACE();
+    PARAMS
+    @IN ecurve - workspace with number to factor
+    @IN limit - max iteration
+    @IN seed - seed of point and curve coefficients
+    @IN cancel - flag set by other thread when curve should stop
+    @OUT factor - first n factor
 
-    p = (Point *)malloc(sizeof(Point));
-    if (p == NULL)
-        ERROR("malloc error\n", NULL);
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int weierstrass_ecm(ECurve *ecurve, uint32_t limit, uint64_t seed, const bool *cancel, mpz_t factor);
 
-    mpz_init(p->x);
-    mpz_init(p->y);
-    mpz_init(p->z);
+static void point_init(Point *p, mp_bitcnt_t bits)
+{
+    mpz_init2(p->x, bits);
+    mpz_init2(p->y, bits);
+    mpz_init2(p->z, bits);
 
     mpz_set_ui(p->x, 0);
     mpz_set_ui(p->y, 1);
     mpz_set_ui(p->z, 0);
-
-    return p;
 }
 
-static Point *point_create_random(const mpz_t n)
+static void point_clear(Point *p)
 {
-    Point *p;
-    gmp_randstate_t state;
-
-    TRACE();
-
-    gmp_randinit_default(state);
-    gmp_randseed_ui(state, (unsigned long)rand());
-
-    p = (Point *)malloc(sizeof(Point));
-    if (p == NULL)
-        ERROR("malloc error\n", NULL);
-
-    mpz_init(p->x);
-    mpz_init(p->y);
-    mpz_init(p->z);
-
-    mpz_urandomm(p->x, state, n);
-    mpz_urandomm(p->y, state, n);
-    mpz_set_ui(p->z, 1);
-
-    gmp_randclear(state);
-
-    return p;
-}
-
-static void point_destroy(Point *p)
-{
-    TRACE();
-
-    if (p == NULL)
-        return;
-
     mpz_clear(p->x);
     mpz_clear(p->y);
     mpz_clear(p->z);
-
-    FREE(p);
 }
 
-static ECurve *ecurve_create(const Point *p, const mpz_t n)
+static ECurve *ecurve_create(const mpz_t n)
 {
     ECurve *ecurve;
-    gmp_randstate_t state;
-
-    mpz_t x3;
-    mpz_t y2;
-    mpz_t ax;
+    size_t i;
 
     TRACE();
 
-    gmp_randinit_default(state);
-    gmp_randseed_ui(state, (unsigned long)rand());
-
     ecurve = (ECurve *)malloc(sizeof(ECurve));
     if (ecurve == NULL)
         ERROR("malloc error\n", NULL);
 
-    mpz_init(ecurve->a);
-    mpz_init(ecurve->b);
-    mpz_init(ecurve->n);
+    ecurve->bits = 2 * mpz_sizeinbase(n, 2) + 2 * GMP_NUMB_BITS;
 
-    mpz_init(x3);
-    mpz_init(y2);
-    mpz_init(ax);
+    mpz_init2(ecurve->a, ecurve->bits);
+    mpz_init2(ecurve->b, ecurve->bits);
+    mpz_init_set(ecurve->n, n);
 
-    mpz_set(ecurve->n, n);
-    mpz_urandomm(ecurve->a, state, n);
+    point_init(&ecurve->point, ecurve->bits);
+    point_init(&ecurve->r, ecurve->bits);
+    for (i = 0; i < ARRAY_SIZE(ecurve->t); ++i)
+        mpz_init2(ecurve->t[i], ecurve->bits);
+
+    gmp_randinit_default(ecurve->state);
+
+    ecurve->primes = sieve_create(0, 0, 1);
+    if (ecurve->primes == NULL)
+    {
+        ecurve_destroy(ecurve);
+        ERROR("sieve_create error\n", NULL);
+    }
 
-    /* y^2 = x^3 + ax + b --> b = y^2 - x^3 - ax */
-    mpz_pow_ui(x3, p->x, 3);
-    mpz_pow_ui(y2, p->y, 2);
-    mpz_mul(ax, p->x, ecurve->a);
-    mpz_sub(ecurve->b, y2, x3);
-    mpz_sub(ecurve->b, ecurve->b, ax);
-    mpz_mod(ecurve->b, ecurve->b, n);
-
-    mpz_clear(x3);
-    mpz_clear(y2);
-    mpz_clear(ax);
-
-    gmp_randclear(state);
     return ecurve;
 }
 
 static void ecurve_destroy(ECurve *ecurve)
 {
+    size_t i;
+
     TRACE();
 
     if (ecurve == NULL)
@@ -209,16 +205,46 @@ static void ecurve_destroy(ECurve *ecurve)
     mpz_clear(ecurve->b);
     mpz_clear(ecurve->n);
 
+    point_clear(&ecurve->point);
+    point_clear(&ecurve->r);
+    for (i = 0; i < ARRAY_SIZE(ecurve->t); ++i)
+        mpz_clear(ecurve->t[i]);
+
+    gmp_randclear(ecurve->state);
+    sieve_destroy(ecurve->primes);
+
     FREE(ecurve);
 }
 
-static void eliptic_add(Point *inout, const Point *in, const ECurve *ecurve)
+static void ecurve_set(ECurve *ecurve, uint64_t seed)
 {
-    mpz_t temp;
-    mpz_t temp1;
-    mpz_t temp2;
+    Point *p = &ecurve->point;
+
+    TRACE();
+
+    gmp_randseed_ui(ecurve->state, (unsigned long)seed);
+
+    mpz_urandomm(p->x, ecurve->state, ecurve->n);
+    mpz_urandomm(p->y, ecurve->state, ecurve->n);
+    mpz_set_ui(p->z, 1);
+
+    mpz_urandomm(ecurve->a, ecurve->state, ecurve->n);
+
+    /* y^2 = x^3 + ax + b --> b = y^2 - x^3 - ax */
+    mpz_powm_ui(ecurve->t[0], p->x, 3, ecurve->n);
+    mpz_mul(ecurve->t[1], p->y, p->y);
+    mpz_mul(ecurve->t[2], p->x, ecurve->a);
+    mpz_sub(ecurve->b, ecurve->t[1], ecurve->t[0]);
+    mpz_sub(ecurve->b, ecurve->b, ecurve->t[2]);
+    mpz_mod(ecurve->b, ecurve->b, ecurve->n);
+}
 
-    mpz_t inv;
+static void eliptic_add(Point *inout, const Point *in, ECurve *ecurve)
+{
+    mpz_ptr temp = ecurve->t[0];
+    mpz_ptr temp1 = ecurve->t[1];
+    mpz_ptr temp2 = ecurve->t[2];
+    mpz_ptr inv = ecurve->t[3];
 
     TRACE();
 
@@ -240,7 +266,6 @@ static void eliptic_add(Point *inout, const Point *in, const ECurve *ecurve)
     if (mpz_cmp(inout->x, in->x) == 0)
     {
         /* if y + y == 0 then inout = infinity [0,1,0] */
-        mpz_init(temp);
         mpz_add(temp, inout->y, in->y);
         mpz_mod(temp, temp, ecurve->n);
 
@@ -250,38 +275,31 @@ static void eliptic_add(Point *inout, const Point *in, const ECurve *ecurve)
             mpz_set_ui(inout->y, 1);
             mpz_set_ui(inout->z, 0);
 
-            mpz_clear(temp);
-
             return;
         }
 
         /* temp1 = (3x^2 + a) mod n */
-        mpz_init(temp1);
         mpz_mul(temp1, inout->x, inout->x);
         mpz_mul_ui(temp1, temp1, 3);
         mpz_add(temp1, temp1, ecurve->a);
         mpz_mod(temp1, temp1, ecurve->n);
 
         /* temp2 = 2y mod n */
-        mpz_init(temp2);
         mpz_mul_ui(temp2, inout->y, 2);
         mpz_mod(temp2, temp2, ecurve->n);
     }
     else
     {
         /* temp1 = Y2 - Y1 mod n */
-        mpz_init(temp1);
         mpz_sub(temp1, in->y, inout->y);
         mpz_mod(temp1, temp1, ecurve->n);
 
 
         /* temp2 = X2 - X1 mod n */
-        mpz_init(temp2);
         mpz_sub(temp2, in->x, inout->x);
         mpz_mod(temp2, temp2, ecurve->n);
     }
 
-    mpz_init(inv);
     /* if cannot invert, inout = non trivial factor [0,0, temp2] */
     if (mpz_invert(inv, temp2, ecurve->n) == 0)
     {
@@ -289,18 +307,13 @@ static void eliptic_add(Point *inout, const Point *in, const ECurve *ecurve)
         mpz_set_ui(inout->y, 0);
         mpz_set(inout->z, temp2);
 
-        mpz_clear(temp1);
-        mpz_clear(temp2);
-        mpz_clear(inv);
-
         return;
     }
 
     /* temp = temp1^2 * inv^2 - X1 - X2 mod n */
-    mpz_init(temp);
-    mpz_mul(temp, temp1, temp1);
-    mpz_mul(temp, temp, inv);
-    mpz_mul(temp, temp, inv);
+    mpz_mul(temp, temp1, inv);
+    mpz_mod(temp, temp, ecurve->n);
+    mpz_mul(temp, temp, temp);
     mpz_sub(temp, temp, inout->x);
     mpz_sub(temp, temp, in->x);
     mpz_mod(temp, temp, ecurve->n);
@@ -308,6 +321,7 @@ static void eliptic_add(Point *inout, const Point *in, const ECurve *ecurve)
     /* temp2 = temp1 * inv * (X1 - temp) - Y2 mod n */
     mpz_sub(temp2, inout->x, temp);
     mpz_mul(temp2, temp2, inv);
+    mpz_mod(temp2, temp2, ecurve->n);
     mpz_mul(temp2, temp2, temp1);
     mpz_sub(temp2, temp2, inout->y);
     mpz_mod(temp2, temp2, ecurve->n);
@@ -315,31 +329,25 @@ static void eliptic_add(Point *inout, const Point *in, const ECurve *ecurve)
     mpz_set(inout->x, temp);
     mpz_set(inout->y, temp2);
     mpz_set_ui(inout->z, 1);
-
-    mpz_clear(temp);
-    mpz_clear(temp1);
-    mpz_clear(temp2);
-    mpz_clear(inv);
 }
 
 
-static void eliptic_mul(uint32_t k, Point *p, const ECurve *ecurve)
+static void eliptic_mul(uint32_t k, Point *p, ECurve *ecurve)
 {
-    Point *r;
+    Point *r = &ecurve->r;
 
     TRACE();
 
-    r = point_create_random(ecurve->n);
-    r = point_create();
+    /* r = infinity [0,1,0] */
+    mpz_set_ui(r->x, 0);
+    mpz_set_ui(r->y, 1);
+    mpz_set_ui(r->z, 0);
 
     /* standart fast mult algorithm (k * p) */
     while (k > 0)
     {
         if (mpz_cmp_ui(p->z, 1) > 0)
-        {
-            point_destroy(r);
             return;
-        }
 
         if (ODD(k))
             eliptic_add(r, p, ecurve); /* r = r + p */
@@ -347,47 +355,157 @@ static void eliptic_mul(uint32_t k, Point *p, const ECurve *ecurve)
         eliptic_add(p, r, ecurve); /* p = p + r */
         k >>= 1;
     }
-
-    point_destroy(r);
 }
 
-int lenstra_ecm(const mpz_t n, Darray *primes, uint32_t limit, mpz_t factor)
+static int weierstrass_ecm(ECurve *ecurve, uint32_t limit, uint64_t seed, const bool *cancel, mpz_t factor)
 {
     uint32_t prime;
-    mpz_t p;
-    Point *point;
-    ECurve *ecurve;
+    uint64_t p;
+    Point *point = &ecurve->point;
+    bool done;
 
     TRACE();
 
-    point = point_create_random(n);
-    if (point == NULL)
-        ERROR("point_create error\n", 1);
+    ecurve_set(ecurve, seed);
+    if (sieve_reset(ecurve->primes, 0, limit))
+        ERROR("sieve_reset error\n", 1);
 
-    ecurve = ecurve_create(point, n);
-    if (ecurve == NULL)
-        ERROR("ecurve_create error\n", 1);
+    while ((prime = (uint32_t)sieve_next(ecurve->primes)) != 0)
+    {
+        /* affine steps are slow, so check cancellation for every prime */
+#pragma omp atomic read
+        done = *cancel;
+
+        if (done)
+            break;
 
-    mpz_init(p);
-    for_each_data(primes, Darray, prime)
         /* p = prime; p < limit; p *= prime */
-        for (mpz_set_ui(p, (unsigned long)prime); mpz_cmp_ui(p, (unsigned long)limit) < 0; mpz_mul_ui(p, p, (unsigned long)prime))
+        for (p = prime; p < limit; p *= prime)
         {
             eliptic_mul(prime, point, ecurve);
             if (mpz_cmp_ui(point->z, 1) > 0) /* we have non trivial factor of n */
             {
                 /* factor is gcd(n, z) */
-                mpz_gcd(factor, n, point->z);
-
-                point_destroy(point);
-                ecurve_destroy(ecurve);
+                mpz_gcd(factor, ecurve->n, point->z);
 
                 return 0;
             }
         }
-
-    point_destroy(point);
-    ecurve_destroy(ecurve);
+    }
 
     return 1;
-}
\ No newline at end of file
+}
+
+size_t lenstra_ecm_curves(ecm_curve_t curve)
+{
+    return curve == ECM_CURVE_BATCH ? ECM_BATCH_CURVES : 1;
+}
+
+bool lenstra_ecm_stage2(ecm_curve_t curve)
+{
+    return curve == ECM_CURVE_MONTGOMERY || curve == ECM_CURVE_EDWARDS;
+}
+
+uint64_t lenstra_ecm_sigma(uint64_t seed, uint64_t index)
+{
+    uint64_t z;
+
+    /* splitmix64 of index-th element of Weyl sequence */
+    z = seed + (index + 1) * 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    z ^= z >> 31;
+
+    return ECM_SIGMA_MIN + z % ECM_SIGMA_RANGE;
+}
+
+Ecm_workspace *ecm_workspace_create(const mpz_t n, ecm_curve_t curve)
+{
+    Ecm_workspace *ws;
+
+    TRACE();
+
+    ws = (Ecm_workspace *)calloc(1, sizeof(Ecm_workspace));
+    if (ws == NULL)
+        ERROR("calloc error\n", NULL);
+
+    ws->curve = curve;
+    switch (curve)
+    {
+        case ECM_CURVE_WEIERSTRASS:
+            ws->ecurve = ecurve_create(n);
+            break;
+        case ECM_CURVE_MONTGOMERY:
+            ws->mcurve = mcurve_create(n);
+            break;
+        case ECM_CURVE_EDWARDS:
+            ws->edcurve = edcurve_create(n);
+            break;
+        case ECM_CURVE_BATCH:
+            ws->batch = abatch_create(n, ECM_BATCH_CURVES);
+            break;
+        default:
+            break;
+    }
+
+    if (ws->ecurve == NULL && ws->mcurve == NULL && ws->edcurve == NULL && ws->batch == NULL)
+    {
+        FREE(ws);
+        ERROR("workspace create error\n", NULL);
+    }
+
+    return ws;
+}
+
+void ecm_workspace_destroy(Ecm_workspace *ws)
+{
+    TRACE();
+
+    if (ws == NULL)
+        return;
+
+    ecurve_destroy(ws->ecurve);
+    mcurve_destroy(ws->mcurve);
+    edcurve_destroy(ws->edcurve);
+    abatch_destroy(ws->batch);
+
+    FREE(ws);
+}
+
+int ecm_workspace_reserve(Ecm_workspace *ws, const Ecm_plan *plan)
+{
+    TRACE();
+
+    switch (ws->curve)
+    {
+        case ECM_CURVE_WEIERSTRASS:
+            return sieve_reset(ws->ecurve->primes, 0, plan->b1);
+        case ECM_CURVE_MONTGOMERY:
+            return mcurve_reserve(ws->mcurve, plan);
+        case ECM_CURVE_EDWARDS:
+            return edcurve_reserve(ws->edcurve, plan);
+        case ECM_CURVE_BATCH:
+            return abatch_reserve(ws->batch, plan);
+        default:
+            ERROR("unknown curve\n", 1);
+    }
+}
+
+int lenstra_ecm(Ecm_workspace *ws, const Ecm_plan *plan, uint64_t sigma, const bool *cancel, mpz_t factor)
+{
+    TRACE();
+
+    switch (ws->curve)
+    {
+        case ECM_CURVE_WEIERSTRASS:
+            return weierstrass_ecm(ws->ecurve, plan->b1, sigma, cancel, factor);
+        case ECM_CURVE_MONTGOMERY:
+            return montgomery_ecm(ws->mcurve, plan, sigma, cancel, factor);
+        case ECM_CURVE_EDWARDS:
+            return edwards_ecm(ws->edcurve, plan, sigma, cancel, factor);
+        case ECM_CURVE_BATCH:
+            return batch_ecm(ws->batch, plan, sigma, cancel, factor);
+        default:
+            ERROR("unknown curve\n", 1);
+    }
+}
@@ -0,0 +1,600 @@
+#include <ecm_plan.h>
+#include <sieve.h>
+#include <log.h>
+#include <common.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+/* cost of x-only doubling and differential addition in multiplications */
+#define PRAC_DBL_COST 5
+#define PRAC_ADD_COST 6
+
+/* every rule makes d + e at least 3 / 4 times smaller, so chain of 32 bit prime is shorter */
+#define PRAC_MAX_OPS 128
+
+/* NAF digits are int8_t, so width is at most 8 */
+#define ECM_NAF_MAX_WIDTH 8
+
+struct Ecm_pairs
+{
+    Sieve *primes;      /* primes of (B1, B2], one thread sieves */
+    uint64_t prime;     /* first prime not returned yet, 0 at end */
+    unsigned long d;
+
+    /* different j of current giant step */
+    uint32_t *js;
+    size_t js_capacity;
+
+    /* seen[j / 2] == stamp iff j is already in js, stamp grows with every giant step, so nothing is cleared */
+    uint64_t *seen;
+    size_t seen_capacity;
+    uint64_t stamp;
+};
+
+/* PRAC parameters tried for every prime, first is 1 / golden ratio */
+static const double prac_values[] =
+{
+    0.61803398874989485, 0.72360679774997897, 0.58017872829546410,
+    0.63283980608870629, 0.61242994950949500, 0.62018198080741576,
+    0.61721461653440386, 0.61897122007491124, 0.61914068392935330,
+    0.61871386576480076
+};
+
+/*
+    Create PRAC chain of k >= 3 for parameter v, r = round(kv), start (d, e) = (k - r, 2r - k)
+
+    PARAMS
+    @IN k - multiplier
+    @IN v - PRAC parameter
+    @OUT ops - chain, at least PRAC_MAX_OPS
+    @OUT len - length of chain
+
+    RETURN
+    ULONG_MAX iff v does not give valid chain
+    Cost of chain in multiplications iff success
+*/
+static unsigned long prac_chain(uint32_t k, double v, uint8_t *ops, size_t *len);
+
+/*
+    Create the cheapest PRAC chain of prime k
+
+    PARAMS
+    @IN k - prime
+    @OUT ops - chain, at least PRAC_MAX_OPS
+    @OUT len - length of chain
+
+    RETURN
+    This is a void function
+*/
+static void prac_best(uint32_t k, uint8_t *ops, size_t *len);
+
+/*
+    Append chain to plan chain
+
+    PARAMS
+    @IN plan - plan
+    @IN / OUT capacity - allocated size of plan chain
+    @IN ops - chain
+    @IN len - length of chain
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int chain_append(Ecm_plan *plan, size_t *capacity, const uint8_t *ops, size_t len);
+
+/*
+    Create width w NAF of plan scalar, w is chosen to minimize number of additions
+    2^(w - 2) (odd multiples P, 3P, ...) + bits / (w + 1)
+
+    PARAMS
+    @IN plan - plan with scalar
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int naf_create(Ecm_plan *plan);
+
+/*
+    Create stage 1 scalar, PRAC chains and NAF
+
+    PARAMS
+    @IN plan - plan with B1
+    @IN primes - iterator over primes < B1
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int ecm_plan_stage1(Ecm_plan *plan, Sieve *primes);
+
+/*
+    Choose D for stage 2: baby steps cost about D / 4 additions, giant steps (B2 - B1) / D,
+    so the best D is about 2 sqrt(B2 - B1). D must be <= 2 * B1, then every prime q > B1 is > D / 2,
+    so q has m >= 1 and is coprime to D
+
+    PARAMS
+    @IN b1 - stage 1 bound
+    @IN b2 - stage 2 bound
+
+    RETURN
+    0 iff B1 < 3 is too small for every D
+    D iff success
+*/
+static unsigned long ecm_plan_choose_d(uint32_t b1, uint64_t b2);
+
+static unsigned long prac_chain(uint32_t k, double v, uint8_t *ops, size_t *len)
+{
+    uint64_t d;
+    uint64_t e;
+    uint64_t r;
+    uint64_t temp;
+    uint8_t swap;
+    uint8_t op;
+    unsigned long cost;
+    size_t i = 0;
+
+    r = (uint64_t)((double)k * v + 0.5);
+    if (2 * r <= k || r >= k)
+        return ULONG_MAX;
+
+    d = k - r;
+    e = 2 * r - k;
+
+    ops[i++] = PRAC_START;
+    cost = PRAC_DBL_COST;
+
+    /* gcd(d, e) = gcd(k, r) = 1 is invariant, so chain ends with d = e = 1 */
+    while (d != e)
+    {
+        if (i + 2 > PRAC_MAX_OPS)
+            return ULONG_MAX;
+
+        swap = 0;
+        if (d < e)
+        {
+            temp = d;
+            d = e;
+            e = temp;
+            swap = PRAC_SWAP;
+        }
+
+        /* first rule of Montgomery table whose condition holds */
+        if (4 * d <= 5 * e && (d + e) % 3 == 0)
+        {
+            temp = (2 * d - e) / 3;
+            e = (2 * e - d) / 3;
+            d = temp;
+            op = PRAC_RULE_1;
+            cost += 3 * PRAC_ADD_COST;
+        }
+        else if (4 * d <= 5 * e && (d - e) % 6 == 0)
+        {
+            d = (d - e) / 2;
+            op = PRAC_RULE_2;
+            cost += PRAC_ADD_COST + PRAC_DBL_COST;
+        }
+        else if (d <= 4 * e)
+        {
+            d -= e;
+            op = PRAC_RULE_3;
+            cost += PRAC_ADD_COST;
+        }
+        else if ((d + e) % 2 == 0)
+        {
+            d = (d - e) / 2;
+            op = PRAC_RULE_4;
+            cost += PRAC_ADD_COST + PRAC_DBL_COST;
+        }
+        else if (d % 2 == 0)
+        {
+            d /= 2;
+            op = PRAC_RULE_5;
+            cost += PRAC_ADD_COST + PRAC_DBL_COST;
+        }
+        else if (d % 3 == 0)
+        {
+            d = d / 3 - e;
+            op = PRAC_RULE_6;
+            cost += 3 * PRAC_ADD_COST + PRAC_DBL_COST;
+        }
+        else if ((d + e) % 3 == 0)
+        {
+            d = (d - 2 * e) / 3;
+            op = PRAC_RULE_7;
+            cost += 3 * PRAC_ADD_COST + PRAC_DBL_COST;
+        }
+        else if ((d - e) % 3 == 0)
+        {
+            d = (d - e) / 3;
+            op = PRAC_RULE_8;
+            cost += 3 * PRAC_ADD_COST + PRAC_DBL_COST;
+        }
+        else
+        {
+            /* d odd and d + e odd, so e is even */
+            e /= 2;
+            op = PRAC_RULE_9;
+            cost += PRAC_ADD_COST + PRAC_DBL_COST;
+        }
+
+        ops[i++] = (uint8_t)(op | swap);
+    }
+
+    ops[i++] = PRAC_END;
+    cost += PRAC_ADD_COST;
+
+    *len = i;
+
+    return cost;
+}
+
+static void prac_best(uint32_t k, uint8_t *ops, size_t *len)
+{
+    uint8_t temp[PRAC_MAX_OPS];
+    unsigned long cost;
+    unsigned long best = ULONG_MAX;
+    size_t temp_len;
+    size_t i;
+
+    if (k == 2)
+    {
+        ops[0] = PRAC_DBL;
+        *len = 1;
+
+        return;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(prac_values); ++i)
+    {
+        cost = prac_chain(k, prac_values[i], temp, &temp_len);
+        if (cost < best)
+        {
+            best = cost;
+            (void)memcpy(ops, temp, temp_len);
+            *len = temp_len;
+        }
+    }
+}
+
+static int chain_append(Ecm_plan *plan, size_t *capacity, const uint8_t *ops, size_t len)
+{
+    uint8_t *chain;
+
+    if (plan->chain_len + len > *capacity)
+    {
+        *capacity = MAX(*capacity * 2, plan->chain_len + len);
+        chain = (uint8_t *)realloc(plan->chain, *capacity);
+        if (chain == NULL)
+            ERROR("realloc error\n", 1);
+
+        plan->chain = chain;
+    }
+
+    (void)memcpy(plan->chain + plan->chain_len, ops, len);
+    plan->chain_len += len;
+
+    return 0;
+}
+
+static int naf_create(Ecm_plan *plan)
+{
+    uint8_t *bits;
+    int value;
+    unsigned int w;
+    unsigned long cost;
+    unsigned long best = ULONG_MAX;
+
+    const size_t len = mpz_sizeinbase(plan->scalar, 2);
+    size_t i;
+    size_t j;
+
+    TRACE();
+
+    for (w = 2; w <= ECM_NAF_MAX_WIDTH; ++w)
+    {
+        cost = (1ul << (w - 2)) + len / (w + 1);
+        if (cost < best)
+        {
+            best = cost;
+            plan->naf_width = w;
+        }
+    }
+
+    /* NAF can be 1 digit longer than scalar, bits has room for carry and last window */
+    bits = (uint8_t *)calloc(len + ECM_NAF_MAX_WIDTH + 1, sizeof(uint8_t));
+    if (bits == NULL)
+        ERROR("calloc error\n", 1);
+
+    plan->naf = (int8_t *)malloc(sizeof(int8_t) * (len + 1));
+    if (plan->naf == NULL)
+    {
+        FREE(bits);
+        ERROR("malloc error\n", 1);
+    }
+
+    for (i = 0; i < len; ++i)
+        bits[i] = (uint8_t)mpz_tstbit(plan->scalar, i);
+
+    /* digits from the least significant, odd window value in (-2^(w - 1), 2^(w - 1)) */
+    w = plan->naf_width;
+    for (i = 0; i < len + 1; ++i)
+    {
+        value = 0;
+        if (bits[i])
+        {
+            for (j = 0; j < w; ++j)
+            {
+                value |= bits[i + j] << j;
+                bits[i + j] = 0;
+            }
+
+            /* value - 2^w, so carry 2^w to bits above window */
+            if (value >= 1 << (w - 1))
+            {
+                value -= 1 << w;
+                for (j = i + w; bits[j]; ++j)
+                    bits[j] = 0;
+
+                bits[j] = 1;
+            }
+        }
+
+        plan->naf[i] = (int8_t)value;
+    }
+
+    /* most significant digit first, without leading zeros (windows may end below top bit) */
+    for (plan->naf_len = len + 1; plan->naf[plan->naf_len - 1] == 0; --plan->naf_len)
+        ;
+
+    for (i = 0; i < plan->naf_len / 2; ++i)
+    {
+        value = plan->naf[i];
+        plan->naf[i] = plan->naf[plan->naf_len - 1 - i];
+        plan->naf[plan->naf_len - 1 - i] = (int8_t)value;
+    }
+
+    FREE(bits);
+
+    return 0;
+}
+
+static int ecm_plan_stage1(Ecm_plan *plan, Sieve *primes)
+{
+    uint8_t ops[PRAC_MAX_OPS];
+    uint32_t prime;
+    uint64_t q;
+    size_t len = 0;
+    size_t capacity = 0;
+
+    TRACE();
+
+    mpz_set_ui(plan->scalar, 1);
+    while ((prime = (uint32_t)sieve_next(primes)) != 0)
+    {
+        /* one chain per prime, used for every power q = prime^e < B1 */
+        prac_best(prime, ops, &len);
+        for (q = prime; q < plan->b1; q *= prime)
+        {
+            mpz_mul_ui(plan->scalar, plan->scalar, (unsigned long)prime);
+            if (chain_append(plan, &capacity, ops, len))
+                ERROR("chain_append error\n", 1);
+        }
+    }
+
+    if (naf_create(plan))
+        ERROR("naf_create error\n", 1);
+
+    return 0;
+}
+
+static unsigned long ecm_plan_choose_d(uint32_t b1, uint64_t b2)
+{
+    /* products of first primes, so most of j < D / 2 are not coprime to D and never used */
+    const unsigned long candidates[] = {6, 30, 210, 2310, 30030, 510510};
+    unsigned long d = 0;
+    size_t i;
+
+    for (i = 0; i < ARRAY_SIZE(candidates); ++i)
+        if (candidates[i] <= 2 * (uint64_t)b1 && (d == 0 || (uint64_t)candidates[i] * candidates[i] <= 4 * (b2 - b1)))
+            d = candidates[i];
+
+    return d;
+}
+
+Ecm_plan *ecm_plan_create(uint32_t b1, uint64_t b2)
+{
+    Ecm_plan *plan;
+    Sieve *primes;
+
+    TRACE();
+
+    plan = (Ecm_plan *)malloc(sizeof(Ecm_plan));
+    if (plan == NULL)
+        ERROR("malloc error\n", NULL);
+
+    plan->b1 = b1;
+    plan->b2 = b2 > b1 ? b2 : 0;
+    mpz_init(plan->scalar);
+    plan->chain = NULL;
+    plan->chain_len = 0;
+    plan->naf = NULL;
+    plan->naf_len = 0;
+    plan->naf_width = 0;
+    plan->d = 0;
+    plan->m_first = 0;
+    plan->m_last = 0;
+
+    primes = sieve_create(0, b1, 0);
+    if (primes == NULL)
+    {
+        ecm_plan_destroy(plan);
+        ERROR("sieve_create error\n", NULL);
+    }
+
+    if (ecm_plan_stage1(plan, primes))
+    {
+        sieve_destroy(primes);
+        ecm_plan_destroy(plan);
+        ERROR("ecm_plan_stage1 error\n", NULL);
+    }
+
+    sieve_destroy(primes);
+
+    LOG("B1 = %u, scalar bits = %zu, PRAC operations = %zu, NAF width = %u\n",
+        b1, mpz_sizeinbase(plan->scalar, 2), plan->chain_len, plan->naf_width);
+
+    if (plan->b2 == 0)
+        return plan;
+
+    plan->d = ecm_plan_choose_d(b1, b2);
+    if (plan->d == 0)
+    {
+        ecm_plan_destroy(plan);
+        ERROR("B1 < 3 is too small for stage 2\n", NULL);
+    }
+
+    /* q in (B1, B2] has giant step m = round(q / D), D / 2 <= B1, so m >= 1 */
+    plan->m_first = (unsigned long)(((uint64_t)b1 + 1 + plan->d / 2) / plan->d);
+    plan->m_last = (unsigned long)((b2 + plan->d / 2) / plan->d);
+
+    LOG("B1 = %u, B2 = %llu, D = %lu, giant steps = %lu, baby steps = %zu\n",
+        b1, (unsigned long long)b2, plan->d, plan->m_last - plan->m_first + 1, ecm_plan_baby_steps(plan));
+
+    return plan;
+}
+
+void ecm_plan_destroy(Ecm_plan *plan)
+{
+    TRACE();
+
+    if (plan == NULL)
+        return;
+
+    mpz_clear(plan->scalar);
+    FREE(plan->chain);
+    FREE(plan->naf);
+    FREE(plan);
+}
+
+size_t ecm_plan_baby_steps(const Ecm_plan *plan)
+{
+    /* odd j in [1, D / 2] */
+    return plan->d / 4 + 1;
+}
+
+Ecm_pairs *ecm_pairs_create(void)
+{
+    Ecm_pairs *pairs;
+
+    TRACE();
+
+    pairs = (Ecm_pairs *)calloc(1, sizeof(Ecm_pairs));
+    if (pairs == NULL)
+        ERROR("calloc error\n", NULL);
+
+    pairs->primes = sieve_create(0, 0, 1);
+    if (pairs->primes == NULL)
+    {
+        ecm_pairs_destroy(pairs);
+        ERROR("sieve_create error\n", NULL);
+    }
+
+    return pairs;
+}
+
+void ecm_pairs_destroy(Ecm_pairs *pairs)
+{
+    TRACE();
+
+    if (pairs == NULL)
+        return;
+
+    sieve_destroy(pairs->primes);
+    FREE(pairs->js);
+    FREE(pairs->seen);
+    FREE(pairs);
+}
+
+int ecm_pairs_reserve(Ecm_pairs *pairs, const Ecm_plan *plan)
+{
+    uint32_t *js;
+    uint64_t *seen;
+
+    /* odd j in [1, D / 2] */
+    const size_t len = ecm_plan_baby_steps(plan);
+
+    if (len > pairs->js_capacity)
+    {
+        js = (uint32_t *)realloc(pairs->js, sizeof(uint32_t) * len);
+        if (js == NULL)
+            ERROR("realloc error\n", 1);
+
+        pairs->js = js;
+        pairs->js_capacity = len;
+    }
+
+    if (len > pairs->seen_capacity)
+    {
+        seen = (uint64_t *)realloc(pairs->seen, sizeof(uint64_t) * len);
+        if (seen == NULL)
+            ERROR("realloc error\n", 1);
+
+        /* stamps start from 1, so new entries are not seen */
+        (void)memset(seen + pairs->seen_capacity, 0, sizeof(uint64_t) * (len - pairs->seen_capacity));
+        pairs->seen = seen;
+        pairs->seen_capacity = len;
+    }
+
+    /* only grows sieve buffers, first segment is sieved by sieve_next */
+    if (sieve_reset(pairs->primes, (uint64_t)plan->b1 + 1, plan->b2 + 1))
+        ERROR("sieve_reset error\n", 1);
+
+    return 0;
+}
+
+int ecm_pairs_reset(Ecm_pairs *pairs, const Ecm_plan *plan)
+{
+    if (ecm_pairs_reserve(pairs, plan))
+        ERROR("ecm_pairs_reserve error\n", 1);
+
+    pairs->d = plan->d;
+    pairs->prime = sieve_next(pairs->primes);
+
+    return 0;
+}
+
+const uint32_t *ecm_pairs_next(Ecm_pairs *pairs, unsigned long m, size_t *len)
+{
+    uint64_t step;
+    uint32_t j;
+
+    const uint64_t center = (uint64_t)m * pairs->d;
+
+    *len = 0;
+    ++pairs->stamp;
+
+    /* primes of giant step m are in [mD - D / 2, mD + D / 2), primes of skipped giant steps are dropped */
+    for (; pairs->prime != 0; pairs->prime = sieve_next(pairs->primes))
+    {
+        step = (pairs->prime + pairs->d / 2) / pairs->d;
+        if (step > m)
+            break;
+
+        if (step < m)
+            continue;
+
+        j = (uint32_t)(pairs->prime > center ? pairs->prime - center : center - pairs->prime);
+
+        /* mD - j and mD + j share one difference */
+        if (pairs->seen[j >> 1] != pairs->stamp)
+        {
+            pairs->seen[j >> 1] = pairs->stamp;
+            pairs->js[(*len)++] = j;
+        }
+    }
+
+    return pairs->js;
+}
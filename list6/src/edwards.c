@@ -0,0 +1,797 @@
+#include <edwards.h>
+#include <gmp.h>
+#include <log.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <common.h>
+
+/* curve checks cancellation every EDWARDS_CANCEL_STEPS NAF digits and giant steps, must be power of 2 */
+#define EDWARDS_CANCEL_STEPS (1ul << 9)
+
+/* extended point X:Y:Z:T, x = X / Z, y = Y / Z, xy = T / Z */
+typedef struct Edpoint
+{
+    mpz_t x;
+    mpz_t y;
+    mpz_t z;
+    mpz_t t;
+} Edpoint;
+
+/* ax^2 + y^2 = 1 + dx^2y^2 in Zn, all numbers are allocated once and reused by every curve */
+struct Edcurve
+{
+    mpz_t a;
+    mpz_t d;
+    mpz_t n;
+    mp_bitcnt_t bits;   /* size of every number, product of two residues fits without realloc */
+
+    Edpoint point;
+
+    /* accumulator and temporaries, curve setup uses all of t, point arithmetic t[0 .. 5] */
+    Edpoint r;
+    mpz_t t[8];
+
+    /* odd multiples of stage 1 and baby steps of stage 2 grow to the largest plan */
+    Edpoint *table;
+    size_t entries;
+    Edpoint *baby;
+    size_t babies;
+    Edpoint giant;
+    Edpoint step;
+    Ecm_pairs *pairs;
+    mpz_t acc;
+};
+
+/*
+    Init extended point
+
+    PARAMS
+    @IN p - point
+    @IN bits - size of coordinates
+
+    RETURN
+    This is a void function
+*/
+static void edpoint_init(Edpoint *p, mp_bitcnt_t bits);
+
+/*
+    Clear extended point
+
+    PARAMS
+    @IN p - point
+
+    RETURN
+    This is a void function
+*/
+static void edpoint_clear(Edpoint *p);
+
+/*
+    rop = op^-1 mod n
+
+    PARAMS
+    @OUT rop - inverse
+    @IN op - element
+    @IN n - modular
+    @OUT factor - gcd(op, n) iff op is not invertible
+
+    RETURN
+    0 iff success
+    Non-zero value iff op is not invertible
+*/
+static int edwards_invert(mpz_t rop, const mpz_t op, const mpz_t n, mpz_t factor);
+
+/*
+    Affine addition on v^2 = u^3 - 12u mod n: (u1, v1) += (u2, v2), doubling iff points are the same
+
+    PARAMS
+    @IN curve - curve with modular, t[0], t[1] are used
+    @IN / OUT u1 - first point u
+    @IN / OUT v1 - first point v
+    @IN u2 - second point u
+    @IN v2 - second point v
+    @OUT factor - factor iff inversion fails
+
+    RETURN
+    0 iff success
+    Non-zero value iff inversion fails
+*/
+static int family_add(Edcurve *curve, mpz_t u1, mpz_t v1, const mpz_t u2, const mpz_t v2, mpz_t factor);
+
+/*
+    (u, v) = k * (-2, 4) on v^2 = u^3 - 12u mod n, this point has infinite order over Q
+
+    PARAMS
+    @IN curve - curve with modular, t[0 .. 3] are used
+    @OUT u - point u
+    @OUT v - point v
+    @IN k - family parameter, k >= 2
+    @OUT factor - factor iff inversion fails
+
+    RETURN
+    0 iff success
+    Non-zero value iff inversion fails
+*/
+static int family_point(Edcurve *curve, mpz_t u, mpz_t v, unsigned long k, mpz_t factor);
+
+/*
+    Set curve with torsion Z/12 and its non torsion starting point from family parameter k
+
+    PARAMS
+    @IN curve - curve
+    @IN k - family parameter, k >= 2
+    @OUT factor - factor iff inversion fails
+
+    RETURN
+    0 iff success
+    Non-zero value iff some inversion fails
+*/
+static int edcurve_set(Edcurve *curve, uint64_t k, mpz_t factor);
+
+/*
+    Doubling: r = 2p, r can be p
+
+    PARAMS
+    @OUT r - result
+    @IN p - point
+    @IN curve - curve
+
+    RETURN
+    This is a void function
+*/
+static void edpoint_dbl(Edpoint *r, const Edpoint *p, Edcurve *curve);
+
+/*
+    Addition: r = p + q, r can be p or q
+
+    PARAMS
+    @OUT r - result
+    @IN p - first point
+    @IN q - second point
+    @IN curve - curve
+
+    RETURN
+    This is a void function
+*/
+static void edpoint_add(Edpoint *r, const Edpoint *p, const Edpoint *q, Edcurve *curve);
+
+/*
+    Double and add, p = k * p
+
+    PARAMS
+    @IN / OUT p - point
+    @IN k - mult
+    @IN curve - curve
+
+    RETURN
+    This is a void function
+*/
+static void edwards_mul(Edpoint *p, uint64_t k, Edcurve *curve);
+
+/*
+    Stage 1 by width w NAF of scalar from plan, p = scalar * p.
+    Odd multiples P, 3P, ..., (2^(w - 1) - 1)P are precomputed in table reserved by edcurve_reserve, -(X:Y:Z:T) = (-X:Y:Z:-T)
+
+    PARAMS
+    @IN / OUT p - point
+    @IN plan - plan with NAF
+    @IN cancel - flag set by other thread when curve should stop
+    @IN curve - curve
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure or cancelled
+*/
+static int edwards_naf(Edpoint *p, const Ecm_plan *plan, const bool *cancel, Edcurve *curve);
+
+/*
+    Copy point: r = p
+
+    PARAMS
+    @OUT r - result
+    @IN p - point
+
+    RETURN
+    This is a void function
+*/
+static void edpoint_set(Edpoint *r, const Edpoint *p);
+
+/*
+    Stage 2: product of differences Ym * Zj - Yj * Zm of giant steps mDQ and baby steps jQ
+    for every pair (m, j) from plan, so one gcd finds prime q = mD +- j in (B1, B2] with qQ = 0
+
+    PARAMS
+    @IN q - point after stage 1
+    @IN plan - plan with stage 2
+    @IN cancel - flag set by other thread when curve should stop (acc has then only part of pairs)
+    @IN curve - curve
+    @OUT acc - product of differences mod n
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int edwards_stage2(const Edpoint *q, const Ecm_plan *plan, const bool *cancel, Edcurve *curve, mpz_t acc);
+
+static void edpoint_init(Edpoint *p, mp_bitcnt_t bits)
+{
+    mpz_init2(p->x, bits);
+    mpz_init2(p->y, bits);
+    mpz_init2(p->z, bits);
+    mpz_init2(p->t, bits);
+}
+
+static void edpoint_clear(Edpoint *p)
+{
+    mpz_clear(p->x);
+    mpz_clear(p->y);
+    mpz_clear(p->z);
+    mpz_clear(p->t);
+}
+
+static int edwards_invert(mpz_t rop, const mpz_t op, const mpz_t n, mpz_t factor)
+{
+    if (mpz_invert(rop, op, n) == 0)
+    {
+        mpz_gcd(factor, op, n);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int family_add(Edcurve *curve, mpz_t u1, mpz_t v1, const mpz_t u2, const mpz_t v2, mpz_t factor)
+{
+    mpz_ptr lambda = curve->t[0];
+    mpz_ptr temp = curve->t[1];
+    mpz_srcptr n = curve->n;
+    int ret;
+
+    /* lambda = (3u^2 - 12) / 2v for doubling, (v2 - v1) / (u2 - u1) otherwise */
+    if (mpz_cmp(u1, u2) == 0 && mpz_cmp(v1, v2) == 0)
+    {
+        mpz_mul(lambda, u1, u1);
+        mpz_mul_ui(lambda, lambda, 3);
+        mpz_sub_ui(lambda, lambda, 12);
+        mpz_mul_ui(temp, v1, 2);
+    }
+    else
+    {
+        mpz_sub(lambda, v2, v1);
+        mpz_sub(temp, u2, u1);
+    }
+
+    mpz_mod(temp, temp, n);
+    ret = edwards_invert(temp, temp, n, factor);
+    if (ret == 0)
+    {
+        mpz_mul(lambda, lambda, temp);
+        mpz_mod(lambda, lambda, n);
+
+        /* u3 = lambda^2 - u1 - u2, v3 = lambda * (u1 - u3) - v1 */
+        mpz_mul(temp, lambda, lambda);
+        mpz_sub(temp, temp, u1);
+        mpz_sub(temp, temp, u2);
+        mpz_mod(temp, temp, n);
+
+        mpz_sub(u1, u1, temp);
+        mpz_mul(u1, u1, lambda);
+        mpz_sub(v1, u1, v1);
+        mpz_mod(v1, v1, n);
+
+        mpz_set(u1, temp);
+    }
+
+    return ret;
+}
+
+static int family_point(Edcurve *curve, mpz_t u, mpz_t v, unsigned long k, mpz_t factor)
+{
+    mpz_ptr pu = curve->t[2];
+    mpz_ptr pv = curve->t[3];
+    unsigned long mask;
+    int ret = 0;
+
+    /* P = (-2, 4) */
+    mpz_sub_ui(pu, curve->n, 2);
+    mpz_set_ui(pv, 4);
+    mpz_set(u, pu);
+    mpz_set(v, pv);
+
+    for (mask = 1; (k >> 1) >= mask; mask <<= 1)
+        ;
+
+    for (mask >>= 1; mask != 0 && ret == 0; mask >>= 1)
+    {
+        ret = family_add(curve, u, v, u, v, factor);
+        if (ret == 0 && (k & mask))
+            ret = family_add(curve, u, v, pu, pv, factor);
+    }
+
+    return ret;
+}
+
+static int edcurve_set(Edcurve *curve, uint64_t k, mpz_t factor)
+{
+    /* family_point uses t[0 .. 3], they are free again after it */
+    mpz_ptr u = curve->t[4];
+    mpz_ptr v = curve->t[5];
+    mpz_ptr s = curve->t[6];
+    mpz_ptr A = curve->t[7];
+    mpz_ptr B = curve->t[1];
+    mpz_ptr x0 = curve->t[2];
+    mpz_ptr temp = curve->t[3];
+    mpz_srcptr n = curve->n;
+    Edpoint *p = &curve->point;
+
+    int ret;
+
+    TRACE();
+
+    ret = family_point(curve, u, v, (unsigned long)k, factor);
+
+    /* t = v / 2u, s = (t^2 - 1) / (t^2 + 3) */
+    if (ret == 0)
+    {
+        mpz_mul_ui(temp, u, 2);
+        ret = edwards_invert(temp, temp, n, factor);
+    }
+
+    if (ret == 0)
+    {
+        mpz_mul(temp, temp, v);
+        mpz_mul(temp, temp, temp);
+        mpz_mod(temp, temp, n);
+
+        mpz_sub_ui(s, temp, 1);
+        mpz_add_ui(temp, temp, 3);
+        ret = edwards_invert(temp, temp, n, factor);
+    }
+
+    /* A = (-3s^4 - 6s^2 + 1) / 4s^3 */
+    if (ret == 0)
+    {
+        mpz_mul(s, s, temp);
+        mpz_mod(s, s, n);
+
+        mpz_powm_ui(temp, s, 3, n);
+        mpz_mul_ui(temp, temp, 4);
+        ret = edwards_invert(temp, temp, n, factor);
+    }
+
+    /* x0 = (3s^2 + 1) / 4s */
+    if (ret == 0)
+    {
+        mpz_mul(u, s, s);
+        mpz_mod(u, u, n);
+
+        mpz_mul_ui(A, u, 3);
+        mpz_add_ui(A, A, 6);
+        mpz_mul(A, A, u);
+        mpz_ui_sub(A, 1, A);
+        mpz_mul(A, A, temp);
+        mpz_mod(A, A, n);
+
+        mpz_mul_ui(temp, s, 4);
+        ret = edwards_invert(temp, temp, n, factor);
+    }
+
+    if (ret == 0)
+    {
+        mpz_mul_ui(x0, u, 3);
+        mpz_add_ui(x0, x0, 1);
+        mpz_mul(x0, x0, temp);
+        mpz_mod(x0, x0, n);
+
+        /* B = x0^3 + Ax0^2 + x0, then (x0, 1) is on By^2 = x^3 + Ax^2 + x */
+        mpz_add(B, x0, A);
+        mpz_mul(B, B, x0);
+        mpz_add_ui(B, B, 1);
+        mpz_mul(B, B, x0);
+        mpz_mod(B, B, n);
+
+        /* a = (A + 2)B, d = (A - 2)B */
+        mpz_add_ui(curve->a, A, 2);
+        mpz_mul(curve->a, curve->a, B);
+        mpz_mod(curve->a, curve->a, n);
+
+        mpz_sub_ui(curve->d, A, 2);
+        mpz_mul(curve->d, curve->d, B);
+        mpz_mod(curve->d, curve->d, n);
+
+        /* (x, y) = (x0 / B, (x0 - 1) / (x0 + 1)) */
+        mpz_add_ui(temp, x0, 1);
+        mpz_mul(p->x, x0, temp);
+        mpz_mod(p->x, p->x, n);
+        mpz_mul(p->z, B, temp);
+        mpz_mod(p->z, p->z, n);
+
+        mpz_sub_ui(temp, x0, 1);
+        mpz_mul(p->y, B, temp);
+        mpz_mod(p->y, p->y, n);
+        mpz_mul(p->t, x0, temp);
+        mpz_mod(p->t, p->t, n);
+    }
+
+    return ret;
+}
+
+int edcurve_reserve(Edcurve *curve, const Ecm_plan *plan)
+{
+    Edpoint *points;
+
+    const size_t entries = (size_t)1 << (plan->naf_width - 2);
+    const size_t babies = ecm_plan_baby_steps(plan);
+    size_t i;
+
+    TRACE();
+
+    if (entries > curve->entries)
+    {
+        points = (Edpoint *)realloc(curve->table, sizeof(Edpoint) * entries);
+        if (points == NULL)
+            ERROR("realloc error\n", 1);
+
+        for (i = curve->entries; i < entries; ++i)
+            edpoint_init(&points[i], curve->bits);
+
+        curve->table = points;
+        curve->entries = entries;
+    }
+
+    if (babies > curve->babies)
+    {
+        points = (Edpoint *)realloc(curve->baby, sizeof(Edpoint) * babies);
+        if (points == NULL)
+            ERROR("realloc error\n", 1);
+
+        for (i = curve->babies; i < babies; ++i)
+            edpoint_init(&points[i], curve->bits);
+
+        curve->baby = points;
+        curve->babies = babies;
+    }
+
+    if (plan->b2 != 0 && ecm_pairs_reserve(curve->pairs, plan))
+        ERROR("ecm_pairs_reserve error\n", 1);
+
+    return 0;
+}
+
+static void edpoint_dbl(Edpoint *r, const Edpoint *p, Edcurve *curve)
+{
+    mpz_t *t = curve->t;
+
+    /* t0 = X^2, t1 = Y^2, t2 = 2Z^2, t3 = aX^2 */
+    mpz_mul(t[0], p->x, p->x);
+    mpz_mod(t[0], t[0], curve->n);
+
+    mpz_mul(t[1], p->y, p->y);
+    mpz_mod(t[1], t[1], curve->n);
+
+    mpz_mul(t[2], p->z, p->z);
+    mpz_mul_2exp(t[2], t[2], 1);
+    mpz_mod(t[2], t[2], curve->n);
+
+    mpz_mul(t[3], t[0], curve->a);
+    mpz_mod(t[3], t[3], curve->n);
+
+    /* E = (X + Y)^2 - X^2 - Y^2, G = aX^2 + Y^2, F = G - 2Z^2, H = aX^2 - Y^2 */
+    mpz_add(t[4], p->x, p->y);
+    mpz_mul(t[4], t[4], t[4]);
+    mpz_sub(t[4], t[4], t[0]);
+    mpz_sub(t[4], t[4], t[1]);
+    mpz_mod(t[4], t[4], curve->n);
+
+    mpz_add(t[5], t[3], t[1]);
+    mpz_sub(t[0], t[5], t[2]);
+    mpz_sub(t[1], t[3], t[1]);
+
+    /* X = EF, Y = GH, T = EH, Z = FG */
+    mpz_mul(r->x, t[4], t[0]);
+    mpz_mod(r->x, r->x, curve->n);
+
+    mpz_mul(r->y, t[5], t[1]);
+    mpz_mod(r->y, r->y, curve->n);
+
+    mpz_mul(r->t, t[4], t[1]);
+    mpz_mod(r->t, r->t, curve->n);
+
+    mpz_mul(r->z, t[0], t[5]);
+    mpz_mod(r->z, r->z, curve->n);
+}
+
+static void edpoint_add(Edpoint *r, const Edpoint *p, const Edpoint *q, Edcurve *curve)
+{
+    mpz_t *t = curve->t;
+
+    /* t0 = XpXq, t1 = YpYq, t2 = dTpTq, t3 = ZpZq */
+    mpz_mul(t[0], p->x, q->x);
+    mpz_mod(t[0], t[0], curve->n);
+
+    mpz_mul(t[1], p->y, q->y);
+    mpz_mod(t[1], t[1], curve->n);
+
+    mpz_mul(t[2], p->t, q->t);
+    mpz_mod(t[2], t[2], curve->n);
+    mpz_mul(t[2], t[2], curve->d);
+    mpz_mod(t[2], t[2], curve->n);
+
+    mpz_mul(t[3], p->z, q->z);
+    mpz_mod(t[3], t[3], curve->n);
+
+    /* E = (Xp + Yp)(Xq + Yq) - XpXq - YpYq */
+    mpz_add(t[4], p->x, p->y);
+    mpz_add(t[5], q->x, q->y);
+    mpz_mul(t[4], t[4], t[5]);
+    mpz_sub(t[4], t[4], t[0]);
+    mpz_sub(t[4], t[4], t[1]);
+    mpz_mod(t[4], t[4], curve->n);
+
+    /* F = D - C, G = D + C, H = B - aA */
+    mpz_sub(t[5], t[3], t[2]);
+    mpz_add(t[3], t[3], t[2]);
+    mpz_mul(t[2], t[0], curve->a);
+    mpz_sub(t[1], t[1], t[2]);
+    mpz_mod(t[1], t[1], curve->n);
+
+    /* X = EF, Y = GH, T = EH, Z = FG */
+    mpz_mul(r->x, t[4], t[5]);
+    mpz_mod(r->x, r->x, curve->n);
+
+    mpz_mul(r->y, t[3], t[1]);
+    mpz_mod(r->y, r->y, curve->n);
+
+    mpz_mul(r->t, t[4], t[1]);
+    mpz_mod(r->t, r->t, curve->n);
+
+    mpz_mul(r->z, t[5], t[3]);
+    mpz_mod(r->z, r->z, curve->n);
+}
+
+static void edwards_mul(Edpoint *p, uint64_t k, Edcurve *curve)
+{
+    uint64_t mask;
+
+    /* top bit of k */
+    for (mask = 1; (k >> 1) >= mask; mask <<= 1)
+        ;
+
+    mpz_set(curve->r.x, p->x);
+    mpz_set(curve->r.y, p->y);
+    mpz_set(curve->r.z, p->z);
+    mpz_set(curve->r.t, p->t);
+
+    for (mask >>= 1; mask != 0; mask >>= 1)
+    {
+        edpoint_dbl(&curve->r, &curve->r, curve);
+        if (k & mask)
+            edpoint_add(&curve->r, &curve->r, p, curve);
+    }
+
+    mpz_set(p->x, curve->r.x);
+    mpz_set(p->y, curve->r.y);
+    mpz_set(p->z, curve->r.z);
+    mpz_set(p->t, curve->r.t);
+}
+
+static void edpoint_set(Edpoint *r, const Edpoint *p)
+{
+    mpz_set(r->x, p->x);
+    mpz_set(r->y, p->y);
+    mpz_set(r->z, p->z);
+    mpz_set(r->t, p->t);
+}
+
+static int edwards_naf(Edpoint *p, const Ecm_plan *plan, const bool *cancel, Edcurve *curve)
+{
+    Edpoint *table;
+    Edpoint *entry;
+
+    const size_t entries = (size_t)1 << (plan->naf_width - 2);
+    size_t i;
+    bool done = false;
+
+    TRACE();
+
+    table = curve->table;
+
+    /* table[i] = (2i + 1)P, r = 2P */
+    edpoint_set(&table[0], p);
+    edpoint_dbl(&curve->r, p, curve);
+    for (i = 1; i < entries; ++i)
+        edpoint_add(&table[i], &table[i - 1], &curve->r, curve);
+
+    /* the most significant digit is positive */
+    edpoint_set(&curve->r, &table[plan->naf[0] >> 1]);
+    for (i = 1; i < plan->naf_len && !done; ++i)
+    {
+        if ((i & (EDWARDS_CANCEL_STEPS - 1)) == 0)
+        {
+#pragma omp atomic read
+            done = *cancel;
+        }
+
+        edpoint_dbl(&curve->r, &curve->r, curve);
+        if (plan->naf[i] > 0)
+        {
+            edpoint_add(&curve->r, &curve->r, &table[plan->naf[i] >> 1], curve);
+        }
+        else if (plan->naf[i] < 0)
+        {
+            entry = &table[-plan->naf[i] >> 1];
+            mpz_neg(entry->x, entry->x);
+            mpz_neg(entry->t, entry->t);
+            edpoint_add(&curve->r, &curve->r, entry, curve);
+            mpz_neg(entry->x, entry->x);
+            mpz_neg(entry->t, entry->t);
+        }
+    }
+
+    edpoint_set(p, &curve->r);
+
+    return done ? 1 : 0;
+}
+
+static int edwards_stage2(const Edpoint *q, const Ecm_plan *plan, const bool *cancel, Edcurve *curve, mpz_t acc)
+{
+    Edpoint *baby;
+    Edpoint *giant = &curve->giant;
+    Edpoint *step = &curve->step;
+
+    const size_t babies = ecm_plan_baby_steps(plan);
+    const uint32_t *js;
+    size_t len;
+    size_t i;
+    size_t k;
+    unsigned long m;
+    bool done = false;
+
+    TRACE();
+
+    if (ecm_pairs_reset(curve->pairs, plan))
+        ERROR("ecm_pairs_reset error\n", 1);
+
+    baby = curve->baby;
+
+    /* baby[i] = (2i + 1)Q, step holds 2Q */
+    edpoint_set(&baby[0], q);
+    edpoint_dbl(step, q, curve);
+    for (i = 1; i < babies; ++i)
+        edpoint_add(&baby[i], &baby[i - 1], step, curve);
+
+    /* giant = m_first * DQ, step = DQ */
+    edpoint_set(step, q);
+    edwards_mul(step, plan->d, curve);
+    edpoint_set(giant, q);
+    edwards_mul(giant, (uint64_t)plan->m_first * plan->d, curve);
+
+    mpz_set_ui(acc, 1);
+    for (m = plan->m_first; m <= plan->m_last && !done; ++m)
+    {
+        if ((m & (EDWARDS_CANCEL_STEPS - 1)) == 0)
+        {
+#pragma omp atomic read
+            done = *cancel;
+        }
+
+        js = ecm_pairs_next(curve->pairs, m, &len);
+        for (k = 0; k < len; ++k)
+        {
+            i = js[k] >> 1;
+
+            /* -(x, y) = (-x, y), so mDQ = +-jQ iff Ym * Zj = Yj * Zm */
+            mpz_mul(curve->t[0], giant->y, baby[i].z);
+            mpz_mul(curve->t[1], baby[i].y, giant->z);
+            mpz_sub(curve->t[0], curve->t[0], curve->t[1]);
+            mpz_mod(curve->t[0], curve->t[0], curve->n);
+            mpz_mul(acc, acc, curve->t[0]);
+            mpz_mod(acc, acc, curve->n);
+        }
+
+        if (m < plan->m_last)
+            edpoint_add(giant, giant, step, curve);
+    }
+
+    return 0;
+}
+
+Edcurve *edcurve_create(const mpz_t n)
+{
+    Edcurve *curve;
+    size_t i;
+
+    TRACE();
+
+    curve = (Edcurve *)malloc(sizeof(Edcurve));
+    if (curve == NULL)
+        ERROR("malloc error\n", NULL);
+
+    curve->bits = 2 * mpz_sizeinbase(n, 2) + 2 * GMP_NUMB_BITS;
+    curve->table = NULL;
+    curve->entries = 0;
+    curve->baby = NULL;
+    curve->babies = 0;
+
+    curve->pairs = ecm_pairs_create();
+    if (curve->pairs == NULL)
+    {
+        FREE(curve);
+        ERROR("ecm_pairs_create error\n", NULL);
+    }
+
+    mpz_init_set(curve->n, n);
+    mpz_init2(curve->a, curve->bits);
+    mpz_init2(curve->d, curve->bits);
+    mpz_init2(curve->acc, curve->bits);
+    edpoint_init(&curve->point, curve->bits);
+    edpoint_init(&curve->r, curve->bits);
+    edpoint_init(&curve->giant, curve->bits);
+    edpoint_init(&curve->step, curve->bits);
+
+    for (i = 0; i < ARRAY_SIZE(curve->t); ++i)
+        mpz_init2(curve->t[i], curve->bits);
+
+    return curve;
+}
+
+void edcurve_destroy(Edcurve *curve)
+{
+    size_t i;
+
+    TRACE();
+
+    if (curve == NULL)
+        return;
+
+    mpz_clear(curve->n);
+    mpz_clear(curve->a);
+    mpz_clear(curve->d);
+    mpz_clear(curve->acc);
+    edpoint_clear(&curve->point);
+    edpoint_clear(&curve->r);
+    edpoint_clear(&curve->giant);
+    edpoint_clear(&curve->step);
+
+    for (i = 0; i < ARRAY_SIZE(curve->t); ++i)
+        mpz_clear(curve->t[i]);
+
+    for (i = 0; i < curve->entries; ++i)
+        edpoint_clear(&curve->table[i]);
+
+    for (i = 0; i < curve->babies; ++i)
+        edpoint_clear(&curve->baby[i]);
+
+    ecm_pairs_destroy(curve->pairs);
+    FREE(curve->table);
+    FREE(curve->baby);
+    FREE(curve);
+}
+
+int edwards_ecm(Edcurve *curve, const Ecm_plan *plan, uint64_t k, const bool *cancel, mpz_t factor)
+{
+    Edpoint *point = &curve->point;
+    bool done;
+
+    TRACE();
+
+    /* tables of both stages once per curve */
+    if (edcurve_reserve(curve, plan))
+        ERROR("edcurve_reserve error\n", 1);
+
+    mpz_set_ui(factor, 1);
+    if (edcurve_set(curve, k, factor) == 0)
+    {
+        done = edwards_naf(point, plan, cancel, curve) != 0;
+
+        /* neutral element is (0, 1), so X = 0 mod p for every p | n with B1 smooth curve order */
+        mpz_gcd(factor, point->x, curve->n);
+
+        /* stage 2 only if stage 1 found nothing, one more gcd at the end */
+        if (mpz_cmp_ui(factor, 1) == 0 && plan->b2 != 0 && !done)
+            if (edwards_stage2(point, plan, cancel, curve, curve->acc) == 0)
+                mpz_gcd(factor, curve->acc, curve->n);
+    }
+
+    return mpz_cmp_ui(factor, 1) > 0 && mpz_cmp(factor, curve->n) < 0 ? 0 : 1;
+}
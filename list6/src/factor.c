@@ -0,0 +1,965 @@
+#include <factor.h>
+#include <sieve.h>
+#include <log.h>
+#include <omp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <common.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <limits.h>
+
+/* trial division by primes < FACTOR_TRIAL_BOUND */
+#define FACTOR_TRIAL_BOUND (1ul << 20)
+
+/* rho accumulates FACTOR_RHO_BATCH differences before single gcd */
+#define FACTOR_RHO_BATCH 128
+
+/* rho finds factor q in about sqrt(q) steps, bigger factors are left for ECM */
+#define FACTOR_RHO_STEPS (1ull << 18)
+
+/* Miller - Rabin rounds after BPSW in mpz_probab_prime_p */
+#define FACTOR_PRIME_REPS 25
+
+/* BPSW has no pseudoprime below 2^64 */
+#define FACTOR_BPSW_BITS 64
+
+/* Pocklington proof of n needs proofs of primes of n - 1, so depth is limited */
+#define FACTOR_PROOF_DEPTH 16
+
+/* bases a = 2, 3, ... tried by Pocklington for every prime q | F */
+#define FACTOR_PROOF_BASES 64
+
+/* curves taken from pool by one atomic operation */
+#define FACTOR_ECM_CHUNK 4
+
+/* result of cheap methods on one cofactor */
+typedef enum FACTOR_STEP
+{
+    FACTOR_STEP_PRIME,
+    FACTOR_STEP_POWER,  /* n = d^power */
+    FACTOR_STEP_SPLIT,  /* n = d * (n / d) */
+    FACTOR_STEP_HARD    /* composite, rho has not found factor */
+} factor_step_t;
+
+/* growable array of numbers with exponents, proof is used only by leaves */
+typedef struct Factor_list
+{
+    Factor *items;
+    size_t len;
+    size_t size;
+} Factor_list;
+
+static const char *const proof_names[] = {"trial", "bpsw", "pocklington", "probable", "composite"};
+static const char *const method_names[] = {"trial", "rho", "ecm", "proof"};
+
+/*
+    Push copy of number to list
+
+    PARAMS
+    @IN list - list
+    @IN num - number
+    @IN exponent - exponent of number
+    @IN proof - proof of prime, PRIME_PROOF_PROBABLE for cofactors and not proven leaves,
+                    PRIME_PROOF_COMPOSITE for cofactors which ECM has not split
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int factor_list_push(Factor_list *list, const mpz_t num, unsigned long exponent, prime_proof_t proof);
+
+/*
+    Clear all numbers and free list memory
+
+    PARAMS
+    @IN list - list
+
+    RETURN
+    This is a void function
+*/
+static void factor_list_clear(Factor_list *list);
+
+/*
+    Std compare function for Factor in array
+
+    PARAMS
+    @IN a - (void *)Factor
+    @IN b - (void *)Factor
+
+    RETURN
+    -1 iff a < b
+    1 iff a > b
+    0 iff a = b
+*/
+static int factor_cmp(const void *a, const void *b);
+
+/*
+    Divide n by all primes < FACTOR_TRIAL_BOUND
+
+    PARAMS
+    @IN / OUT n - number, after cofactor without prime factors < FACTOR_TRIAL_BOUND, 1 if rest was prime
+    @IN sieve - iterator used for primes
+    @OUT primes - found primes with exponents
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int trial_division(mpz_t n, Sieve *sieve, Factor_list *primes);
+
+/*
+    Pollard rho in Brent variant for x -> x^2 + c mod n with batched gcd
+
+    PARAMS
+    @IN n - odd composite number
+    @IN c - constant of iteration
+    @IN max_steps - walk gives up after max_steps steps
+    @OUT steps - number of done steps
+    @OUT d - nontrivial divisor of n
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure (walk cycled or gave up)
+*/
+static int rho_brent(const mpz_t n, unsigned long c, uint64_t max_steps, uint64_t *steps, mpz_t d);
+
+/*
+    Find nontrivial divisor of composite n by rho walks with constants c = 1, 2, ...
+
+    PARAMS
+    @IN n - composite number
+    @IN max_steps - steps of all walks
+    @OUT d - nontrivial divisor of n
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int rho(const mpz_t n, uint64_t max_steps, mpz_t d);
+
+/*
+    Find exponent k > 1 with n = d^k
+
+    PARAMS
+    @IN n - number
+    @OUT d - root
+
+    RETURN
+    0 iff n is not perfect power
+    k iff n = d^k
+*/
+static unsigned long perfect_power(const mpz_t n, mpz_t d);
+
+/*
+    Try cheap methods on cofactor: primality test, perfect power, rho
+
+    PARAMS
+    @IN n - cofactor without prime factors < FACTOR_TRIAL_BOUND
+    @OUT d - root or divisor of n
+    @OUT power - exponent of root
+    @OUT time - time of every method is added here
+
+    RETURN
+    Result of methods
+*/
+static factor_step_t factor_cheap(const mpz_t n, mpz_t d, unsigned long *power, double *time);
+
+/*
+    Take all cofactors from queue and try cheap methods on them in parallel,
+    parts of split cofactors go back to queue
+
+    PARAMS
+    @IN queue - composite cofactors
+    @OUT leaves - probable primes
+    @OUT hard - cofactors for ECM
+    @IN f - factorization with times and counters
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int factor_round(Factor_list *queue, Factor_list *leaves, Factor_list *hard, Factorization *f);
+
+/*
+    Run curves in parallel until some curve finds non trivial factor of n or ecm->budget curves were tried.
+    Threads take chunks of curve indices from shared counter without locks, B1 grows with curve index.
+    First thread with factor publishes it and sets shared flag, other threads stop curves in flight
+
+    PARAMS
+    @IN n - composite number, not perfect power
+    @IN ecm - ECM settings
+    @OUT factor - non trivial factor of n
+    @OUT curves - number of tried curves
+
+    RETURN
+    0 iff factor was found
+    Non-zero value iff budget of curves was spent
+*/
+static int factor_ecm(const mpz_t n, const Factor_ecm *ecm, mpz_t factor, unsigned long *curves);
+
+/*
+    Prove primality of probable prime n
+
+    PARAMS
+    @IN n - probable prime
+    @IN sieve - iterator used for trial division of n - 1
+    @IN depth - depth of recursion
+
+    RETURN
+    PRIME_PROOF_PROBABLE iff proof was not found
+    Proof iff success
+*/
+static prime_proof_t prime_prove(const mpz_t n, Sieve *sieve, unsigned int depth);
+
+/*
+    Prove all not proven leaves in parallel
+
+    PARAMS
+    @IN leaves - primes
+    @IN f - factorization with times and counters
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int factor_prove(Factor_list *leaves, Factorization *f);
+
+/*
+    Sort leaves and merge equal primes into factorization
+
+    PARAMS
+    @IN leaves - primes with exponents
+    @OUT f - factorization
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int factor_collect(Factor_list *leaves, Factorization *f);
+
+static int factor_list_push(Factor_list *list, const mpz_t num, unsigned long exponent, prime_proof_t proof)
+{
+    Factor *items;
+
+    if (list->len == list->size)
+    {
+        list->size = list->size == 0 ? 8 : list->size << 1;
+        items = (Factor *)realloc(list->items, sizeof(Factor) * list->size);
+        if (items == NULL)
+            ERROR("realloc error\n", 1);
+
+        list->items = items;
+    }
+
+    mpz_init_set(list->items[list->len].prime, num);
+    list->items[list->len].exponent = exponent;
+    list->items[list->len].proof = proof;
+    ++list->len;
+
+    return 0;
+}
+
+static void factor_list_clear(Factor_list *list)
+{
+    size_t i;
+
+    for (i = 0; i < list->len; ++i)
+        mpz_clear(list->items[i].prime);
+
+    FREE(list->items);
+    list->len = 0;
+    list->size = 0;
+}
+
+static int factor_cmp(const void *a, const void *b)
+{
+    return mpz_cmp(((const Factor *)a)->prime, ((const Factor *)b)->prime);
+}
+
+static int trial_division(mpz_t n, Sieve *sieve, Factor_list *primes)
+{
+    mpz_t prime;
+    uint64_t p;
+    unsigned long exponent;
+    int ret = 0;
+
+    TRACE();
+
+    if (sieve_reset(sieve, 2, FACTOR_TRIAL_BOUND))
+        ERROR("sieve_reset error\n", 1);
+
+    mpz_init(prime);
+
+    /* primes < p are tried, so n < p^2 is prime */
+    while ((p = sieve_next(sieve)) != 0 && mpz_cmp_ui(n, (unsigned long)(p * p)) >= 0)
+    {
+        if (!mpz_divisible_ui_p(n, (unsigned long)p))
+            continue;
+
+        exponent = 0;
+        do
+        {
+            mpz_divexact_ui(n, n, (unsigned long)p);
+            ++exponent;
+        } while (mpz_divisible_ui_p(n, (unsigned long)p));
+
+        mpz_set_ui(prime, (unsigned long)p);
+        if (factor_list_push(primes, prime, exponent, PRIME_PROOF_TRIAL))
+        {
+            ret = 1;
+            break;
+        }
+    }
+
+    if (ret == 0 && mpz_cmp_ui(n, 1) > 0 && (p != 0 || mpz_cmp_ui(n, FACTOR_TRIAL_BOUND * FACTOR_TRIAL_BOUND) < 0))
+    {
+        ret = factor_list_push(primes, n, 1, PRIME_PROOF_TRIAL);
+        mpz_set_ui(n, 1);
+    }
+
+    mpz_clear(prime);
+
+    if (ret)
+        ERROR("factor_list_push error\n", 1);
+
+    return 0;
+}
+
+static int rho_brent(const mpz_t n, unsigned long c, uint64_t max_steps, uint64_t *steps, mpz_t d)
+{
+    mpz_t x;
+    mpz_t y;
+    mpz_t ys;
+    mpz_t q;
+    mpz_t diff;
+
+    uint64_t r;
+    uint64_t k;
+    uint64_t i;
+    uint64_t batch;
+
+    bool done = false;
+    int ret = 0;
+
+    mpz_init(x);
+    mpz_init(ys);
+    mpz_init(diff);
+    mpz_init_set_ui(y, 2);
+    mpz_init_set_ui(q, 1);
+
+    mpz_set_ui(d, 1);
+    *steps = 0;
+
+    /* walk doubles its power of 2 checkpoint r, differences y - x are multiplied and gcd is taken once per batch */
+    for (r = 1; mpz_cmp_ui(d, 1) == 0 && !done; r <<= 1)
+    {
+        mpz_set(x, y);
+        for (i = 0; i < r; ++i)
+        {
+            mpz_mul(y, y, y);
+            mpz_add_ui(y, y, c);
+            mpz_mod(y, y, n);
+        }
+        *steps += r;
+
+        for (k = 0; k < r && mpz_cmp_ui(d, 1) == 0; k += batch)
+        {
+            mpz_set(ys, y);
+            batch = MIN(FACTOR_RHO_BATCH, r - k);
+            for (i = 0; i < batch; ++i)
+            {
+                mpz_mul(y, y, y);
+                mpz_add_ui(y, y, c);
+                mpz_mod(y, y, n);
+
+                mpz_sub(diff, x, y);
+                mpz_mul(q, q, diff);
+                mpz_mod(q, q, n);
+            }
+
+            mpz_gcd(d, q, n);
+            *steps += batch;
+
+            if (mpz_cmp_ui(d, 1) == 0 && *steps > max_steps)
+            {
+                done = true;
+                break;
+            }
+        }
+    }
+
+    /* product has hit all factors at once, repeat last batch step by step */
+    if (!done && mpz_cmp(d, n) == 0)
+        do
+        {
+            mpz_mul(ys, ys, ys);
+            mpz_add_ui(ys, ys, c);
+            mpz_mod(ys, ys, n);
+
+            mpz_sub(diff, x, ys);
+            mpz_gcd(d, diff, n);
+        } while (mpz_cmp_ui(d, 1) == 0);
+
+    if (done || mpz_cmp(d, n) == 0 || mpz_cmp_ui(d, 1) == 0)
+        ret = 1;
+
+    mpz_clear(x);
+    mpz_clear(y);
+    mpz_clear(ys);
+    mpz_clear(q);
+    mpz_clear(diff);
+
+    return ret;
+}
+
+static int rho(const mpz_t n, uint64_t max_steps, mpz_t d)
+{
+    unsigned long c;
+    uint64_t steps;
+    uint64_t total = 0;
+
+    TRACE();
+
+    /* even n is handled by trial division, but be safe */
+    if (mpz_even_p(n))
+    {
+        mpz_set_ui(d, 2);
+        return 0;
+    }
+
+    /* walk that has cycled without factor is restarted with next constant */
+    for (c = 1; total < max_steps; ++c)
+    {
+        if (rho_brent(n, c, max_steps - total, &steps, d) == 0)
+            return 0;
+
+        total += steps;
+    }
+
+    return 1;
+}
+
+static unsigned long perfect_power(const mpz_t n, mpz_t d)
+{
+    unsigned long k;
+    const unsigned long bits = (unsigned long)mpz_sizeinbase(n, 2);
+
+    if (!mpz_perfect_power_p(n))
+        return 0;
+
+    /* the smallest k gives the biggest root, root can be power again and is split in next round */
+    for (k = 2; k <= bits; ++k)
+        if (mpz_root(d, n, k))
+            return k;
+
+    return 0;
+}
+
+static factor_step_t factor_cheap(const mpz_t n, mpz_t d, unsigned long *power, double *time)
+{
+    double start;
+    bool prime;
+    int ret;
+
+    start = omp_get_wtime();
+    prime = mpz_probab_prime_p(n, FACTOR_PRIME_REPS) != 0;
+    time[FACTOR_METHOD_PROOF] += omp_get_wtime() - start;
+
+    if (prime)
+        return FACTOR_STEP_PRIME;
+
+    *power = perfect_power(n, d);
+    if (*power > 1)
+        return FACTOR_STEP_POWER;
+
+    start = omp_get_wtime();
+    ret = rho(n, FACTOR_RHO_STEPS, d);
+    time[FACTOR_METHOD_RHO] += omp_get_wtime() - start;
+
+    return ret == 0 ? FACTOR_STEP_SPLIT : FACTOR_STEP_HARD;
+}
+
+static int factor_round(Factor_list *queue, Factor_list *leaves, Factor_list *hard, Factorization *f)
+{
+    Factor_list round = *queue;
+    mpz_t d;
+    mpz_t rest;
+
+    double time[FACTOR_METHODS];
+    factor_step_t step;
+    unsigned long power;
+    size_t i;
+    size_t j;
+    int ret = 0;
+
+    TRACE();
+
+    /* queue gets parts of split cofactors of this round */
+    queue->items = NULL;
+    queue->len = 0;
+    queue->size = 0;
+
+#pragma omp parallel for private(d, rest, time, step, power, j) shared(round, queue, leaves, hard, f) reduction(|:ret) schedule(dynamic)
+    for (i = 0; i < round.len; ++i)
+    {
+        mpz_init(d);
+        mpz_init(rest);
+        for (j = 0; j < FACTOR_METHODS; ++j)
+            time[j] = 0.0;
+
+        step = factor_cheap(round.items[i].prime, d, &power, time);
+
+#pragma omp critical
+        {
+            for (j = 0; j < FACTOR_METHODS; ++j)
+                f->time[j] += time[j];
+
+            switch (step)
+            {
+                case FACTOR_STEP_PRIME:
+                    ret |= factor_list_push(leaves, round.items[i].prime, round.items[i].exponent, PRIME_PROOF_PROBABLE);
+                    break;
+                case FACTOR_STEP_POWER:
+                    ret |= factor_list_push(queue, d, round.items[i].exponent * power, PRIME_PROOF_PROBABLE);
+                    break;
+                case FACTOR_STEP_SPLIT:
+                    ++f->found[FACTOR_METHOD_RHO];
+                    mpz_divexact(rest, round.items[i].prime, d);
+                    ret |= factor_list_push(queue, d, round.items[i].exponent, PRIME_PROOF_PROBABLE);
+                    ret |= factor_list_push(queue, rest, round.items[i].exponent, PRIME_PROOF_PROBABLE);
+                    break;
+                case FACTOR_STEP_HARD:
+                    ret |= factor_list_push(hard, round.items[i].prime, round.items[i].exponent, PRIME_PROOF_PROBABLE);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        mpz_clear(d);
+        mpz_clear(rest);
+    }
+
+    factor_list_clear(&round);
+
+    if (ret)
+        ERROR("factor_list_push error\n", 1);
+
+    return 0;
+}
+
+static int factor_ecm(const mpz_t n, const Factor_ecm *ecm, mpz_t factor, unsigned long *curves)
+{
+    mpz_t local;
+    const Ecm_plan *plan;
+    Ecm_workspace *ws;
+
+    uint64_t sigma;
+    unsigned long next = 0;
+    unsigned long calls = 0;
+    unsigned long limit;
+    unsigned long first;
+    unsigned long tried;
+    unsigned long i;
+    size_t level;
+    bool found = false;
+    bool done;
+
+    TRACE();
+
+    /* batch call is many curves, budget is rounded up to whole calls */
+    limit = ecm->budget == 0 ? ULONG_MAX - FACTOR_ECM_CHUNK : (ecm->budget + lenstra_ecm_curves(ecm->curve) - 1) / lenstra_ecm_curves(ecm->curve);
+
+#pragma omp parallel private(local, plan, ws, sigma, first, tried, i, level, done) shared(ecm, next, found, n, factor, limit) reduction(+:calls)
+    {
+        /* one workspace per thread and cofactor, n is constant during ECM */
+        mpz_init(local);
+        ws = ecm_workspace_create(n, ecm->curve);
+        if (ws == NULL)
+            FATAL("ecm_workspace_create error\n");
+
+        for (level = 0; level < ecm->plans_len; ++level)
+            if (ecm_workspace_reserve(ws, ecm->plans[level]))
+                FATAL("ecm_workspace_reserve error\n");
+
+        done = false;
+
+        while (!done)
+        {
+#pragma omp atomic capture
+            {
+                first = next;
+                next += FACTOR_ECM_CHUNK;
+            }
+
+            /* pool is empty, curves in flight of other threads still can find factor */
+            if (first >= limit)
+                break;
+
+            for (i = first; i < MIN(first + FACTOR_ECM_CHUNK, limit) && !done; ++i)
+            {
+                /* batch call is many curves, so level depends on curves tried before */
+                tried = i * lenstra_ecm_curves(ecm->curve);
+                for (level = 0; level + 1 < ecm->plans_len && tried >= ecm->curves[level]; ++level)
+                    ;
+
+                plan = ecm->plans[level];
+
+                ++calls;
+                sigma = lenstra_ecm_sigma(ecm->seed, i);
+                if (lenstra_ecm(ws, plan, sigma, &found, local) == 0 && mpz_cmp_ui(local, 1) > 0 && mpz_cmp(local, n) < 0)
+                {
+#pragma omp critical
+                    {
+                        if (!found)
+                        {
+                            /* enough to run this curve again by replay mode, B2 = 0 for models without stage 2 */
+                            (void)printf("CURVE: %s, B1 = %" PRIu32 ", B2 = %" PRIu64 ", SIGMA = %" PRIu64 "\n",
+                                         ecm->name, plan->b1, lenstra_ecm_stage2(ecm->curve) ? plan->b2 : 0, sigma);
+                            mpz_set(factor, local);
+#pragma omp atomic write
+                            found = true;
+                        }
+                    }
+                }
+
+#pragma omp atomic read
+                done = found;
+            }
+        }
+
+        ecm_workspace_destroy(ws);
+        mpz_clear(local);
+    }
+
+    *curves = calls * lenstra_ecm_curves(ecm->curve);
+
+    return found ? 0 : 1;
+}
+
+static prime_proof_t prime_prove(const mpz_t n, Sieve *sieve, unsigned int depth)
+{
+    Factor_list parts = {NULL, 0, 0};
+    Factor_list qs = {NULL, 0, 0};
+    mpz_t m;
+    mpz_t rest;
+    mpz_t f;
+    mpz_t q;
+    mpz_t d;
+    mpz_t t;
+
+    uint64_t p;
+    unsigned long a;
+    size_t i;
+    prime_proof_t proof = PRIME_PROOF_PROBABLE;
+    bool enough = false;
+    int ret = 0;
+
+    if (mpz_sizeinbase(n, 2) <= FACTOR_BPSW_BITS)
+        return PRIME_PROOF_BPSW;
+
+    if (depth >= FACTOR_PROOF_DEPTH || sieve_reset(sieve, 2, FACTOR_TRIAL_BOUND))
+        return PRIME_PROOF_PROBABLE;
+
+    mpz_init(m);
+    mpz_init(rest);
+    mpz_init(f);
+    mpz_init(q);
+    mpz_init(d);
+    mpz_init(t);
+
+    /* m = n - 1 = f * rest, f has only proven prime factors qs */
+    mpz_sub_ui(m, n, 1);
+    mpz_set(rest, m);
+    while (ret == 0 && (p = sieve_next(sieve)) != 0)
+        if (mpz_divisible_ui_p(rest, (unsigned long)p))
+        {
+            mpz_set_ui(q, (unsigned long)p);
+            mpz_remove(rest, rest, q);
+            ret = factor_list_push(&qs, q, 1, PRIME_PROOF_TRIAL);
+        }
+
+    if (ret == 0 && mpz_cmp_ui(rest, 1) > 0)
+        ret = factor_list_push(&parts, rest, 1, PRIME_PROOF_PROBABLE);
+
+    /* Pocklington needs f > sqrt(n), so rest is split only until f is big enough */
+    while (ret == 0)
+    {
+        mpz_divexact(f, m, rest);
+        mpz_mul(t, f, f);
+        enough = mpz_cmp(t, n) > 0;
+        if (enough || parts.len == 0)
+            break;
+
+        --parts.len;
+        mpz_swap(q, parts.items[parts.len].prime);
+        mpz_clear(parts.items[parts.len].prime);
+
+        if (mpz_probab_prime_p(q, FACTOR_PRIME_REPS))
+        {
+            /* prime without proof stays in rest */
+            if (prime_prove(q, sieve, depth + 1) != PRIME_PROOF_PROBABLE)
+            {
+                mpz_remove(rest, rest, q);
+                ret = factor_list_push(&qs, q, 1, PRIME_PROOF_PROBABLE);
+            }
+
+            continue;
+        }
+
+        if (rho(q, FACTOR_RHO_STEPS, d) == 0)
+        {
+            mpz_divexact(q, q, d);
+            ret = factor_list_push(&parts, d, 1, PRIME_PROOF_PROBABLE) || factor_list_push(&parts, q, 1, PRIME_PROOF_PROBABLE);
+        }
+    }
+
+    /* every prime factor of n is 1 mod f, so n is prime */
+    for (i = 0; ret == 0 && enough && i < qs.len; ++i)
+    {
+        mpz_divexact(d, m, qs.items[i].prime);
+        for (a = 2; a < 2 + FACTOR_PROOF_BASES; ++a)
+        {
+            mpz_set_ui(q, a);
+            mpz_powm(t, q, m, n);
+            if (mpz_cmp_ui(t, 1) != 0)
+            {
+                enough = false;
+                break;
+            }
+
+            mpz_powm(t, q, d, n);
+            mpz_sub_ui(t, t, 1);
+            mpz_gcd(t, t, n);
+            if (mpz_cmp_ui(t, 1) == 0)
+                break;
+        }
+
+        if (a == 2 + FACTOR_PROOF_BASES)
+            enough = false;
+    }
+
+    if (ret == 0 && enough)
+        proof = PRIME_PROOF_POCKLINGTON;
+
+    factor_list_clear(&parts);
+    factor_list_clear(&qs);
+    mpz_clear(m);
+    mpz_clear(rest);
+    mpz_clear(f);
+    mpz_clear(q);
+    mpz_clear(d);
+    mpz_clear(t);
+
+    return proof;
+}
+
+static int factor_prove(Factor_list *leaves, Factorization *f)
+{
+    Sieve *sieve;
+    double start;
+    size_t i;
+    int ret = 0;
+
+    TRACE();
+
+#pragma omp parallel private(sieve, start, i) shared(leaves, f) reduction(|:ret)
+    {
+        /* trial division of n - 1 by one thread */
+        sieve = sieve_create(0, 0, 1);
+        if (sieve == NULL)
+            ret = 1;
+
+#pragma omp for schedule(dynamic)
+        for (i = 0; i < leaves->len; ++i)
+        {
+            if (sieve == NULL || leaves->items[i].proof != PRIME_PROOF_PROBABLE)
+                continue;
+
+            start = omp_get_wtime();
+            leaves->items[i].proof = prime_prove(leaves->items[i].prime, sieve, 0);
+
+#pragma omp critical
+            {
+                f->time[FACTOR_METHOD_PROOF] += omp_get_wtime() - start;
+                if (leaves->items[i].proof != PRIME_PROOF_PROBABLE)
+                    ++f->found[FACTOR_METHOD_PROOF];
+            }
+        }
+
+        sieve_destroy(sieve);
+    }
+
+    if (ret)
+        ERROR("sieve_create error\n", 1);
+
+    return 0;
+}
+
+static int factor_collect(Factor_list *leaves, Factorization *f)
+{
+    size_t i;
+    size_t j;
+
+    TRACE();
+
+    /* ascending primes, the same prime can come from different cofactors */
+    qsort(leaves->items, leaves->len, sizeof(Factor), factor_cmp);
+
+    f->len = 0;
+    for (i = 0; i < leaves->len; ++i)
+        if (i == 0 || mpz_cmp(leaves->items[i].prime, leaves->items[i - 1].prime))
+            ++f->len;
+
+    f->factors = (Factor *)malloc(sizeof(Factor) * f->len);
+    if (f->factors == NULL)
+        ERROR("malloc error\n", 1);
+
+    for (i = 0, j = 0; i < leaves->len; ++i)
+    {
+        if (i > 0 && mpz_cmp(leaves->items[i].prime, leaves->items[i - 1].prime) == 0)
+        {
+            f->factors[j - 1].exponent += leaves->items[i].exponent;
+            f->factors[j - 1].proof = MIN(f->factors[j - 1].proof, leaves->items[i].proof);
+            continue;
+        }
+
+        mpz_init_set(f->factors[j].prime, leaves->items[i].prime);
+        f->factors[j].exponent = leaves->items[i].exponent;
+        f->factors[j].proof = leaves->items[i].proof;
+        ++j;
+    }
+
+    return 0;
+}
+
+Factorization *factorize(const mpz_t n, const Factor_ecm *ecm)
+{
+    Factorization *f;
+    Factor_list leaves = {NULL, 0, 0};
+    Factor_list queue = {NULL, 0, 0};
+    Factor_list hard = {NULL, 0, 0};
+    Sieve *sieve;
+    mpz_t cofactor;
+    mpz_t factor;
+
+    double start;
+    unsigned long curves;
+    unsigned long exponent;
+    int threads;
+    int failed;
+    int ret = 0;
+
+    TRACE();
+
+    if (mpz_cmp_ui(n, 1) <= 0)
+        ERROR("n must be greater than 1\n", NULL);
+
+    f = (Factorization *)calloc(1, sizeof(Factorization));
+    if (f == NULL)
+        ERROR("calloc error\n", NULL);
+
+    sieve = sieve_create(0, 0, 0);
+    if (sieve == NULL)
+    {
+        FREE(f);
+        ERROR("sieve_create error\n", NULL);
+    }
+
+    mpz_init_set(cofactor, n);
+    mpz_init(factor);
+
+    start = omp_get_wtime();
+    ret = trial_division(cofactor, sieve, &leaves);
+    f->time[FACTOR_METHOD_TRIAL] += omp_get_wtime() - start;
+    f->found[FACTOR_METHOD_TRIAL] = leaves.len;
+
+    if (ret == 0 && mpz_cmp_ui(cofactor, 1) > 0)
+        ret = factor_list_push(&queue, cofactor, 1, PRIME_PROOF_PROBABLE);
+
+    /* cheap methods on all queued cofactors, ECM only when queue is empty */
+    while (ret == 0 && (queue.len > 0 || hard.len > 0))
+    {
+        if (queue.len > 0)
+        {
+            ret = factor_round(&queue, &leaves, &hard, f);
+            continue;
+        }
+
+        --hard.len;
+        mpz_swap(cofactor, hard.items[hard.len].prime);
+        mpz_clear(hard.items[hard.len].prime);
+        exponent = hard.items[hard.len].exponent;
+
+        /* every thread runs curves all the time */
+        threads = omp_get_max_threads();
+        start = omp_get_wtime();
+        failed = factor_ecm(cofactor, ecm, factor, &curves);
+        f->time[FACTOR_METHOD_ECM] += (omp_get_wtime() - start) * threads;
+
+        /* budget is spent, cofactor is reported as composite without proof */
+        if (failed)
+        {
+            LOG("No factor found after %lu curves\n", curves);
+            ret = factor_list_push(&leaves, cofactor, exponent, PRIME_PROOF_COMPOSITE);
+            continue;
+        }
+
+        ++f->found[FACTOR_METHOD_ECM];
+        LOG("Factor found after %lu curves\n", curves);
+
+        mpz_divexact(cofactor, cofactor, factor);
+        ret = factor_list_push(&queue, factor, exponent, PRIME_PROOF_PROBABLE) ||
+              factor_list_push(&queue, cofactor, exponent, PRIME_PROOF_PROBABLE);
+    }
+
+    if (ret == 0)
+        ret = factor_prove(&leaves, f);
+
+    if (ret == 0)
+        ret = factor_collect(&leaves, f);
+
+    factor_list_clear(&leaves);
+    factor_list_clear(&queue);
+    factor_list_clear(&hard);
+    sieve_destroy(sieve);
+    mpz_clear(cofactor);
+    mpz_clear(factor);
+
+    if (ret)
+    {
+        factorization_destroy(f);
+        ERROR("factorize error\n", NULL);
+    }
+
+    return f;
+}
+
+void factorization_destroy(Factorization *f)
+{
+    size_t i;
+
+    TRACE();
+
+    if (f == NULL)
+        return;
+
+    for (i = 0; i < f->len; ++i)
+        mpz_clear(f->factors[i].prime);
+
+    FREE(f->factors);
+    FREE(f);
+}
+
+const char *prime_proof_name(prime_proof_t proof)
+{
+    return (size_t)proof < ARRAY_SIZE(proof_names) ? proof_names[proof] : "unknown";
+}
+
+const char *factor_method_name(factor_method_t method)
+{
+    return (size_t)method < ARRAY_SIZE(method_names) ? method_names[method] : "unknown";
+}
@@ -1,9 +1,9 @@
 #include <ecm.h>
+#include <factor.h>
 #include <stdio.h>
 #include <gmp.h>
 #include <compiler.h>
 #include <log.h>
-#include <darray.h>
 #include <string.h>
 #include <common.h>
 #include <time.h>
@@ -12,8 +12,107 @@
 
 #define BASE 10
 
+#define MODE_BENCH "bench"
+#define MODE_REPLAY "replay"
+
+/* default B2 = ECM_B2_RATIO * B1 */
+#define ECM_B2_RATIO 50
+
+/* default number of curves per cofactor, then cofactor is reported as composite */
+#define ECM_BUDGET 2000
+
+#define CURVE_WEIERSTRASS "weierstrass"
+#define CURVE_MONTGOMERY "montgomery"
+#define CURVE_EDWARDS "edwards"
+#define CURVE_BATCH "batch"
+
+/* names of ecm_curve_t */
+static const char *const curve_names[] = {CURVE_WEIERSTRASS, CURVE_MONTGOMERY, CURVE_EDWARDS, CURVE_BATCH};
+
+/* allocations done by GMP, counted only in bench */
+static unsigned long gmp_allocs;
+
+/* B1 grows with number of tried curves, ecm_limits[i] is used until ecm_curves[i] curves were tried */
+static const uint32_t ecm_limits[] = {5000, 10000, 50000, 100000};
+static const unsigned long ecm_curves[] = {10, 50, 100};
+
 static int help(void);
 
+/*
+    Parse curve model name
+
+    PARAMS
+    @IN str - name of curve
+    @OUT curve - curve model
+
+    RETURN
+    0 iff success
+    Non-zero value iff name is unknown
+*/
+static int parse_curve(const char *str, ecm_curve_t *curve);
+
+/*
+    Run given number of curves on n and report curves per second and factors per CPU hour
+
+    PARAMS
+    @IN argc - argc from main
+    @IN argv - argv from main: bench curve B1 curves n [B2] [seed]
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int ecm_bench(int argc, char **argv);
+
+/*
+    GMP allocation functions which count allocations for bench
+
+    PARAMS
+    @IN size - size of new block
+
+    RETURN
+    Pointer to new block
+*/
+static void *bench_alloc(size_t size);
+
+/*
+    GMP reallocation function which counts reallocations for bench
+
+    PARAMS
+    @IN ptr - block
+    @IN old_size - size of block
+    @IN new_size - new size of block
+
+    RETURN
+    Pointer to new block
+*/
+static void *bench_realloc(void *ptr, size_t old_size, size_t new_size);
+
+/*
+    GMP free function for bench
+
+    PARAMS
+    @IN ptr - block
+    @IN size - size of block
+
+    RETURN
+    This is a void function
+*/
+static void bench_free(void *ptr, size_t size);
+
+/*
+    Run again one curve which found factor
+
+    PARAMS
+    @IN argc - argc from main
+    @IN argv - argv from main: replay curve B1 B2 sigma n
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int ecm_replay(int argc, char **argv);
+
 ___before_main___(1) void init(void);
 ___after_main___(1) void deinit(void);
 
@@ -32,121 +131,269 @@ static int help(void)
     (void)printf("Program to factor number\n"
                  "NEED 1 argument\n"
                  "n - number to factor\n"
-                 "Output factors of n\n");
+                 "[%s|%s|%s|%s] - optional curve model, default %s\n"
+                 "[B2 / B1] - optional stage 2 bound, default %d, 0 means only stage 1\n"
+                 "[seed] - optional seed of curve parameters, default time\n"
+                 "[curves] - optional number of curves per cofactor, default %d, 0 means no limit\n"
+                 "Output prime factorization of n with primality proofs, time of every method\n"
+                 "and parameters of curves which found factors\n\n"
+                 "Curves per second: " MODE_BENCH " curve B1 curves n [B2] [seed]\n"
+                 "Run again curve which found factor: " MODE_REPLAY " curve B1 B2 sigma n\n"
+                 "%s runs %zu affine curves in lockstep with one inversion per step\n",
+                 CURVE_WEIERSTRASS, CURVE_MONTGOMERY, CURVE_EDWARDS, CURVE_BATCH, CURVE_MONTGOMERY, ECM_B2_RATIO, ECM_BUDGET,
+                 CURVE_BATCH, lenstra_ecm_curves(ECM_CURVE_BATCH));
 
     return 0;
 }
 
-static Darray *sieve(uint32_t n)
+static int parse_curve(const char *str, ecm_curve_t *curve)
 {
-    Darray *primes;
-    uint32_t *sieve_array;
-
-    const size_t sieve_size = n + 1;
     size_t i;
-    size_t j;
-    uint32_t temp;
 
-    TRACE();
+    for (i = 0; i < ARRAY_SIZE(curve_names); ++i)
+        if (strcmp(str, curve_names[i]) == 0)
+        {
+            *curve = (ecm_curve_t)i;
+            return 0;
+        }
 
-    primes = darray_create(DARRAY_UNSORTED, 0, sizeof(uint32_t), NULL, NULL);
-    if (primes == NULL)
-        ERROR("darray_create error\n", NULL);
+    return 1;
+}
 
-    sieve_array = (uint32_t *)malloc(sizeof(uint32_t) * sieve_size);
-    if (sieve_array == NULL)
-        ERROR("malloc error\n", NULL);
+static void *bench_alloc(size_t size)
+{
+    void *ptr;
 
-    (void)memset(sieve_array, 0, sizeof(uint32_t) * sieve_size);
-    sieve_array[0] = 1;
-    sieve_array[1] = 1;
+#pragma omp atomic
+    ++gmp_allocs;
 
-    for (i = 2; i < sieve_size; ++i)
-        if (sieve_array[i] == 0)
-        {
-            temp = (uint32_t)i;
-            darray_insert(primes, (const void *)&temp);
-            for (j = i; j < sieve_size; j += i)
-                sieve_array[j] = 1;
-        }
+    ptr = malloc(size);
+    if (ptr == NULL)
+        FATAL("malloc error\n");
 
-    FREE(sieve_array);
-    return primes;
+    return ptr;
 }
 
+static void *bench_realloc(void *ptr, size_t old_size, size_t new_size)
+{
+    (void)old_size;
 
-int main(int argc, char **argv)
+#pragma omp atomic
+    ++gmp_allocs;
+
+    ptr = realloc(ptr, new_size);
+    if (ptr == NULL)
+        FATAL("realloc error\n");
+
+    return ptr;
+}
+
+static void bench_free(void *ptr, size_t size)
+{
+    (void)size;
+
+    FREE(ptr);
+}
+
+static int ecm_bench(int argc, char **argv)
 {
     mpz_t n;
     mpz_t factor;
-    mpz_t temp;
-    Darray *primes;
+    Ecm_plan *plan;
+    Ecm_workspace *ws;
+    ecm_curve_t curve;
 
-    uint32_t limit = 100000;
-    uint32_t counter;
+    uint32_t limit;
+    uint64_t limit2 = 0;
+    uint64_t seed = 0;
+    unsigned long curves;
+    unsigned long calls;
+    unsigned long found = 0;
+    unsigned long i;
+    unsigned long allocs;
+    double elapsed;
+    clock_t cpu;
 
-    if (argc < 2)
+    /* bench runs every curve to the end */
+    bool cancel = false;
+
+    if (argc < 6 || parse_curve(argv[2], &curve))
         return help();
 
-    mpz_init(n);
-    mpz_set_str(n, argv[1], BASE);
+    mp_set_memory_functions(bench_alloc, bench_realloc, bench_free);
+
+    limit = (uint32_t)strtoul(argv[3], NULL, BASE);
+    curves = strtoul(argv[4], NULL, BASE);
+    mpz_init_set_str(n, argv[5], BASE);
+
+    /* batch model tries many curves per call */
+    calls = (curves + lenstra_ecm_curves(curve) - 1) / lenstra_ecm_curves(curve);
+    curves = calls * lenstra_ecm_curves(curve);
+    if (argc > 6)
+        limit2 = strtoull(argv[6], NULL, BASE);
 
-    srand((unsigned int)time(NULL));
+    if (argc > 7)
+        seed = strtoull(argv[7], NULL, BASE);
 
-    gmp_printf("Trying to factor %Zd\n", n);
-    if (mpz_probab_prime_p(n, 10) > 0)
+    plan = ecm_plan_create(limit, limit2);
+    if (plan == NULL)
+        FATAL("ecm_plan_create error\n");
+
+    elapsed = omp_get_wtime();
+    cpu = clock();
+
+#pragma omp parallel private(factor, ws) shared(cancel, n, plan, curve, seed, calls) reduction(+:found)
     {
-        gmp_printf("%Zd is prime\n", n);
-        mpz_clear(n);
+        mpz_init(factor);
+        ws = ecm_workspace_create(n, curve);
+        if (ws == NULL || ecm_workspace_reserve(ws, plan))
+            FATAL("ecm_workspace_create error\n");
+
+        /* count only allocations of curves, not of workspaces */
+#pragma omp barrier
+#pragma omp single
+        gmp_allocs = 0;
+
+#pragma omp for schedule(dynamic)
+        for (i = 0; i < calls; ++i)
+            if (lenstra_ecm(ws, plan, lenstra_ecm_sigma(seed, i), &cancel, factor) == 0)
+                ++found;
+
+        ecm_workspace_destroy(ws);
         mpz_clear(factor);
+    }
+
+    elapsed = omp_get_wtime() - elapsed;
+    cpu = clock() - cpu;
+    allocs = gmp_allocs;
+
+    (void)printf("CURVE = %s, B1 = %" PRIu32 ", B2 = %" PRIu64 ", CURVES = %lu, FOUND = %lu, TIME = %lf [s], CURVES / s = %lf, FACTORS / CPU h = %lf, ALLOCS / CURVE = %lf\n",
+                 argv[2], limit, lenstra_ecm_stage2(curve) ? plan->b2 : 0, curves, found, elapsed, (double)curves / elapsed,
+                 (double)found * 3600.0 * CLOCKS_PER_SEC / (double)MAX(cpu, 1), (double)allocs / (double)curves);
+
+    ecm_plan_destroy(plan);
+    mpz_clear(n);
+
+    return 0;
+}
 
-        return 0;
+static int ecm_replay(int argc, char **argv)
+{
+    mpz_t n;
+    mpz_t factor;
+    Ecm_plan *plan;
+    Ecm_workspace *ws;
+    ecm_curve_t curve;
+
+    uint32_t limit;
+    uint64_t limit2;
+    uint64_t sigma;
+    bool cancel = false;
+
+    if (argc < 7 || parse_curve(argv[2], &curve))
+        return help();
+
+    limit = (uint32_t)strtoul(argv[3], NULL, BASE);
+    limit2 = strtoull(argv[4], NULL, BASE);
+    sigma = strtoull(argv[5], NULL, BASE);
+    mpz_init_set_str(n, argv[6], BASE);
+    mpz_init(factor);
+
+    plan = ecm_plan_create(limit, limit2);
+    if (plan == NULL)
+        FATAL("ecm_plan_create error\n");
+
+    ws = ecm_workspace_create(n, curve);
+    if (ws == NULL || ecm_workspace_reserve(ws, plan))
+        FATAL("ecm_workspace_create error\n");
+
+    if (lenstra_ecm(ws, plan, sigma, &cancel, factor) == 0)
+        gmp_printf("FACTOR: %Zd\n", factor);
+    else
+        (void)printf("No factor\n");
+
+    ecm_workspace_destroy(ws);
+    ecm_plan_destroy(plan);
+    mpz_clear(factor);
+    mpz_clear(n);
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    mpz_t n;
+    Ecm_plan *plans[ARRAY_SIZE(ecm_limits)];
+    Factor_ecm ecm;
+    Factorization *f;
+
+    uint64_t ratio = ECM_B2_RATIO;
+    uint64_t seed;
+    unsigned long budget = ECM_BUDGET;
+    size_t i;
+    ecm_curve_t curve = ECM_CURVE_MONTGOMERY;
+
+    if (argc < 2)
+        return help();
+
+    if (strcmp(argv[1], MODE_BENCH) == 0)
+        return ecm_bench(argc, argv);
+
+    if (strcmp(argv[1], MODE_REPLAY) == 0)
+        return ecm_replay(argc, argv);
+
+    if (argc > 2 && parse_curve(argv[2], &curve))
+        return help();
+
+    if (argc > 3)
+        ratio = strtoull(argv[3], NULL, BASE);
+
+    seed = argc > 4 ? strtoull(argv[4], NULL, BASE) : (uint64_t)time(NULL);
+
+    if (argc > 5)
+        budget = strtoul(argv[5], NULL, BASE);
+
+    mpz_init(n);
+    if (mpz_set_str(n, argv[1], BASE) || mpz_cmp_ui(n, 1) <= 0)
+    {
+        mpz_clear(n);
+        return help();
     }
 
-    primes = sieve(limit);
-    if (primes == NULL)
-        FATAL("Sieve error\n");
+    gmp_printf("Trying to factor %Zd, seed = %" PRIu64 "\n", n, seed);
 
-    mpz_init(temp);
-    while (mpz_probab_prime_p(n, 10) == 0)
+    /* plans are shared by all curves, threads and cofactors */
+    for (i = 0; i < ARRAY_SIZE(ecm_limits); ++i)
     {
-        counter = 0;
-        #pragma omp parallel private(factor) shared(limit, counter, n, primes, temp)
-        {
-            mpz_init(factor);
-            mpz_set_ui(factor, 1);
-            do {
-                #pragma omp critical
-                {
-                if (counter < 10)
-                    limit = 5000;
-                else if (counter < 50)
-                    limit = 10000;
-                else if (counter < 100)
-                    limit = 50000;
-                else
-                    limit = 100000;
-
-                    ++counter;
-                    //printf("Try %" PRIu32 " B = %" PRIu32 "\n", counter, limit);
-                }
-            } while (mpz_probab_prime_p(n, 10) == 0 && lenstra_ecm(n, primes, limit, factor));
-            #pragma omp critical
-            {
-                mpz_mod(temp, n, factor);
-                if (mpz_cmp_ui(factor, 1) && mpz_cmp_ui(temp, 0) == 0 && mpz_cmp(n, factor))
-                {
-                    mpz_div(n, n, factor);
-                    gmp_printf("FACTOR: %Zd\n", factor);
-                }
-                mpz_clear(factor);
-            }
-        }
+        plans[i] = ecm_plan_create(ecm_limits[i], ecm_limits[i] * ratio);
+        if (plans[i] == NULL)
+            FATAL("ecm_plan_create error\n");
     }
 
-    gmp_printf("FACTOR = %Zd\n", n);
+    ecm.plans = plans;
+    ecm.curves = ecm_curves;
+    ecm.plans_len = ARRAY_SIZE(ecm_limits);
+    ecm.curve = curve;
+    ecm.name = curve_names[curve];
+    ecm.seed = seed;
+    ecm.budget = budget;
+
+    f = factorize(n, &ecm);
+    if (f == NULL)
+        FATAL("factorize error\n");
+
+    for (i = 0; i < f->len; ++i)
+        gmp_printf("FACTOR: %Zd, EXPONENT = %lu, PROOF = %s\n",
+                   f->factors[i].prime, f->factors[i].exponent, prime_proof_name(f->factors[i].proof));
+
+    for (i = 0; i < FACTOR_METHODS; ++i)
+        (void)printf("METHOD = %s, FOUND = %lu, TIME = %lf [s]\n",
+                     factor_method_name((factor_method_t)i), f->found[i], f->time[i]);
+
+    factorization_destroy(f);
     mpz_clear(n);
-    mpz_clear(factor);
+    for (i = 0; i < ARRAY_SIZE(ecm_limits); ++i)
+        ecm_plan_destroy(plans[i]);
 
     return 0;
-}
\ No newline at end of file
+}
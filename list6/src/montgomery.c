@@ -0,0 +1,676 @@
+#include <montgomery.h>
+#include <gmp.h>
+#include <log.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <common.h>
+
+/* curve checks cancellation every MONTGOMERY_CANCEL_OPS PRAC operations and giant steps, must be power of 2 */
+#define MONTGOMERY_CANCEL_OPS (1ul << 10)
+
+/* projective point X:Z, y is not needed by ladder */
+typedef struct Mpoint
+{
+    mpz_t x;
+    mpz_t z;
+} Mpoint;
+
+/* By^2 = x^3 + Ax^2 + x in Zn, all numbers are allocated once and reused by every curve */
+struct Mcurve
+{
+    mpz_t a24; /* (A + 2) / 4 */
+    mpz_t n;
+    mp_bitcnt_t bits;   /* size of every number, product of two residues fits without realloc */
+
+    Mpoint point;
+
+    /* ladder and PRAC state, temporaries */
+    Mpoint r[5];
+    mpz_t t[4];
+
+    /* stage 2, baby steps and pairs stream grow to the largest plan */
+    Mpoint *baby;
+    size_t babies;
+    Mpoint giant[4];
+    Ecm_pairs *pairs;
+    mpz_t acc;
+};
+
+/*
+    Init projective point
+
+    PARAMS
+    @IN p - point
+    @IN bits - size of coordinates
+
+    RETURN
+    This is a void function
+*/
+static void mpoint_init(Mpoint *p, mp_bitcnt_t bits);
+
+/*
+    Clear projective point
+
+    PARAMS
+    @IN p - point
+
+    RETURN
+    This is a void function
+*/
+static void mpoint_clear(Mpoint *p);
+
+/*
+    Set curve and its starting point from Suyama parametrization with given sigma:
+    u = sigma^2 - 5, v = 4sigma, x0 = u^3 / v^3, (A + 2) / 4 = (v - u)^3 (3u + v) / 16u^3v
+
+    PARAMS
+    @IN curve - curve
+    @IN sigma - curve parameter, sigma >= 6
+    @OUT factor - gcd(16u^3v, n) iff it is not invertible
+
+    RETURN
+    0 iff success
+    Non-zero value iff 16u^3v is not invertible mod n
+*/
+static int mcurve_set(Mcurve *curve, uint64_t sigma, mpz_t factor);
+
+/*
+    Doubling: r = 2p, r can be p
+
+    PARAMS
+    @OUT r - result
+    @IN p - point
+    @IN curve - curve
+
+    RETURN
+    This is a void function
+*/
+static void mpoint_dbl(Mpoint *r, const Mpoint *p, Mcurve *curve);
+
+/*
+    Differential addition: r = p + q, where p - q = diff, r can be p or q, but not diff
+
+    PARAMS
+    @OUT r - result
+    @IN p - first point
+    @IN q - second point
+    @IN diff - p - q
+    @IN curve - curve
+
+    RETURN
+    This is a void function
+*/
+static void mpoint_add(Mpoint *r, const Mpoint *p, const Mpoint *q, const Mpoint *diff, Mcurve *curve);
+
+/*
+    Montgomery ladder, p = k * p
+
+    PARAMS
+    @IN / OUT p - point
+    @IN k - mult
+    @IN curve - curve
+
+    RETURN
+    This is a void function
+*/
+static void montgomery_ladder(Mpoint *p, uint64_t k, Mcurve *curve);
+
+/*
+    Stage 1 by PRAC chains from plan, p = scalar * p
+
+    PARAMS
+    @IN / OUT p - point
+    @IN chain - PRAC operations (see ecm_plan.h)
+    @IN len - number of operations
+    @IN cancel - flag set by other thread when curve should stop
+    @IN curve - curve
+
+    RETURN
+    0 iff success
+    Non-zero value iff cancelled
+*/
+static int montgomery_prac(Mpoint *p, const uint8_t *chain, size_t len, const bool *cancel, Mcurve *curve);
+
+/*
+    Copy point: r = p
+
+    PARAMS
+    @OUT r - result
+    @IN p - point
+
+    RETURN
+    This is a void function
+*/
+static void mpoint_set(Mpoint *r, const Mpoint *p);
+
+/*
+    Stage 2: product of differences Xm * Zj - Xj * Zm of giant steps mDQ and baby steps jQ
+    for every pair (m, j) from plan, so one gcd finds prime q = mD +- j in (B1, B2] with qQ = 0
+
+    PARAMS
+    @IN q - point after stage 1
+    @IN plan - plan with stage 2
+    @IN cancel - flag set by other thread when curve should stop (acc has then only part of pairs)
+    @IN curve - curve
+    @OUT acc - product of differences mod n
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int montgomery_stage2(const Mpoint *q, const Ecm_plan *plan, const bool *cancel, Mcurve *curve, mpz_t acc);
+
+static void mpoint_init(Mpoint *p, mp_bitcnt_t bits)
+{
+    mpz_init2(p->x, bits);
+    mpz_init2(p->z, bits);
+}
+
+static void mpoint_clear(Mpoint *p)
+{
+    mpz_clear(p->x);
+    mpz_clear(p->z);
+}
+
+static int mcurve_set(Mcurve *curve, uint64_t sigma, mpz_t factor)
+{
+    mpz_ptr u = curve->t[0];
+    mpz_ptr v = curve->t[1];
+    mpz_ptr temp = curve->t[2];
+    Mpoint *p = &curve->point;
+
+    int ret = 0;
+
+    TRACE();
+
+    /* u = sigma^2 - 5, v = 4 * sigma */
+    mpz_set_ui(temp, (unsigned long)sigma);
+    mpz_mul(u, temp, temp);
+    mpz_sub_ui(u, u, 5);
+    mpz_mod(u, u, curve->n);
+    mpz_mul_ui(v, temp, 4);
+    mpz_mod(v, v, curve->n);
+
+    /* x0 = u^3 : v^3 */
+    mpz_powm_ui(p->x, u, 3, curve->n);
+    mpz_powm_ui(p->z, v, 3, curve->n);
+
+    /* a24 = (v - u)^3 * (3u + v) / (16 * u^3 * v) */
+    mpz_mul_ui(temp, p->x, 16);
+    mpz_mul(temp, temp, v);
+    mpz_mod(temp, temp, curve->n);
+    if (mpz_invert(temp, temp, curve->n) == 0)
+    {
+        mpz_gcd(factor, temp, curve->n);
+        ret = 1;
+    }
+    else
+    {
+        mpz_sub(curve->a24, v, u);
+        mpz_powm_ui(curve->a24, curve->a24, 3, curve->n);
+        mpz_mul(curve->a24, curve->a24, temp);
+
+        mpz_mul_ui(temp, u, 3);
+        mpz_add(temp, temp, v);
+        mpz_mul(curve->a24, curve->a24, temp);
+        mpz_mod(curve->a24, curve->a24, curve->n);
+    }
+
+    return ret;
+}
+
+int mcurve_reserve(Mcurve *curve, const Ecm_plan *plan)
+{
+    Mpoint *baby;
+
+    const size_t babies = ecm_plan_baby_steps(plan);
+    size_t i;
+
+    TRACE();
+
+    if (plan->b2 != 0 && ecm_pairs_reserve(curve->pairs, plan))
+        ERROR("ecm_pairs_reserve error\n", 1);
+
+    if (babies <= curve->babies)
+        return 0;
+
+    baby = (Mpoint *)realloc(curve->baby, sizeof(Mpoint) * babies);
+    if (baby == NULL)
+        ERROR("realloc error\n", 1);
+
+    for (i = curve->babies; i < babies; ++i)
+        mpoint_init(&baby[i], curve->bits);
+
+    curve->baby = baby;
+    curve->babies = babies;
+
+    return 0;
+}
+
+static void mpoint_dbl(Mpoint *r, const Mpoint *p, Mcurve *curve)
+{
+    /* t0 = (X + Z)^2, t1 = (X - Z)^2, t2 = t0 - t1 = 4XZ */
+    mpz_add(curve->t[0], p->x, p->z);
+    mpz_mul(curve->t[0], curve->t[0], curve->t[0]);
+    mpz_mod(curve->t[0], curve->t[0], curve->n);
+
+    mpz_sub(curve->t[1], p->x, p->z);
+    mpz_mul(curve->t[1], curve->t[1], curve->t[1]);
+    mpz_mod(curve->t[1], curve->t[1], curve->n);
+
+    mpz_sub(curve->t[2], curve->t[0], curve->t[1]);
+
+    /* X2 = t0 * t1, Z2 = t2 * (t1 + a24 * t2) */
+    mpz_mul(r->x, curve->t[0], curve->t[1]);
+    mpz_mod(r->x, r->x, curve->n);
+
+    mpz_mul(curve->t[0], curve->t[2], curve->a24);
+    mpz_add(curve->t[0], curve->t[0], curve->t[1]);
+    mpz_mod(curve->t[0], curve->t[0], curve->n);
+
+    mpz_mul(r->z, curve->t[2], curve->t[0]);
+    mpz_mod(r->z, r->z, curve->n);
+}
+
+static void mpoint_add(Mpoint *r, const Mpoint *p, const Mpoint *q, const Mpoint *diff, Mcurve *curve)
+{
+    /* t2 = (Xp - Zp) * (Xq + Zq) */
+    mpz_sub(curve->t[0], p->x, p->z);
+    mpz_add(curve->t[1], q->x, q->z);
+    mpz_mul(curve->t[2], curve->t[0], curve->t[1]);
+    mpz_mod(curve->t[2], curve->t[2], curve->n);
+
+    /* t3 = (Xp + Zp) * (Xq - Zq) */
+    mpz_add(curve->t[0], p->x, p->z);
+    mpz_sub(curve->t[1], q->x, q->z);
+    mpz_mul(curve->t[3], curve->t[0], curve->t[1]);
+    mpz_mod(curve->t[3], curve->t[3], curve->n);
+
+    /* X = Zdiff * (t2 + t3)^2, Z = Xdiff * (t2 - t3)^2 */
+    mpz_add(curve->t[0], curve->t[2], curve->t[3]);
+    mpz_mul(curve->t[0], curve->t[0], curve->t[0]);
+    mpz_mod(curve->t[0], curve->t[0], curve->n);
+
+    mpz_sub(curve->t[1], curve->t[2], curve->t[3]);
+    mpz_mul(curve->t[1], curve->t[1], curve->t[1]);
+    mpz_mod(curve->t[1], curve->t[1], curve->n);
+
+    mpz_mul(r->x, diff->z, curve->t[0]);
+    mpz_mod(r->x, r->x, curve->n);
+
+    mpz_mul(r->z, diff->x, curve->t[1]);
+    mpz_mod(r->z, r->z, curve->n);
+}
+
+static void montgomery_ladder(Mpoint *p, uint64_t k, Mcurve *curve)
+{
+    uint64_t mask;
+
+    /* top bit of k */
+    for (mask = 1; (k >> 1) >= mask; mask <<= 1)
+        ;
+
+    /* invariant r1 - r0 = p */
+    mpoint_set(&curve->r[0], p);
+    mpoint_dbl(&curve->r[1], p, curve);
+
+    for (mask >>= 1; mask != 0; mask >>= 1)
+    {
+        if (k & mask)
+        {
+            mpoint_add(&curve->r[0], &curve->r[1], &curve->r[0], p, curve);
+            mpoint_dbl(&curve->r[1], &curve->r[1], curve);
+        }
+        else
+        {
+            mpoint_add(&curve->r[1], &curve->r[1], &curve->r[0], p, curve);
+            mpoint_dbl(&curve->r[0], &curve->r[0], curve);
+        }
+    }
+
+    mpoint_set(p, &curve->r[0]);
+}
+
+static void mpoint_set(Mpoint *r, const Mpoint *p)
+{
+    mpz_set(r->x, p->x);
+    mpz_set(r->z, p->z);
+}
+
+static int montgomery_prac(Mpoint *p, const uint8_t *chain, size_t len, const bool *cancel, Mcurve *curve)
+{
+    Mpoint *a = &curve->r[0];
+    Mpoint *b = &curve->r[1];
+    Mpoint *c = &curve->r[2];
+    Mpoint *t = &curve->r[3];
+    Mpoint *u = &curve->r[4];
+    Mpoint *temp;
+    size_t i;
+    bool done;
+
+    /* C = A - B always, so every addition below knows its difference */
+    for (i = 0; i < len; ++i)
+    {
+        if ((i & (MONTGOMERY_CANCEL_OPS - 1)) == 0)
+        {
+#pragma omp atomic read
+            done = *cancel;
+
+            if (done)
+                return 1;
+        }
+
+        if (chain[i] & PRAC_SWAP)
+        {
+            temp = a;
+            a = b;
+            b = temp;
+        }
+
+        switch (chain[i] & ~PRAC_SWAP)
+        {
+            case PRAC_DBL:
+            {
+                mpoint_dbl(p, p, curve);
+                break;
+            }
+            case PRAC_START:
+            {
+                mpoint_set(b, p);
+                mpoint_set(c, p);
+                mpoint_dbl(a, p, curve);
+                break;
+            }
+            case PRAC_RULE_1:
+            {
+                /* T = A + B, U = T + A, B = T + B */
+                mpoint_add(t, a, b, c, curve);
+                mpoint_add(u, t, a, b, curve);
+                mpoint_add(b, t, b, a, curve);
+
+                temp = a;
+                a = u;
+                u = temp;
+                break;
+            }
+            case PRAC_RULE_2:
+            case PRAC_RULE_4:
+            {
+                mpoint_add(b, a, b, c, curve);
+                mpoint_dbl(a, a, curve);
+                break;
+            }
+            case PRAC_RULE_3:
+            {
+                mpoint_add(t, a, b, c, curve);
+
+                temp = c;
+                c = b;
+                b = t;
+                t = temp;
+                break;
+            }
+            case PRAC_RULE_5:
+            {
+                /* C + A = 2A - B, difference C - A = -B */
+                mpoint_add(c, c, a, b, curve);
+                mpoint_dbl(a, a, curve);
+                break;
+            }
+            case PRAC_RULE_6:
+            {
+                /* T = 2A, U = A + B, U = T + U, T = T + A */
+                mpoint_dbl(t, a, curve);
+                mpoint_add(u, a, b, c, curve);
+                mpoint_add(u, t, u, c, curve);
+                mpoint_add(t, t, a, a, curve);
+
+                temp = c;
+                c = b;
+                b = u;
+                u = temp;
+
+                temp = a;
+                a = t;
+                t = temp;
+                break;
+            }
+            case PRAC_RULE_7:
+            {
+                /* T = A + B, U = T + A, T = 2A + A */
+                mpoint_add(t, a, b, c, curve);
+                mpoint_add(u, t, a, b, curve);
+                mpoint_dbl(t, a, curve);
+                mpoint_add(t, t, a, a, curve);
+
+                temp = b;
+                b = u;
+                u = temp;
+
+                temp = a;
+                a = t;
+                t = temp;
+                break;
+            }
+            case PRAC_RULE_8:
+            {
+                /* T = A + B, C = C + A, U = 2A + A */
+                mpoint_add(t, a, b, c, curve);
+                mpoint_add(c, c, a, b, curve);
+                mpoint_dbl(u, a, curve);
+                mpoint_add(u, u, a, a, curve);
+
+                temp = b;
+                b = t;
+                t = temp;
+
+                temp = a;
+                a = u;
+                u = temp;
+                break;
+            }
+            case PRAC_RULE_9:
+            {
+                /* C - B, difference C + B = A */
+                mpoint_add(c, c, b, a, curve);
+                mpoint_dbl(b, b, curve);
+                break;
+            }
+            case PRAC_END:
+            {
+                mpoint_add(p, a, b, c, curve);
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int montgomery_stage2(const Mpoint *q, const Ecm_plan *plan, const bool *cancel, Mcurve *curve, mpz_t acc)
+{
+    Mpoint *baby;
+    Mpoint *prev = &curve->giant[0]; /* (m - 1)DQ, mDQ, (m + 1)DQ, DQ */
+    Mpoint *cur = &curve->giant[1];
+    Mpoint *next = &curve->giant[2];
+    Mpoint *step = &curve->giant[3];
+    Mpoint *temp;
+
+    const size_t babies = ecm_plan_baby_steps(plan);
+    const uint32_t *js;
+    size_t len;
+    size_t i;
+    size_t k;
+    unsigned long m;
+    bool done = false;
+
+    TRACE();
+
+    if (mcurve_reserve(curve, plan))
+        ERROR("mcurve_reserve error\n", 1);
+
+    if (ecm_pairs_reset(curve->pairs, plan))
+        ERROR("ecm_pairs_reset error\n", 1);
+
+    baby = curve->baby;
+
+    /* baby[i] = (2i + 1)Q: (j + 2)Q = jQ + 2Q, difference (j - 2)Q, step holds 2Q */
+    mpoint_set(&baby[0], q);
+    mpoint_dbl(step, q, curve);
+    if (babies > 1)
+        mpoint_add(&baby[1], step, q, q, curve);
+
+    for (i = 2; i < babies; ++i)
+        mpoint_add(&baby[i], &baby[i - 1], step, &baby[i - 2], curve);
+
+    /* (m + 1)DQ = mDQ + DQ with difference (m - 1)DQ */
+    mpoint_set(step, q);
+    montgomery_ladder(step, plan->d, curve);
+    mpoint_set(cur, q);
+    montgomery_ladder(cur, (uint64_t)plan->m_first * plan->d, curve);
+    if (plan->m_first > 1)
+    {
+        mpoint_set(prev, q);
+        montgomery_ladder(prev, (uint64_t)(plan->m_first - 1) * plan->d, curve);
+    }
+
+    mpz_set_ui(acc, 1);
+    for (m = plan->m_first; m <= plan->m_last && !done; ++m)
+    {
+        if ((m & (MONTGOMERY_CANCEL_OPS - 1)) == 0)
+        {
+#pragma omp atomic read
+            done = *cancel;
+        }
+
+        js = ecm_pairs_next(curve->pairs, m, &len);
+        for (k = 0; k < len; ++k)
+        {
+            i = js[k] >> 1;
+
+            /* mDQ = +-jQ iff Xm * Zj = Xj * Zm */
+            mpz_mul(curve->t[0], cur->x, baby[i].z);
+            mpz_mul(curve->t[1], baby[i].x, cur->z);
+            mpz_sub(curve->t[0], curve->t[0], curve->t[1]);
+            mpz_mod(curve->t[0], curve->t[0], curve->n);
+            mpz_mul(acc, acc, curve->t[0]);
+            mpz_mod(acc, acc, curve->n);
+        }
+
+        if (m == plan->m_last)
+            break;
+
+        /* differential addition needs nonzero difference, so 2DQ is doubling */
+        if (m == 1)
+            mpoint_dbl(next, cur, curve);
+        else
+            mpoint_add(next, cur, step, prev, curve);
+
+        temp = prev;
+        prev = cur;
+        cur = next;
+        next = temp;
+    }
+
+    return 0;
+}
+
+Mcurve *mcurve_create(const mpz_t n)
+{
+    Mcurve *curve;
+    size_t i;
+
+    TRACE();
+
+    curve = (Mcurve *)malloc(sizeof(Mcurve));
+    if (curve == NULL)
+        ERROR("malloc error\n", NULL);
+
+    curve->bits = 2 * mpz_sizeinbase(n, 2) + 2 * GMP_NUMB_BITS;
+    curve->baby = NULL;
+    curve->babies = 0;
+
+    curve->pairs = ecm_pairs_create();
+    if (curve->pairs == NULL)
+    {
+        FREE(curve);
+        ERROR("ecm_pairs_create error\n", NULL);
+    }
+
+    mpz_init_set(curve->n, n);
+    mpz_init2(curve->a24, curve->bits);
+    mpz_init2(curve->acc, curve->bits);
+    mpoint_init(&curve->point, curve->bits);
+
+    for (i = 0; i < ARRAY_SIZE(curve->r); ++i)
+        mpoint_init(&curve->r[i], curve->bits);
+
+    for (i = 0; i < ARRAY_SIZE(curve->t); ++i)
+        mpz_init2(curve->t[i], curve->bits);
+
+    for (i = 0; i < ARRAY_SIZE(curve->giant); ++i)
+        mpoint_init(&curve->giant[i], curve->bits);
+
+    return curve;
+}
+
+void mcurve_destroy(Mcurve *curve)
+{
+    size_t i;
+
+    TRACE();
+
+    if (curve == NULL)
+        return;
+
+    mpz_clear(curve->n);
+    mpz_clear(curve->a24);
+    mpz_clear(curve->acc);
+    mpoint_clear(&curve->point);
+
+    for (i = 0; i < ARRAY_SIZE(curve->r); ++i)
+        mpoint_clear(&curve->r[i]);
+
+    for (i = 0; i < ARRAY_SIZE(curve->t); ++i)
+        mpz_clear(curve->t[i]);
+
+    for (i = 0; i < ARRAY_SIZE(curve->giant); ++i)
+        mpoint_clear(&curve->giant[i]);
+
+    for (i = 0; i < curve->babies; ++i)
+        mpoint_clear(&curve->baby[i]);
+
+    ecm_pairs_destroy(curve->pairs);
+    FREE(curve->baby);
+    FREE(curve);
+}
+
+int montgomery_ecm(Mcurve *curve, const Ecm_plan *plan, uint64_t sigma, const bool *cancel, mpz_t factor)
+{
+    Mpoint *point = &curve->point;
+    bool done;
+
+    TRACE();
+
+    mpz_set_ui(factor, 1);
+    if (mcurve_set(curve, sigma, factor) == 0)
+    {
+        /* point = scalar * point, scalar = product of max prime powers < B1 */
+        done = montgomery_prac(point, plan->chain, plan->chain_len, cancel, curve) != 0;
+
+        /* Z = 0 mod p for every p | n with B1 smooth curve order (gcd of cancelled curve is still valid) */
+        mpz_gcd(factor, point->z, curve->n);
+
+        /* stage 2 only if stage 1 found nothing, one more gcd at the end */
+        if (mpz_cmp_ui(factor, 1) == 0 && plan->b2 != 0 && !done)
+            if (montgomery_stage2(point, plan, cancel, curve, curve->acc) == 0)
+                mpz_gcd(factor, curve->acc, curve->n);
+    }
+
+    return mpz_cmp_ui(factor, 1) > 0 && mpz_cmp(factor, curve->n) < 0 ? 0 : 1;
+}
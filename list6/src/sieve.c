@@ -0,0 +1,377 @@
+#include <sieve.h>
+#include <log.h>
+#include <common.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <omp.h>
+
+#define SIEVE_WORD_BITS 64
+
+/* odd numbers in one word */
+#define SIEVE_WORD_SPAN (2 * SIEVE_WORD_BITS)
+
+/* words of full block */
+#define SIEVE_BLOCK_WORDS (SIEVE_SEGMENT_BITS * SIEVE_BLOCK_SEGMENTS / SIEVE_WORD_BITS)
+
+struct Sieve
+{
+    uint64_t lo;
+    uint64_t hi;
+    unsigned int threads;
+
+    /* odd primes <= primes_limit, primes_limit >= sqrt(hi - 1) */
+    uint32_t *primes;
+    size_t primes_len;
+    uint64_t primes_limit;
+
+    /* bit i of block starting at base is odd number base + 2i + 1, bit is set iff number is composite */
+    uint64_t *bits;
+    size_t bits_capacity;
+    size_t block_words;
+    size_t blocks;          /* blocks of one batch, at most threads */
+
+    /* next[b * primes_len + k] is bit of next multiple of primes[k] in block b */
+    uint64_t *next;
+    size_t next_capacity;
+
+    uint64_t base;          /* even number before first bit of current batch */
+    uint64_t next_base;     /* base of next batch */
+    size_t words;           /* words of current batch */
+    size_t word;            /* next word to read */
+    uint64_t word_base;     /* even number before first bit of current word */
+    uint64_t cur;           /* not returned primes of current word */
+    bool two;               /* 2 is in range and was not returned */
+};
+
+/*
+    Integer square root
+
+    PARAMS
+    @IN x - number
+
+    RETURN
+    floor(sqrt(x))
+*/
+static uint64_t isqrt(uint64_t x);
+
+/*
+    Make array at least len elements long, content is kept
+
+    PARAMS
+    @IN array - pointer to array
+    @IN capacity - pointer to number of elements of array
+    @IN len - needed number of elements
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int sieve_grow(uint64_t **array, size_t *capacity, size_t len);
+
+/*
+    Find odd primes <= limit by simple sieve, primes found before are reused if limit is not greater
+
+    PARAMS
+    @IN sieve - iterator
+    @IN limit - bound
+
+    RETURN
+    0 iff success
+    Non-zero value iff failure
+*/
+static int sieve_base_primes(Sieve *sieve, uint64_t limit);
+
+/*
+    Mark composites of one block segment by segment, so marked segment stays in L1
+
+    PARAMS
+    @IN sieve - iterator
+    @IN block - block of batch
+    @IN base - even number before first bit of block
+
+    RETURN
+    This is a void function
+*/
+static void sieve_block(Sieve *sieve, size_t block, uint64_t base);
+
+/*
+    Sieve next batch, blocks of batch are sieved in parallel
+
+    PARAMS
+    @IN sieve - iterator
+
+    RETURN
+    0 iff success
+    Non-zero value iff there is no more numbers in range
+*/
+static int sieve_batch(Sieve *sieve);
+
+static uint64_t isqrt(uint64_t x)
+{
+    uint64_t r;
+    uint64_t y;
+
+    if (x < 2)
+        return x;
+
+    /* Newton iteration from above decreases until floor(sqrt(x)) */
+    r = x;
+    y = x / 2 + 1;
+    while (y < r)
+    {
+        r = y;
+        y = (r + x / r) / 2;
+    }
+
+    return r;
+}
+
+static int sieve_grow(uint64_t **array, size_t *capacity, size_t len)
+{
+    uint64_t *temp;
+
+    if (len <= *capacity)
+        return 0;
+
+    temp = (uint64_t *)realloc(*array, sizeof(uint64_t) * len);
+    if (temp == NULL)
+        ERROR("realloc error\n", 1);
+
+    *array = temp;
+    *capacity = len;
+
+    return 0;
+}
+
+static int sieve_base_primes(Sieve *sieve, uint64_t limit)
+{
+    bool *composite;
+    uint32_t *primes;
+    uint64_t p;
+    size_t i;
+    size_t j;
+    size_t len = 0;
+
+    /* i-th entry is odd number 2i + 1 */
+    const size_t odds = (size_t)((limit + 1) / 2);
+
+    TRACE();
+
+    if (limit <= sieve->primes_limit || odds < 2)
+        return 0;
+
+    composite = (bool *)calloc(odds, sizeof(bool));
+    if (composite == NULL)
+        ERROR("calloc error\n", 1);
+
+    for (i = 1; i < odds; ++i)
+        if (!composite[i])
+        {
+            ++len;
+            p = 2 * i + 1;
+            for (j = (size_t)(p * p / 2); j < odds; j += p)
+                composite[j] = true;
+        }
+
+    primes = (uint32_t *)realloc(sieve->primes, sizeof(uint32_t) * len);
+    if (primes == NULL)
+    {
+        FREE(composite);
+        ERROR("realloc error\n", 1);
+    }
+
+    sieve->primes = primes;
+    sieve->primes_len = 0;
+    for (i = 1; i < odds; ++i)
+        if (!composite[i])
+            sieve->primes[sieve->primes_len++] = (uint32_t)(2 * i + 1);
+
+    sieve->primes_limit = limit;
+    FREE(composite);
+
+    return 0;
+}
+
+static void sieve_block(Sieve *sieve, size_t block, uint64_t base)
+{
+    uint64_t *bits = sieve->bits + block * sieve->block_words;
+    uint64_t *next = sieve->next + block * sieve->primes_len;
+    uint64_t p;
+    uint64_t start;
+    uint64_t j;
+    size_t len;
+    size_t k;
+    size_t seg;
+    size_t seg_end;
+
+    const size_t block_bits = sieve->block_words * SIEVE_WORD_BITS;
+    const uint64_t end = base + sieve->block_words * SIEVE_WORD_SPAN;
+
+    (void)memset(bits, 0, sizeof(uint64_t) * sieve->block_words);
+
+    /* 1 is not prime */
+    if (base == 0)
+        bits[0] |= 1;
+
+    /* smaller multiples of p than p^2 are marked by smaller primes */
+    for (len = 0; len < sieve->primes_len; ++len)
+    {
+        p = sieve->primes[len];
+        if (p * p >= end)
+            break;
+
+        start = p * p;
+        if (start <= base)
+        {
+            start = (base / p + 1) * p;
+            if (EVEN(start))
+                start += p;
+        }
+
+        next[len] = (start - base - 1) / 2;
+    }
+
+    for (seg = 0; seg < block_bits; seg += SIEVE_SEGMENT_BITS)
+    {
+        seg_end = MIN(seg + SIEVE_SEGMENT_BITS, block_bits);
+        for (k = 0; k < len; ++k)
+        {
+            p = sieve->primes[k];
+            for (j = next[k]; j < seg_end; j += p)
+                bits[j / SIEVE_WORD_BITS] |= 1ull << (j % SIEVE_WORD_BITS);
+
+            next[k] = j;
+        }
+    }
+}
+
+static int sieve_batch(Sieve *sieve)
+{
+    size_t blocks;
+    size_t b;
+    uint64_t base;
+
+    const uint64_t block_span = sieve->block_words * SIEVE_WORD_SPAN;
+
+    /* first number of batch is next_base + 1 */
+    if (sieve->next_base + 1 >= sieve->hi)
+        return 1;
+
+    base = sieve->next_base;
+    blocks = (size_t)MIN((uint64_t)sieve->blocks, (sieve->hi - base - 1 + block_span - 1) / block_span);
+
+#pragma omp parallel for schedule(static) if(blocks > 1)
+    for (b = 0; b < blocks; ++b)
+        sieve_block(sieve, b, base + b * block_span);
+
+    sieve->base = base;
+    sieve->next_base = base + blocks * block_span;
+    sieve->words = blocks * sieve->block_words;
+    sieve->word = 0;
+
+    return 0;
+}
+
+Sieve *sieve_create(uint64_t lo, uint64_t hi, unsigned int threads)
+{
+    Sieve *sieve;
+
+    TRACE();
+
+    sieve = (Sieve *)calloc(1, sizeof(Sieve));
+    if (sieve == NULL)
+        ERROR("calloc error\n", NULL);
+
+    sieve->threads = threads == 0 ? (unsigned int)omp_get_max_threads() : threads;
+    if (sieve_reset(sieve, lo, hi))
+    {
+        sieve_destroy(sieve);
+        ERROR("sieve_reset error\n", NULL);
+    }
+
+    return sieve;
+}
+
+void sieve_destroy(Sieve *sieve)
+{
+    TRACE();
+
+    if (sieve == NULL)
+        return;
+
+    FREE(sieve->primes);
+    FREE(sieve->bits);
+    FREE(sieve->next);
+    FREE(sieve);
+}
+
+int sieve_reset(Sieve *sieve, uint64_t lo, uint64_t hi)
+{
+    uint64_t words;
+
+    TRACE();
+
+    sieve->lo = lo;
+    sieve->hi = MAX(lo, hi);
+
+    /* composite c < hi has prime factor p <= sqrt(hi - 1) */
+    if (sieve_base_primes(sieve, isqrt(MAX(sieve->hi, 1) - 1)))
+        ERROR("sieve_base_primes error\n", 1);
+
+    /* odd numbers of range, small range needs less than one block */
+    words = (sieve->hi - (lo & ~1ull) + SIEVE_WORD_SPAN - 1) / SIEVE_WORD_SPAN;
+    sieve->block_words = (size_t)MAX(MIN(words, (uint64_t)SIEVE_BLOCK_WORDS), 1);
+    sieve->blocks = (size_t)MAX(MIN((words + sieve->block_words - 1) / sieve->block_words, (uint64_t)sieve->threads), 1);
+
+    if (sieve_grow(&sieve->bits, &sieve->bits_capacity, sieve->blocks * sieve->block_words))
+        ERROR("sieve_grow error\n", 1);
+
+    if (sieve_grow(&sieve->next, &sieve->next_capacity, MAX(sieve->blocks * sieve->primes_len, 1)))
+        ERROR("sieve_grow error\n", 1);
+
+    sieve->next_base = lo & ~1ull;
+    sieve->base = sieve->next_base;
+    sieve->words = 0;
+    sieve->word = 0;
+    sieve->cur = 0;
+    sieve->two = lo <= 2 && sieve->hi > 2;
+
+    return 0;
+}
+
+uint64_t sieve_next(Sieve *sieve)
+{
+    uint64_t prime;
+
+    if (sieve->two)
+    {
+        sieve->two = false;
+        return 2;
+    }
+
+    while (sieve->cur == 0)
+    {
+        if (sieve->word == sieve->words && sieve_batch(sieve))
+            return 0;
+
+        sieve->word_base = sieve->base + sieve->word * SIEVE_WORD_SPAN;
+        sieve->cur = ~sieve->bits[sieve->word++];
+    }
+
+    /* odd numbers of batch are > base >= lo - 1, so only hi is checked */
+    prime = sieve->word_base + 2 * (uint64_t)__builtin_ctzll(sieve->cur) + 1;
+    sieve->cur &= sieve->cur - 1;
+
+    if (prime >= sieve->hi)
+    {
+        /* next calls return 0 without sieving */
+        sieve->cur = 0;
+        sieve->word = sieve->words;
+        sieve->next_base = sieve->hi;
+
+        return 0;
+    }
+
+    return prime;
+}